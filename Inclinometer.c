@@ -19,37 +19,37 @@
 #include "hardware/clocks.h"
 #include "hardware/pll.h"
 #include "hardware/adc.h"
-#include "hardware/structs/usb.h"
 #include "hardware/vreg.h"       // VREG_VOLTAGE_0_60 の定義用
 #include "hardware/regs/powman.h"
 #include "hardware/structs/powman.h"
-#include "hardware/resets.h"     // reset_block のために追加
 // #include "pico/sleep.h"          // sleep_run_from_rosc() が powman_example.c にない場合の代替
 // ★ powman_example.c が提供する関数を使うために、このヘッダーが必須 ★
 #include "powman_example.h" 
+#include "flash_log.h"
+#include "device_config.h"
+#include "powman_scratch.h"
+#include "lora_radio.h"
+#include "telemetry_queue.h"
+#include "uplink.h"
+#include "fw_update.h"
+#include "supervisor.h"
+#include "supply_monitor.h"
+#include "solar_scheduler.h"
+#include "periph_power.h"
+#include "board_pins.h"
+#include "clock_profile.h"
+#include "lean_boot.h"
+#include "micro_wake.h"
+#include "wake_sources.h"
+#include "tilt.h"
+#include "drift.h"
+#include "flash_power.h"
 
 
-#define AWAKE_TIME_MS 10000
-#define SLEEP_TIME_MS 5000
-// 
-
-// ウェイクアップに使用するピン (加速度センサーの割り込みピンなど)
-#define WAKE_PIN 0
-// LEDピン (環境に合わせて変更してください)
-#ifndef PICO_DEFAULT_LED_PIN
-#define PICO_DEFAULT_LED_PIN 25
-#endif
-
-// 低消費電力化のため、USB PHYを完全に無効化する
-static void disable_usb() {
-    usb_hw->phy_direct = USB_USBPHY_DIRECT_TX_PD_BITS | USB_USBPHY_DIRECT_RX_PD_BITS | USB_USBPHY_DIRECT_DM_PULLDN_EN_BITS | USB_USBPHY_DIRECT_DP_PULLDN_EN_BITS;
-    usb_hw->phy_direct_override = USB_USBPHY_DIRECT_RX_DM_BITS | USB_USBPHY_DIRECT_RX_DP_BITS | USB_USBPHY_DIRECT_RX_DD_BITS |
-        USB_USBPHY_DIRECT_OVERRIDE_TX_DIFFMODE_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DM_PULLUP_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_FSSLEW_OVERRIDE_EN_BITS |
-        USB_USBPHY_DIRECT_OVERRIDE_TX_PD_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_RX_PD_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DM_OVERRIDE_EN_BITS |
-        USB_USBPHY_DIRECT_OVERRIDE_TX_DP_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DM_OE_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DP_OE_OVERRIDE_EN_BITS |
-        USB_USBPHY_DIRECT_OVERRIDE_DM_PULLDN_EN_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLDN_EN_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLUP_EN_OVERRIDE_EN_BITS |
-        USB_USBPHY_DIRECT_OVERRIDE_DM_PULLUP_HISEL_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLUP_HISEL_OVERRIDE_EN_BITS;
-}
+// 測定時間・標本化レートと休止時間は solar_scheduler が発電量に合わせて決める
+// (SOLAR_AWAKE_MS, SOLAR_SAMPLE_MIN_HZ..MAX_HZ, SOLAR_SLEEP_MIN_MS..MAX_MS)
+
+// ピン割り当て (ウェイクアップピン・LED など) は board_pins.h
 
 /**
  * @brief P1.7 (全ドメインOFF) + DORMANT (オシレータOFF) 状態に移行
@@ -71,22 +71,53 @@ void enter_dormant_p1_7(void) {
 
 /* setup_dormant_wakeup_gpio 関数は、現在、原因切り分けのためコードから除外されています。 */
 
+typedef struct {
+    const int16_t *raw;
+    tilt_record *out;
+} tilt_job;
+
+// flash_power_run の中で動く (フラッシュを止めている間なので SRAM 上の関数だけを呼ぶ)
+static void __not_in_flash_func(compute_tilt)(void *arg) {
+    tilt_job *job = arg;
+    tilt_compute(job->raw, job->out);
+}
+
+// 傾斜を記録して要約として送り、長期変化の解析 (drift.h) に入れる。
+// 解析は DRIFT_INTERVAL_S ごとの要約で、速度の警報・変化点はイベントとしてすぐに送る
+static void record_tilt(const int16_t raw[3]) {
+    uint64_t now = powman_timer_get_ms();
+    tilt_record tilt;
+    tilt_job job = {raw, &tilt};
+    flash_power_run(compute_tilt, &job);
+    flash_log_append(now, &tilt, sizeof(tilt));
+    telemetry_queue_push(TQ_PRIO_SUMMARY, now, &tilt, sizeof(tilt));
+
+    drift_record drift;
+    if (drift_add(now, &tilt, &drift) == PICO_OK) {
+        flash_log_append(now, &drift, sizeof(drift));
+        telemetry_queue_push((drift.flags & DRIFT_FLAG_NEW_ALERT) ? TQ_PRIO_EVENT : TQ_PRIO_SUMMARY, now, &drift,
+                             sizeof(drift));
+    }
+}
+
 
 int main() {
+    // 起動にかかった時間を測る (最初に呼ぶ)
+    lean_boot_mark_main();
+
+    // 何で起きたかを読む (powman_example_init が起床設定を消す前に)
+    wake_sources_capture();
+
     // === 1. クロックとGPIOの低電力化初期設定 ===
 
-    // クロックを48MHzに設定し、pll_sysを停止（低消費電力化）
-    set_sys_clock_48mhz();
+    // クロックを48MHzに設定し、pll_sysを停止してからコア電圧を下げる（低消費電力化）
+    clock_profile_set(CLOCK_PROFILE_LOW);
 
-    // Set all pins to input (as far as SIO is concerned) and disable pulls
-    gpio_set_dir_all_bits(0);
-    for (int i = 2; i < NUM_BANK0_GPIOS; ++i) {
-        gpio_set_function(i, GPIO_FUNC_SIO);
-        if (i > NUM_BANK0_GPIOS - NUM_ADC_CHANNELS) {
-            gpio_disable_pulls(i);
-            gpio_set_input_enabled(i, false);
-        }
-    }
+    // 休止を分割した短い起床なら、電源電圧だけ測ってすぐ眠り直す (しきい値を越えたら通常の処理へ)
+    micro_wake_run();
+
+    // ピン表 (board_pins.h) のとおりに全ピンを設定し、未使用ピンは入出力バッファとプルを切る
+    board_pins_init();
 
     // === 2. VREG 低電圧設定 (40µA達成の鍵) ===
     // 低電力モード時の VREG 電圧を 0.60V に設定
@@ -102,46 +133,176 @@ int main() {
 
     // === 3. 周辺機器の停止とリセット（強化） ===
 
-    // ADC以外の未使用周辺機器をリセットして停止し、消費電流を最小化する
-    reset_block(RESETS_RESET_ADC_BITS |  
-                RESETS_RESET_I2C0_BITS | 
-                RESETS_RESET_PWM_BITS 
-            );
-
-    // Turn off USB PHY and apply pull downs on DP & DM (低消費電力化)
-    disable_usb();
+    // 未使用の周辺機器 (ADC, SPI, I2C, UART, PWM) をリセットしてクロックも止め、USB PHY を電源断する。
+    // 以降は各ドライバが periph_acquire/periph_release で必要な間だけ動かす
+    periph_power_init();
 
 
     // === 4. powman_example の初期化とスリープ実行 ===
     
     // powman_example の初期化 (powman_timer_start() などを含む)
     // この関数は、以前の $40µA 達成コードで呼ばれていました
-    // 注: 1704067200000 はダミーの時刻
-    powman_example_init(1704067200000); 
+    // 注: 1704067200000 はダミーの時刻 (タイマーは電源断中も動き続けるので、設定はコールドスタート時のみ)
+    bool cold_start = powman_example_init(1704067200000); 
 
     // Scratch register survives power down (printfなし)
-    powman_hw->scratch[0]++; 
+    powman_hw->scratch[SCRATCH_WAKE_COUNT]++; 
 
+    // 故障が続いていたら周辺機器に触らずに長めに眠る (セーフモード)
+    if (supervisor_boot()) {
+        powman_example_sleep_decided();
+        board_pins_sleep();
+        int safe_rc = powman_example_off_for_ms(SUPERVISOR_SAFE_MODE_SLEEP_MS);
+        supervisor_off_failed(safe_rc, SUPERVISOR_SAFE_MODE_SLEEP_MS);
+    }
 
-    // === 5. Dormantモードへ移行（powman_example の高レベル関数を使用） ===
+    // 電源電圧を測る。低電圧で停止中にまだ戻っていなければ、ログに触らずにすぐ眠り直す
+    supply_record supply;
+    supply_state supply_st = supply_monitor_check(&supply);
+    if (supply_st == SUPPLY_STILL_LOW) {
+        powman_example_sleep_decided();
+        board_pins_sleep();
+        supervisor_off_failed(supply_monitor_off(), SUPPLY_LOW_FALLBACK_MS);
+    }
 
-    // アクティブな実行時間
-    sleep_ms(AWAKE_TIME_MS);
+    // 起床要因ごとに必要な処理だけを行う (wake_sources.c の表)
+    uint32_t work = wake_sources_work();
 
-    // power off (powman_example.c内の関数で低電力移行シーケンスを実行)
-    int rc = powman_example_off_for_ms(SLEEP_TIME_MS); 
-    // powman_example_off_for_ms は内部で powman_enable_alarm_wakeup_at_ms() を呼び出します
+    // 発電量の移動平均と電池電圧から、今回の測定時間・標本化レートと次の休止時間を決める。
+    // 割り込みで起きたときは測定せず、中断された定期起床の時刻まで眠り直す
+    energy_plan plan = {0};
+    if (work & WAKE_WORK_SCHEDULE) {
+        solar_scheduler_update(powman_timer_get_ms(), supply.mv, &plan);
+    } else {
+        plan.sleep_ms = wake_sources_alarm_remaining_ms();
+    }
+
+    // 起床サイクルをウォッチドッグで監視する
+    // (更新直後の試用起動中はブートROMのウォッチドッグを上書きしないよう、確定後に開始)
+    if (!fw_update_pending_confirm()) {
+        supervisor_start();
+    }
 
-    // 成功すれば、ここで hard_assert が呼ばれることはありません（復帰するため）
+    // 電源投入直後の無線チップはスタンバイ (mA 級) なので一度だけスリープさせる
+    if (cold_start && lora_radio_init() == PICO_OK) {
+        lora_radio_sleep();
+    }
 
-    // === 6. ウェイクアップ後 ===
-    
-    // ウェイクアップ後の処理をここに記述
-    // ここからプログラムが再開される
+    // 設定で選ばれた保存先でログを開き、ウェイク回数を記録
+    // (外付けデバイスが応答しない場合は内蔵フラッシュに切り替える)
+    device_config cfg;
+    device_config_load(&cfg);
+    // 傾斜計算の取り付け向きとゼロ点 (保存された行列が回転でなければ補正なしで動かす)
+    if (tilt_init(&cfg.tilt) != PICO_OK) {
+        tilt_config_defaults(&cfg.tilt);
+        tilt_init(&cfg.tilt);
+    }
+    if (flash_log_init(storage_backend_get(cfg.storage_backend)) != PICO_OK) {
+        flash_log_init(&storage_internal_flash);
+    }
+    uint32_t wake_count = powman_hw->scratch[SCRATCH_WAKE_COUNT];
+    flash_log_append(powman_timer_get_ms(), &wake_count, sizeof(wake_count));
+
+    // 起動時間を記録する
+    boot_time_record boot_time;
+    lean_boot_get(&boot_time);
+    flash_log_append(powman_timer_get_ms(), &boot_time, sizeof(boot_time));
 
-    while (true) {
-        tight_loop_contents();
+    // 前回の電源断にかかった時間 (判断から電源断の要求まで) を記録する
+    sleep_entry_record entry = {SLEEP_ENTRY_RECORD_TAG, 0, (uint16_t)powman_example_last_sleep_entry_us(), wake_count};
+    if (entry.entry_us != 0) {
+        flash_log_append(powman_timer_get_ms(), &entry, sizeof(entry));
     }
-    // powman_example_off_for_ms が成功した場合、ここに到達しないため、hard_assert(false) は削除
+
+    // 送信待ちキューを復元し、ウェイク回数を状態情報として積む
+    telemetry_queue_init();
+    telemetry_queue_push(TQ_PRIO_HEALTH, powman_timer_get_ms(), &wake_count, sizeof(wake_count));
+
+    // 定期起床以外の起床要因を記録し、センサーの割り込みはすぐに送る
+    wake_source source = wake_sources_primary();
+    if (source != WAKE_SOURCE_ALARM && source != WAKE_SOURCE_RESET) {
+        wake_event_record event = {WAKE_EVENT_RECORD_TAG, (uint8_t)source, (uint16_t)wake_sources_fired(), wake_count};
+        flash_log_append(powman_timer_get_ms(), &event, sizeof(event));
+        if (work & WAKE_WORK_EVENT) {
+            telemetry_queue_push(TQ_PRIO_EVENT, powman_timer_get_ms(), &event, sizeof(event));
+        }
+    }
+
+    // 前回までの故障 (ウォッチドッグリセット・電源断の失敗) を記録して送る
+    supervisor_fault fault;
+    if (supervisor_fault_take(&fault)) {
+        flash_log_append(powman_timer_get_ms(), &fault, sizeof(fault));
+        telemetry_queue_push(TQ_PRIO_HEALTH, powman_timer_get_ms(), &fault, sizeof(fault));
+    }
+
+    // 低電圧停止とそこからの復帰を記録する
+    if (supply_st != SUPPLY_OK) {
+        flash_log_append(powman_timer_get_ms(), &supply, sizeof(supply));
+        telemetry_queue_push(TQ_PRIO_HEALTH, powman_timer_get_ms(), &supply, sizeof(supply));
+    }
+
+    // 今回しきい値を下回ったら、ログとキューを書き出して閉じ、電圧が戻るまで GPIO だけで起きる P1.7 で眠る
+    // (電池切れ間際の書き込み中断でログを壊したり、再起動を繰り返したりしないように)
+    if (supply_st == SUPPLY_LOW) {
+        powman_example_sleep_decided();
+        flash_log_flush();
+        telemetry_queue_sleep();
+        flash_log_sleep();
+        board_pins_sleep();
+        supervisor_off_failed(supply_monitor_off(), SUPPLY_LOW_FALLBACK_MS);
+    }
+
+    // 更新直後の試用起動なら、ログとキューが開けた時点で新しいイメージを確定する
+    // (ここまで来られずに落ちると、ブートROMが次の起動で元のイメージに戻す)
+    fw_update_confirm();
+    supervisor_start();
+
+    // シリアルで更新イメージを受け取ったら、ログを閉じてから新しいイメージで再起動
+    if ((work & WAKE_WORK_CONSOLE) && fw_update_serial_poll() == PICO_OK) {
+        flash_log_flush();
+        flash_log_sleep();
+        fw_update_apply();
+    }
+
+
+    // === 5. Dormantモードへ移行（powman_example の高レベル関数を使用） ===
+
+    // アクティブな実行時間 (定期起床ではこのあいだ計画のレートで傾斜を標本化する)
+    if (work & WAKE_WORK_SCHEDULE) {
+        tilt_sensor_start(plan.sample_hz);
+    }
+    supervisor_sleep_ms(plan.awake_ms);
+
+    // 定期起床では傾斜を記録する (警報が出れば下の送信ですぐに送られる)
+    int16_t raw[3];
+    if ((work & WAKE_WORK_SCHEDULE) && tilt_sensor_read(raw) == PICO_OK) {
+        record_tilt(raw);
+    }
+
+    // ログをコミットし、定期送信の時刻 (イベントがあれば即時) なら送信待ちをまとめて送る
+    flash_log_flush();
+    supervisor_feed();
+    if (work & WAKE_WORK_UPLINK) {
+        uplink_poll(powman_timer_get_ms(), telemetry_queue_pending(TQ_PRIO_EVENT));
+    }
+
+    // ここから電源断まで (キュー・ログ・ピンの後始末) の時間を計る
+    powman_example_sleep_decided();
+    telemetry_queue_sleep();
+
+    // 保存先を低消費電力状態にし、ピンをスリープ時の状態にしてから電源を落とす
+    flash_log_sleep();
+    board_pins_sleep();
+
+    // power off (powman_example.c内の関数で低電力移行シーケンスを実行)
+    // センサー割り込み・ホスト接続・USB 給電でも起きるように設定する (wake_sources.h)。
+    // MICRO_WAKE_INTERVAL_MS が設定されていれば、休止を短い起床 (micro_wake_run) に分ける
+    int rc = (work & WAKE_WORK_SCHEDULE) ? micro_wake_off(plan.sleep_ms) : wake_sources_off_for_ms(plan.sleep_ms);
+
+    // === 6. 電源断に失敗した場合 ===
+
+    // 成功すれば戻らない。戻ってきたら rc を記録し、DORMANT で代わりに眠ってから再起動する
+    // (失敗が続くほど長く眠り、3回続けば次はセーフモード)
+    supervisor_off_failed(rc, plan.sleep_ms);
     return 0; // ここに到達することは稀
 }
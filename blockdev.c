@@ -0,0 +1,239 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "blockdev.h"
+
+typedef struct {
+    uint32_t base;     // ページ先頭オフセット (UINT32_MAX = 空き)
+    uint32_t last_use; // LRU 用
+    bool dirty;
+    uint8_t data[STORAGE_MAX_PAGE_SIZE];
+} cache_line;
+
+static const storage_backend *dev;
+static uint32_t page_size;
+static cache_line lines[BLOCKDEV_CACHE_LINES];
+static uint32_t use_clock;
+static blockdev_stats stats;
+
+// 直前に消去し、まだ一度もプログラムしていない範囲。
+// ここに含まれるページは読まずに 0xff で埋められる
+static uint32_t erased_lo;
+static uint32_t erased_hi;
+
+// 隣接ページをまとめてプログラムするための作業領域
+static uint8_t __uninitialized_ram(stage)[BLOCKDEV_CACHE_LINES * STORAGE_MAX_PAGE_SIZE];
+
+int blockdev_init(const storage_backend *backend) {
+    if (backend->page_size > STORAGE_MAX_PAGE_SIZE) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    int rc = backend->init();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    dev = backend;
+    page_size = backend->page_size;
+    for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+        lines[i].base = UINT32_MAX;
+        lines[i].dirty = false;
+    }
+    erased_lo = erased_hi = 0;
+    memset(&stats, 0, sizeof(stats));
+    return PICO_OK;
+}
+
+static cache_line *find_line(uint32_t base) {
+    for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+        if (lines[i].base == base) {
+            lines[i].last_use = ++use_clock;
+            return &lines[i];
+        }
+    }
+    return NULL;
+}
+
+// プログラムした範囲 [lo, hi) を消去済み範囲から外す
+static void erased_exclude(uint32_t lo, uint32_t hi) {
+    if (hi <= erased_lo || lo >= erased_hi) {
+        return;
+    }
+    if (lo <= erased_lo) {
+        erased_lo = hi < erased_hi ? hi : erased_hi;
+    } else {
+        erased_hi = lo;
+    }
+}
+
+// 隣接するダーティページを1回のプログラムで書き出す
+static int write_back(void) {
+    bool wrote = false;
+    for (;;) {
+        // 最も小さいアドレスのダーティページから、連続する範囲を集める
+        cache_line *first = NULL;
+        for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+            if (lines[i].dirty && (first == NULL || lines[i].base < first->base)) {
+                first = &lines[i];
+            }
+        }
+        if (first == NULL) {
+            if (wrote) {
+                stats.flushes++;
+            }
+            return PICO_OK;
+        }
+        uint32_t count = 0;
+        cache_line *run[BLOCKDEV_CACHE_LINES];
+        for (cache_line *next = first; next != NULL && count < BLOCKDEV_CACHE_LINES;) {
+            run[count] = next;
+            memcpy(stage + count * page_size, next->data, page_size);
+            count++;
+            uint32_t want = next->base + page_size;
+            next = NULL;
+            for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+                if (lines[i].dirty && lines[i].base == want) {
+                    next = &lines[i];
+                }
+            }
+        }
+        int rc = dev->program(first->base, stage, count * page_size);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        erased_exclude(first->base, first->base + count * page_size);
+        wrote = true;
+        stats.programs++;
+        stats.pages += count;
+        for (uint32_t i = 0; i < count; ++i) {
+            run[i]->dirty = false;
+        }
+    }
+}
+
+// ページをキャッシュに載せる。空きがなければ LRU を追い出す
+static int load_line(uint32_t base, cache_line **out) {
+    cache_line *line = find_line(base);
+    if (line != NULL) {
+        stats.hits++;
+        *out = line;
+        return PICO_OK;
+    }
+    // 空き行を先に探す (消去で空いた行は last_use が新しいままなので、LRU と混ぜると
+    // 使用中の行を追い出してしまう)
+    line = NULL;
+    for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+        if (lines[i].base == UINT32_MAX) {
+            line = &lines[i];
+            break;
+        }
+    }
+    if (line == NULL) {
+        line = &lines[0];
+        for (uint32_t i = 1; i < BLOCKDEV_CACHE_LINES; ++i) {
+            if (lines[i].last_use < line->last_use) {
+                line = &lines[i];
+            }
+        }
+    }
+    if (line->dirty) {
+        // 追い出すページと隣接するページもまとめて書き出す
+        int rc = write_back();
+        if (rc != PICO_OK) {
+            return rc;
+        }
+    }
+    line->base = UINT32_MAX;
+    if (base >= erased_lo && base + page_size <= erased_hi) {
+        memset(line->data, 0xff, page_size);
+    } else {
+        stats.misses++;
+        int rc = dev->read(base, line->data, page_size);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+    }
+    line->base = base;
+    line->dirty = false;
+    line->last_use = ++use_clock;
+    *out = line;
+    return PICO_OK;
+}
+
+int blockdev_read(uint32_t offset, void *dst, size_t len) {
+    uint8_t *p = dst;
+    while (len > 0) {
+        uint32_t base = offset - offset % page_size;
+        uint32_t in = offset - base;
+        uint32_t n = page_size - in < len ? page_size - in : (uint32_t)len;
+        cache_line *line = find_line(base);
+        if (line != NULL) {
+            stats.hits++;
+            memcpy(p, line->data + in, n);
+        } else {
+            // 読み出しだけのページはキャッシュに載せない (書き込み用の行を守る)
+            stats.misses++;
+            int rc = dev->read(offset, p, n);
+            if (rc != PICO_OK) {
+                return rc;
+            }
+        }
+        p += n;
+        offset += n;
+        len -= n;
+    }
+    return PICO_OK;
+}
+
+int blockdev_write(uint32_t offset, const void *src, size_t len) {
+    const uint8_t *p = src;
+    while (len > 0) {
+        uint32_t base = offset - offset % page_size;
+        uint32_t in = offset - base;
+        uint32_t n = page_size - in < len ? page_size - in : (uint32_t)len;
+        cache_line *line;
+        int rc = load_line(base, &line);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        memcpy(line->data + in, p, n);
+        line->dirty = true;
+        p += n;
+        offset += n;
+        len -= n;
+    }
+    return PICO_OK;
+}
+
+int blockdev_erase(uint32_t offset, size_t len) {
+    for (uint32_t i = 0; i < BLOCKDEV_CACHE_LINES; ++i) {
+        if (lines[i].base != UINT32_MAX && lines[i].base >= offset && lines[i].base < offset + len) {
+            lines[i].base = UINT32_MAX;
+            lines[i].dirty = false;
+        }
+    }
+    int rc = dev->erase(offset, len);
+    if (rc == PICO_OK) {
+        erased_lo = offset;
+        erased_hi = offset + (uint32_t)len;
+    }
+    return rc;
+}
+
+int blockdev_flush(void) {
+    return write_back();
+}
+
+int blockdev_sleep(void) {
+    int rc = blockdev_flush();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    return dev->sleep();
+}
+
+uint32_t blockdev_size(void) {
+    return dev->size();
+}
+
+void blockdev_get_stats(blockdev_stats *out) {
+    *out = stats;
+}
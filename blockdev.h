@@ -0,0 +1,37 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "storage.h"
+
+// ストレージバックエンドの上に置くライトバックキャッシュ。
+// 上位層 (ログ、インデックス) は任意のオフセット/長さで書き込み、
+// デバイスへはページ単位 (隣接ページはまとめて) でしかプログラムしない。
+
+#ifndef BLOCKDEV_CACHE_LINES
+#define BLOCKDEV_CACHE_LINES 4u
+#endif
+
+typedef struct {
+    uint32_t hits;     // キャッシュ上で完結した読み書き (ページ単位)
+    uint32_t misses;   // デバイスからの読み込みが必要だった回数
+    uint32_t flushes;  // ダーティページを書き出した回数 (明示的なフラッシュと追い出し)
+    uint32_t programs; // デバイスへのプログラム命令の回数 (隣接ページは1回にまとめる)
+    uint32_t pages;    // プログラムしたページ数
+} blockdev_stats;
+
+int blockdev_init(const storage_backend *backend);
+int blockdev_read(uint32_t offset, void *dst, size_t len);
+int blockdev_write(uint32_t offset, const void *src, size_t len);
+// 消去範囲のキャッシュは破棄する (未書き出しのデータも含む)
+int blockdev_erase(uint32_t offset, size_t len);
+// ダーティなページをすべて書き出す (書き込み順序のバリアとしても使う)
+int blockdev_flush(void);
+// 書き出してからバックエンドを低消費電力状態にする (スリープ直前に呼ぶ)
+int blockdev_sleep(void);
+
+uint32_t blockdev_size(void);
+void blockdev_get_stats(blockdev_stats *stats);
+
+#endif
@@ -0,0 +1,72 @@
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/structs/pads_bank0.h"
+#include "board_pins.h"
+
+typedef struct {
+    uint8_t gpio;
+    uint8_t func; // enum gpio_function
+    uint8_t idle; // pin_idle
+    uint8_t pull; // pin_pull
+    uint8_t sleep; // pin_sleep
+} board_pin;
+
+#define BOARD_PIN_ENTRY(gpio, func, idle, pull, drive, sleep) {gpio, func, idle, pull, sleep},
+static const board_pin pins[] = {BOARD_PIN_TABLE(BOARD_PIN_ENTRY)};
+
+// 最小漏れ電流の状態: 機能なし・入力バッファ無効・出力無効・プルなし
+static void pin_off(uint gpio) {
+    gpio_set_function(gpio, GPIO_FUNC_NULL);
+    gpio_disable_pulls(gpio);
+    gpio_set_input_enabled(gpio, false);
+    hw_set_bits(&pads_bank0_hw->io[gpio], PADS_BANK0_GPIO0_OD_BITS);
+}
+
+// 起動時の状態にする。ドライバは使うときに機能を切り替え、使い終えたらこの状態に戻してよい
+static void pin_idle_apply(const board_pin *p) {
+    if (p->idle == PIN_IDLE_ANALOG) {
+        pin_off(p->gpio);
+        return;
+    }
+    gpio_init(p->gpio); // SIO 入力 (パッドの分離も解除される)
+    gpio_set_pulls(p->gpio, p->pull == PIN_PULL_UP, p->pull == PIN_PULL_DOWN);
+    if (p->idle != PIN_IDLE_IN) {
+        gpio_put(p->gpio, p->idle == PIN_IDLE_OUT_HIGH);
+        gpio_set_dir(p->gpio, GPIO_OUT);
+    }
+}
+
+void board_pins_init(void) {
+    uint64_t used = 0;
+    for (uint i = 0; i < count_of(pins); ++i) {
+        used |= 1ull << pins[i].gpio;
+        pin_idle_apply(&pins[i]);
+    }
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; ++gpio) {
+        if (!(used & (1ull << gpio))) {
+            pin_off(gpio);
+        }
+    }
+}
+
+void board_pins_sleep(void) {
+    for (uint i = 0; i < count_of(pins); ++i) {
+        const board_pin *p = &pins[i];
+        switch (p->sleep) {
+            case PIN_SLEEP_RETAIN:
+                // SPI などの周辺機能はリセット中だと出力が定まらないので、SIO の起動時の状態で保持する
+                if (p->func != GPIO_FUNC_SIO) {
+                    pin_idle_apply(p);
+                }
+                break;
+            case PIN_SLEEP_PULL:
+                pin_off(p->gpio);
+                gpio_set_pulls(p->gpio, p->pull == PIN_PULL_UP, p->pull == PIN_PULL_DOWN);
+                break;
+            default:
+                pin_off(p->gpio);
+                break;
+        }
+    }
+    // 未使用ピンは board_pins_init() で止めたまま
+}
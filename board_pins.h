@@ -0,0 +1,148 @@
+#ifndef BOARD_PINS_H
+#define BOARD_PINS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 基板のピン割り当て。各ドライバのピン番号はここで決め、起動時とスリープ直前の
+// ピン状態は下の BOARD_PIN_TABLE から board_pins.c が生成する。
+// 表にないピンは未使用として最も漏れ電流の少ない状態 (機能なし・入出力バッファ無効・プルなし) にする。
+// ピンを追加・変更したら tools/check_pins.py (ビルド時に実行) が浮いたピンや重複を報告する。
+
+// --- ピン番号 ---
+#ifndef WAKE_PIN
+#define WAKE_PIN 0 // 加速度センサーの割り込み (INT1)
+#endif
+#ifndef SENSOR_INT2_PIN
+#define SENSOR_INT2_PIN 1 // 加速度センサーの割り込み (INT2)
+#endif
+
+#ifndef FW_UPDATE_PIN_TX
+#define FW_UPDATE_PIN_TX 4
+#endif
+#ifndef FW_UPDATE_PIN_RX
+#define FW_UPDATE_PIN_RX 5 // ホスト接続の検出を兼ねる (未接続はプルダウンで Low)
+#endif
+
+#ifndef STORAGE_SD_PIN_SCK
+#define STORAGE_SD_PIN_SCK 10
+#endif
+#ifndef STORAGE_SD_PIN_MOSI
+#define STORAGE_SD_PIN_MOSI 11
+#endif
+#ifndef STORAGE_SD_PIN_MISO
+#define STORAGE_SD_PIN_MISO 12
+#endif
+#ifndef STORAGE_SD_PIN_CS
+#define STORAGE_SD_PIN_CS 13
+#endif
+
+// SPI0 は外付け NOR と無線チップで共用し、CS で切り替える
+#ifndef STORAGE_NOR_PIN_MISO
+#define STORAGE_NOR_PIN_MISO 16
+#endif
+#ifndef STORAGE_NOR_PIN_CS
+#define STORAGE_NOR_PIN_CS 17
+#endif
+#ifndef STORAGE_NOR_PIN_SCK
+#define STORAGE_NOR_PIN_SCK 18
+#endif
+#ifndef STORAGE_NOR_PIN_MOSI
+#define STORAGE_NOR_PIN_MOSI 19
+#endif
+#ifndef LORA_PIN_MISO
+#define LORA_PIN_MISO STORAGE_NOR_PIN_MISO
+#endif
+#ifndef LORA_PIN_SCK
+#define LORA_PIN_SCK STORAGE_NOR_PIN_SCK
+#endif
+#ifndef LORA_PIN_MOSI
+#define LORA_PIN_MOSI STORAGE_NOR_PIN_MOSI
+#endif
+#ifndef LORA_PIN_CS
+#define LORA_PIN_CS 20
+#endif
+#ifndef LORA_PIN_RESET
+#define LORA_PIN_RESET 21 // 無線チップ側に内部プルアップがある
+#endif
+
+#ifndef SUPPLY_GOOD_PIN
+#define SUPPLY_GOOD_PIN 22 // 電圧が戻ると High になる入力 (電源監視 IC や充電 IC の PGOOD)
+#endif
+
+#ifndef VBUS_DETECT_PIN
+#define VBUS_DETECT_PIN 24 // Pico 2: USB 給電の検出 (分圧)
+#endif
+
+#ifndef PICO_DEFAULT_LED_PIN
+#define PICO_DEFAULT_LED_PIN 25
+#endif
+
+#ifndef SOLAR_PANEL_ADC_PIN
+#define SOLAR_PANEL_ADC_PIN 26 // パネル電圧 (分圧)
+#endif
+#ifndef SOLAR_CURRENT_ADC_PIN
+#define SOLAR_CURRENT_ADC_PIN 27 // 充電電流 (シャントアンプ出力)
+#endif
+#ifndef SUPPLY_ADC_PIN
+#define SUPPLY_ADC_PIN 29 // Pico 2: VSYS/3
+#endif
+
+// --- ピンの属性 ---
+
+// 起動時 (ドライバが使い始めるまで) の状態
+typedef enum {
+    PIN_IDLE_IN,       // 入力
+    PIN_IDLE_OUT_LOW,  // Low 出力
+    PIN_IDLE_OUT_HIGH, // High 出力 (CS など)
+    PIN_IDLE_ANALOG,   // ADC 入力 (デジタル入力バッファ無効)
+} pin_idle;
+
+typedef enum {
+    PIN_PULL_NONE,
+    PIN_PULL_UP,
+    PIN_PULL_DOWN,
+} pin_pull;
+
+// 相手側がレベルを決めているか (プルなしの入力でも浮かない)
+typedef enum {
+    PIN_FLOATS,
+    PIN_DRIVEN,
+} pin_drive;
+
+// スリープ直前の状態。電源断中のパッドは電源断直前の状態を保持する
+typedef enum {
+    PIN_SLEEP_RETAIN, // そのまま保持する (CS の High、ウェイク入力など)
+    PIN_SLEEP_OFF,    // 未使用ピンと同じく入出力バッファ無効・プルなし
+    PIN_SLEEP_PULL,   // 入出力バッファ無効で、表のプルだけ残す (相手の入力を浮かせない)
+} pin_sleep;
+
+// PIN(ピン, 使用中の機能, 起動時の状態, プル, 相手が駆動するか, スリープ時)
+#define BOARD_PIN_TABLE(PIN) \
+    PIN(WAKE_PIN,              GPIO_FUNC_SIO,  PIN_IDLE_IN,       PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_RETAIN) \
+    PIN(SENSOR_INT2_PIN,       GPIO_FUNC_SIO,  PIN_IDLE_IN,       PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_RETAIN) \
+    PIN(FW_UPDATE_PIN_TX,      GPIO_FUNC_UART, PIN_IDLE_IN,       PIN_PULL_DOWN, PIN_FLOATS, PIN_SLEEP_OFF)    \
+    PIN(FW_UPDATE_PIN_RX,      GPIO_FUNC_UART, PIN_IDLE_IN,       PIN_PULL_DOWN, PIN_FLOATS, PIN_SLEEP_PULL)   \
+    PIN(STORAGE_SD_PIN_SCK,    GPIO_FUNC_SPI,  PIN_IDLE_OUT_LOW,  PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(STORAGE_SD_PIN_MOSI,   GPIO_FUNC_SPI,  PIN_IDLE_OUT_HIGH, PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(STORAGE_SD_PIN_MISO,   GPIO_FUNC_SPI,  PIN_IDLE_IN,       PIN_PULL_UP,   PIN_FLOATS, PIN_SLEEP_PULL)   \
+    PIN(STORAGE_SD_PIN_CS,     GPIO_FUNC_SIO,  PIN_IDLE_OUT_HIGH, PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(STORAGE_NOR_PIN_MISO,  GPIO_FUNC_SPI,  PIN_IDLE_IN,       PIN_PULL_DOWN, PIN_FLOATS, PIN_SLEEP_PULL)   \
+    PIN(STORAGE_NOR_PIN_CS,    GPIO_FUNC_SIO,  PIN_IDLE_OUT_HIGH, PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(STORAGE_NOR_PIN_SCK,   GPIO_FUNC_SPI,  PIN_IDLE_OUT_LOW,  PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(STORAGE_NOR_PIN_MOSI,  GPIO_FUNC_SPI,  PIN_IDLE_OUT_LOW,  PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(LORA_PIN_CS,           GPIO_FUNC_SIO,  PIN_IDLE_OUT_HIGH, PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_RETAIN) \
+    PIN(LORA_PIN_RESET,        GPIO_FUNC_SIO,  PIN_IDLE_IN,       PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_OFF)    \
+    PIN(SUPPLY_GOOD_PIN,       GPIO_FUNC_SIO,  PIN_IDLE_IN,       PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_RETAIN) \
+    PIN(VBUS_DETECT_PIN,       GPIO_FUNC_SIO,  PIN_IDLE_IN,       PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_RETAIN) \
+    PIN(PICO_DEFAULT_LED_PIN,  GPIO_FUNC_SIO,  PIN_IDLE_OUT_LOW,  PIN_PULL_NONE, PIN_FLOATS, PIN_SLEEP_OFF)    \
+    PIN(SOLAR_PANEL_ADC_PIN,   GPIO_FUNC_NULL, PIN_IDLE_ANALOG,   PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_OFF)    \
+    PIN(SOLAR_CURRENT_ADC_PIN, GPIO_FUNC_NULL, PIN_IDLE_ANALOG,   PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_OFF)    \
+    PIN(SUPPLY_ADC_PIN,        GPIO_FUNC_NULL, PIN_IDLE_ANALOG,   PIN_PULL_NONE, PIN_DRIVEN, PIN_SLEEP_OFF)
+
+// 表のとおりに全ピンを初期化する (未使用ピンは最小漏れ電流の状態)。起動直後に1回呼ぶ
+void board_pins_init(void);
+// 電源断の直前に呼ぶ。ドライバが使い終えたピンを表のスリープ時の状態にする
+void board_pins_sleep(void);
+
+#endif
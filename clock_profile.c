@@ -0,0 +1,96 @@
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "clock_profile.h"
+
+typedef struct {
+    uint32_t sys_khz;
+    enum vreg_voltage vsel;
+} clock_pair;
+
+// 各プロファイルの (周波数, 電圧)。周波数の低い順に並べる
+static const clock_pair profiles[CLOCK_PROFILE_COUNT] = {
+    [CLOCK_PROFILE_LOW] = {48000, VREG_VOLTAGE_0_95},
+    [CLOCK_PROFILE_MID] = {96000, VREG_VOLTAGE_1_05},
+    [CLOCK_PROFILE_BURST] = {150000, VREG_VOLTAGE_1_10},
+};
+
+// 安全範囲: この周波数まではこの電圧以上で動かす (既定の 150MHz@1.10V を上限とし、低い側は余裕を持たせた値)
+static const clock_pair limits[] = {
+    {48000, VREG_VOLTAGE_0_95},
+    {100000, VREG_VOLTAGE_1_05},
+    {150000, VREG_VOLTAGE_1_10},
+};
+
+#define VALIDATE_PENDING 1
+
+static int validated = VALIDATE_PENDING;
+static clock_profile_id current = CLOCK_PROFILE_BURST; // 最初の clock_profile_set() までは不定 (電圧は既定値)
+static enum vreg_voltage vsel_now = VREG_VOLTAGE_DEFAULT;
+
+static bool pair_is_safe(const clock_pair *p) {
+    for (uint i = 0; i < count_of(limits); ++i) {
+        if (p->sys_khz <= limits[i].sys_khz) {
+            return p->vsel >= limits[i].vsel && p->vsel <= VREG_VOLTAGE_1_30;
+        }
+    }
+    return false; // 上限を超える周波数
+}
+
+static int validate(void) {
+    for (uint i = 0; i < CLOCK_PROFILE_COUNT; ++i) {
+        const clock_pair *p = &profiles[i];
+        if (!pair_is_safe(p) || (i > 0 && (p->sys_khz <= profiles[i - 1].sys_khz || p->vsel < profiles[i - 1].vsel))) {
+            return PICO_ERROR_INVALID_ARG;
+        }
+        uint vco, postdiv1, postdiv2;
+        if (p->sys_khz * 1000u != USB_CLK_HZ && !check_sys_clock_khz(p->sys_khz, &vco, &postdiv1, &postdiv2)) {
+            return PICO_ERROR_INVALID_ARG;
+        }
+    }
+    return PICO_OK;
+}
+
+static void apply_clock(uint32_t sys_khz) {
+    if (sys_khz * 1000u == USB_CLK_HZ) {
+        set_sys_clock_48mhz(); // pll_usb から取り、pll_sys は止める
+    } else {
+        set_sys_clock_khz(sys_khz, true);
+    }
+    // set_sys_clock_* は clk_peri を clk_sys に付け替えるので、pll_usb の 48MHz に戻す
+    clock_configure_undivided(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+}
+
+int clock_profile_set(clock_profile_id id) {
+    if (validated == VALIDATE_PENDING) {
+        validated = validate();
+    }
+    if (validated != PICO_OK) {
+        return validated;
+    }
+    if ((uint)id >= CLOCK_PROFILE_COUNT) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    const clock_pair *to = &profiles[id];
+
+    // 上げるときは電圧を先に上げて安定を待つ
+    if (to->vsel > vsel_now) {
+        vreg_set_voltage(to->vsel);
+        busy_wait_us(CLOCK_PROFILE_VREG_SETTLE_US);
+        vsel_now = to->vsel;
+    }
+    if (clock_get_hz(clk_sys) != to->sys_khz * 1000u) {
+        apply_clock(to->sys_khz);
+    }
+    // 下げるときはクロックを下げてから電圧を下げる
+    if (to->vsel < vsel_now) {
+        vreg_set_voltage(to->vsel);
+        vsel_now = to->vsel;
+    }
+    current = id;
+    return PICO_OK;
+}
+
+clock_profile_id clock_profile_get(void) {
+    return current;
+}
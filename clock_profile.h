@@ -0,0 +1,29 @@
+#ifndef CLOCK_PROFILE_H
+#define CLOCK_PROFILE_H
+
+#include <stdint.h>
+
+// コア電圧とシステムクロックの組み合わせ (DVFS)。
+// 普段は低い周波数・低い電圧で動かし、計算の多い区間だけ CLOCK_PROFILE_BURST に上げる。
+// 切り替えは電圧と周波数の順序を自動で守る (上げるときは電圧が先、下げるときは周波数が先)。
+// clk_peri は pll_usb の 48MHz に固定するので、切り替えても UART/SPI のボーレートは変わらない
+// (ただし転送の途中では切り替えないこと)。
+
+typedef enum {
+    CLOCK_PROFILE_LOW,   // 通常の起床処理 (48MHz, pll_sys 停止)
+    CLOCK_PROFILE_MID,
+    CLOCK_PROFILE_BURST, // ハッシュ計算など
+    CLOCK_PROFILE_COUNT
+} clock_profile_id;
+
+// 電圧を上げてからクロックを上げるまでの待ち時間
+#ifndef CLOCK_PROFILE_VREG_SETTLE_US
+#define CLOCK_PROFILE_VREG_SETTLE_US 1000u
+#endif
+
+// 表の組み合わせを検証してから切り替える。
+// 表が安全範囲を外れているか、PLL で作れない周波数があれば PICO_ERROR_INVALID_ARG (切り替えない)
+int clock_profile_set(clock_profile_id id);
+clock_profile_id clock_profile_get(void);
+
+#endif
@@ -0,0 +1,105 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "config_store.h"
+#include "crc32.h"
+
+// 電源断に強い設定保存。
+// 2つのスロットを交互に使い、書き込みは「消去 → ヘッダ+データ → コミットマーク」の順。
+// 書き込み途中で電源が落ちても、もう一方のスロットの前回の設定が残る。
+
+#define CONFIG_MAGIC 0x47464e43u // "CNFG"
+#define COMMIT_MARK 0x54494d43u  // "CMIT"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t len;
+    uint32_t crc;
+    uint32_t commit;
+    uint32_t reserved;
+} config_hdr;
+
+_Static_assert(sizeof(config_hdr) == CONFIG_STORE_SLOT_SIZE - CONFIG_STORE_MAX_LEN, "header size mismatch");
+_Static_assert(CONFIG_STORE_OFFSET % FLASH_SECTOR_SIZE == 0, "config offset must be sector aligned");
+
+static inline const config_hdr *slot_hdr(uint32_t slot) {
+    return (const config_hdr *)(STORAGE_XIP_BASE + CONFIG_STORE_OFFSET + slot * CONFIG_STORE_SLOT_SIZE);
+}
+
+static bool slot_valid(uint32_t slot) {
+    const config_hdr *hdr = slot_hdr(slot);
+    if (hdr->magic != CONFIG_MAGIC || hdr->commit != COMMIT_MARK || hdr->len > CONFIG_STORE_MAX_LEN) {
+        return false;
+    }
+    return crc32_update(0, hdr + 1, hdr->len) == hdr->crc;
+}
+
+// 有効なスロットのうち seq が新しい方。なければ -1
+static int newest_slot(void) {
+    bool v0 = slot_valid(0);
+    bool v1 = slot_valid(1);
+    if (v0 && v1) {
+        return (int32_t)(slot_hdr(1)->seq - slot_hdr(0)->seq) > 0 ? 1 : 0;
+    }
+    return v0 ? 0 : v1 ? 1 : -1;
+}
+
+int config_store_load(void *buf, size_t buf_len, size_t *len) {
+    int slot = newest_slot();
+    if (slot < 0) {
+        return PICO_ERROR_NO_DATA;
+    }
+    const config_hdr *hdr = slot_hdr((uint32_t)slot);
+    size_t n = hdr->len < buf_len ? hdr->len : buf_len;
+    memcpy(buf, hdr + 1, n);
+    *len = hdr->len;
+    return hdr->len <= buf_len ? PICO_OK : PICO_ERROR_BUFFER_TOO_SMALL;
+}
+
+int config_store_save(const void *data, size_t len) {
+    if (len > CONFIG_STORE_MAX_LEN) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    int cur = newest_slot();
+    uint32_t slot = cur == 0 ? 1u : 0u;
+    uint32_t flash_offs = CONFIG_STORE_OFFSET + slot * CONFIG_STORE_SLOT_SIZE;
+
+    config_hdr hdr = {
+        .magic = CONFIG_MAGIC,
+        .seq = cur < 0 ? 1u : slot_hdr((uint32_t)cur)->seq + 1u,
+        .len = (uint32_t)len,
+        .crc = crc32_update(0, data, len),
+        .commit = UINT32_MAX,
+        .reserved = UINT32_MAX,
+    };
+
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(flash_offs, CONFIG_STORE_SLOT_SIZE);
+    restore_interrupts(ints);
+
+    // 1段階目: ヘッダ (コミットマーク未設定) とデータ
+    static uint8_t page[FLASH_PAGE_SIZE];
+    size_t total = sizeof(hdr) + len;
+    for (size_t base = 0; base < total; base += FLASH_PAGE_SIZE) {
+        memset(page, 0xff, sizeof(page));
+        for (size_t i = 0; i < FLASH_PAGE_SIZE && base + i < total; ++i) {
+            size_t pos = base + i;
+            page[i] = pos < sizeof(hdr) ? ((const uint8_t *)&hdr)[pos] : ((const uint8_t *)data)[pos - sizeof(hdr)];
+        }
+        ints = save_and_disable_interrupts();
+        flash_range_program(flash_offs + base, page, FLASH_PAGE_SIZE);
+        restore_interrupts(ints);
+    }
+
+    // 2段階目: コミットマークだけを書き込む (他のバイトは 0xff のまま)
+    memset(page, 0xff, sizeof(page));
+    const uint32_t mark = COMMIT_MARK;
+    memcpy(page + offsetof(config_hdr, commit), &mark, sizeof(mark));
+    ints = save_and_disable_interrupts();
+    flash_range_program(flash_offs, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+
+    return slot_valid(slot) ? PICO_OK : PICO_ERROR_IO;
+}
@@ -0,0 +1,21 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "storage.h"
+
+// 設定保存領域 (内蔵フラッシュの2セクタを交互に使う)。内蔵フラッシュのログ領域の直後に置く
+#ifndef CONFIG_STORE_OFFSET
+#define CONFIG_STORE_OFFSET (STORAGE_FLASH_OFFSET + STORAGE_FLASH_SIZE)
+#endif
+#define CONFIG_STORE_SLOT_SIZE 4096u
+#define CONFIG_STORE_MAX_LEN (CONFIG_STORE_SLOT_SIZE - 24u)
+
+// 最新のコミット済み設定を読み出す。有効な設定がなければ PICO_ERROR_NO_DATA
+int config_store_load(void *buf, size_t buf_len, size_t *len);
+// 古い方のスロットに書き込み、最後にコミットマークを書く
+int config_store_save(const void *data, size_t len);
+
+#endif
@@ -0,0 +1,15 @@
+#include "pico/platform.h"
+#include "crc32.h"
+
+// ログとテレメトリの全レコードで呼ばれるので SRAM に置く
+uint32_t __not_in_flash_func(crc32_update)(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
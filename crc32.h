@@ -0,0 +1,10 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, 反射多項式 0xedb88320)。crc は前回の戻り値 (初回は 0) で、分割して計算できる
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,24 @@
+#include "pico/stdlib.h"
+#include "config_store.h"
+#include "device_config.h"
+
+static void device_config_defaults(device_config *cfg) {
+    cfg->version = DEVICE_CONFIG_VERSION;
+    cfg->storage_backend = STORAGE_BACKEND_DEFAULT;
+    tilt_config_defaults(&cfg->tilt);
+}
+
+void device_config_load(device_config *cfg) {
+    device_config stored;
+    size_t len;
+    int rc = config_store_load(&stored, sizeof(stored), &len);
+    if (rc == PICO_OK && len == sizeof(stored) && stored.version == DEVICE_CONFIG_VERSION) {
+        *cfg = stored;
+        return;
+    }
+    device_config_defaults(cfg);
+}
+
+int device_config_save(const device_config *cfg) {
+    return config_store_save(cfg, sizeof(*cfg));
+}
@@ -0,0 +1,25 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <stdint.h>
+#include "tilt.h"
+
+// 内蔵フラッシュ (config_store) に保存する装置設定
+#define DEVICE_CONFIG_VERSION 2u
+
+// ビルド時の既定のログ保存先 (storage_id)
+#ifndef STORAGE_BACKEND_DEFAULT
+#define STORAGE_BACKEND_DEFAULT 0
+#endif
+
+typedef struct {
+    uint32_t version;
+    uint32_t storage_backend; // storage_id
+    tilt_config tilt;         // 取り付け向き・ゼロ点・出力形式
+} device_config;
+
+// 保存済みの設定を読む。なければ (または版が違えば) 既定値
+void device_config_load(device_config *cfg);
+int device_config_save(const device_config *cfg);
+
+#endif
@@ -0,0 +1,214 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "crc32.h"
+#include "storage.h"
+#include "drift.h"
+
+// 状態のリング。1要約ごとに次のスロットに追記し、セクタの先頭に来たときだけ消去する
+// (1時間ごとでも各セクタの消去は 64 時間に1回)
+#define SLOT_SIZE 64u
+#define SLOTS_PER_SECTOR (FLASH_SECTOR_SIZE / SLOT_SIZE)
+#define SLOT_COUNT (DRIFT_STORE_SECTORS * SLOTS_PER_SECTOR)
+#define SLOT_EMPTY UINT32_MAX
+
+#define SECONDS_PER_DAY 86400.0f
+#define CDEG_TO_RAD (3.14159265f / 18000.0f)
+#define RATE_FLAGS (DRIFT_FLAG_RATE_PITCH | DRIFT_FLAG_RATE_ROLL)
+#define CHANGE_FLAGS (DRIFT_FLAG_CHANGE_PITCH | DRIFT_FLAG_CHANGE_ROLL)
+
+typedef struct {
+    uint32_t seq;       // SLOT_EMPTY = 空き
+    uint32_t last_s;    // 最後の要約の時刻 (powman タイマー, s)
+    uint16_t intervals; // 回帰に入っている要約の数
+    uint8_t flags;      // 前回の要約で出ていた速度の警報 (DRIFT_FLAG_RATE_*)
+    uint8_t reserved;
+    // 指数重み付きの和。時刻は最後の要約を 0 とした日数、傾斜は 0.01°
+    float s0, st, stt;
+    float sy[2], sty[2];
+    float cusum_pos[2], cusum_neg[2];
+    uint32_t reserved2;
+    uint32_t crc; // ここまでの CRC
+} drift_slot;
+
+_Static_assert(sizeof(drift_slot) == SLOT_SIZE, "drift slot size mismatch");
+_Static_assert(FLASH_PAGE_SIZE % SLOT_SIZE == 0, "slots must not straddle pages");
+_Static_assert(DRIFT_STORE_OFFSET % FLASH_SECTOR_SIZE == 0, "drift store must be sector aligned");
+
+static drift_slot state;
+static int32_t newest = -1; // state を読んだスロット (-1 = なし)
+static bool loaded;
+
+static inline const drift_slot *slot_at(uint32_t idx) {
+    return (const drift_slot *)(STORAGE_XIP_BASE + DRIFT_STORE_OFFSET + idx * SLOT_SIZE);
+}
+
+static bool slot_valid(const drift_slot *s) {
+    return s->seq != SLOT_EMPTY && crc32_update(0, s, offsetof(drift_slot, crc)) == s->crc;
+}
+
+// seq が最大の有効なスロットを読む。書き込み途中で壊れたものは飛ばして1つ前を使う
+static void load(void) {
+    loaded = true;
+    newest = -1;
+    uint32_t limit = SLOT_EMPTY;
+    while (newest < 0) {
+        int32_t best = -1;
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i) {
+            uint32_t seq = slot_at(i)->seq;
+            if (seq < limit && (best < 0 || seq > slot_at((uint32_t)best)->seq)) {
+                best = (int32_t)i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        if (slot_valid(slot_at((uint32_t)best))) {
+            newest = best;
+        } else {
+            limit = slot_at((uint32_t)best)->seq;
+        }
+    }
+    if (newest >= 0) {
+        state = *slot_at((uint32_t)newest);
+    } else {
+        memset(&state, 0, sizeof(state));
+    }
+}
+
+static int save(void) {
+    uint32_t idx = newest < 0 ? 0u : ((uint32_t)newest + 1u) % SLOT_COUNT;
+    // 途中のスロットが空いていなければ (前回の書き込みが壊れたなど) 次のセクタから書く
+    if (idx % SLOTS_PER_SECTOR != 0 && slot_at(idx)->seq != SLOT_EMPTY) {
+        idx = (idx / SLOTS_PER_SECTOR + 1u) % DRIFT_STORE_SECTORS * SLOTS_PER_SECTOR;
+    }
+    state.seq++;
+    state.crc = crc32_update(0, &state, offsetof(drift_slot, crc));
+
+    uint32_t offs = DRIFT_STORE_OFFSET + idx * SLOT_SIZE;
+    uint32_t ints;
+    if (idx % SLOTS_PER_SECTOR == 0) {
+        // 最新の状態はもう一方のセクタに残っている
+        ints = save_and_disable_interrupts();
+        flash_range_erase(offs, FLASH_SECTOR_SIZE);
+        restore_interrupts(ints);
+    }
+
+    // ページの他のスロットは 0xff のまま書くので変わらない
+    static uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t page_offs = offs & ~(FLASH_PAGE_SIZE - 1u);
+    memset(page, 0xff, sizeof(page));
+    memcpy(page + (offs - page_offs), &state, sizeof(state));
+    ints = save_and_disable_interrupts();
+    flash_range_program(page_offs, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+
+    if (!slot_valid(slot_at(idx))) {
+        return PICO_ERROR_IO;
+    }
+    newest = (int32_t)idx;
+    return PICO_OK;
+}
+
+static void reset_fit(void) {
+    state.intervals = 0;
+    state.flags = 0;
+    state.s0 = state.st = state.stt = 0.0f;
+    for (uint ch = 0; ch < 2; ++ch) {
+        state.sy[ch] = state.sty[ch] = 0.0f;
+        state.cusum_pos[ch] = state.cusum_neg[ch] = 0.0f;
+    }
+}
+
+// 傾き (0.01°/日)。点が足りなければ 0
+static float fit_slope(uint ch) {
+    float d = state.s0 * state.stt - state.st * state.st;
+    if (state.intervals < 2 || d <= 0.0f) {
+        return 0.0f;
+    }
+    return (state.s0 * state.sty[ch] - state.st * state.sy[ch]) / d;
+}
+
+// 古い点を減衰させ、時刻の原点を dt 日後 (新しい点) に移す
+static void decay_and_rebase(float dt) {
+    float w = expf(-dt * SECONDS_PER_DAY / (float)DRIFT_WINDOW_S);
+    state.stt = w * (state.stt - 2.0f * dt * state.st + dt * dt * state.s0);
+    for (uint ch = 0; ch < 2; ++ch) {
+        state.sty[ch] = w * (state.sty[ch] - dt * state.sy[ch]);
+        state.sy[ch] *= w;
+    }
+    state.st = w * (state.st - dt * state.s0);
+    state.s0 *= w;
+}
+
+int drift_add(uint64_t now_ms, const tilt_record *tilt, drift_record *out) {
+    if (tilt->output == TILT_OUTPUT_GRAVITY) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (!loaded) {
+        load();
+    }
+    uint32_t now_s = (uint32_t)(now_ms / 1000u);
+    bool restart = state.intervals == 0 || now_s < state.last_s;
+    if (!restart && now_s - state.last_s < DRIFT_INTERVAL_S) {
+        return PICO_ERROR_NO_DATA;
+    }
+
+    float y[2] = {(float)tilt->v[0], (float)tilt->v[1]};
+    uint8_t flags = 0;
+    if (restart) {
+        reset_fit();
+    } else {
+        // 変化点: これまでの回帰による予測と新しい点の差を積み、どちらかの向きに溜まったら検出
+        float dt = (float)(now_s - state.last_s) / SECONDS_PER_DAY;
+        for (uint ch = 0; ch < 2; ++ch) {
+            if (state.intervals < 2) {
+                continue;
+            }
+            float b = fit_slope(ch);
+            float predicted = (state.sy[ch] - b * state.st) / state.s0 + b * dt;
+            float r = y[ch] - predicted;
+            state.cusum_pos[ch] = fmaxf(0.0f, state.cusum_pos[ch] + r - DRIFT_CUSUM_K_CDEG);
+            state.cusum_neg[ch] = fmaxf(0.0f, state.cusum_neg[ch] - r - DRIFT_CUSUM_K_CDEG);
+            if (state.cusum_pos[ch] > DRIFT_CUSUM_H_CDEG || state.cusum_neg[ch] > DRIFT_CUSUM_H_CDEG) {
+                flags |= (uint8_t)(DRIFT_FLAG_CHANGE_PITCH << ch);
+            }
+        }
+        if (flags & CHANGE_FLAGS) {
+            reset_fit();
+        } else {
+            decay_and_rebase(dt);
+        }
+    }
+
+    // 新しい点 (時刻 0、重み 1)
+    state.s0 += 1.0f;
+    state.sy[0] += y[0];
+    state.sy[1] += y[1];
+    if (state.intervals < UINT16_MAX) {
+        state.intervals++;
+    }
+    state.last_s = now_s;
+
+    out->tag = DRIFT_RECORD_TAG;
+    out->intervals = state.intervals;
+    for (uint ch = 0; ch < 2; ++ch) {
+        float slope = fit_slope(ch);
+        out->rate_mdeg_per_day[ch] = (int32_t)lroundf(slope * 10.0f);
+        out->creep_um_per_day[ch] = (int32_t)lroundf((float)DRIFT_LEVER_MM * 1000.0f * slope * CDEG_TO_RAD);
+        if (state.intervals >= DRIFT_MIN_INTERVALS &&
+            abs(out->rate_mdeg_per_day[ch]) >= DRIFT_RATE_ALERT_MDEG_PER_DAY) {
+            flags |= (uint8_t)(DRIFT_FLAG_RATE_PITCH << ch);
+        }
+    }
+    // 速度の警報は出始めたときだけ、変化点は毎回イベントにする
+    if ((flags & RATE_FLAGS & ~state.flags) || (flags & CHANGE_FLAGS)) {
+        flags |= DRIFT_FLAG_NEW_ALERT;
+    }
+    state.flags = flags & RATE_FLAGS;
+    out->flags = flags;
+    return save();
+}
@@ -0,0 +1,72 @@
+#ifndef DRIFT_H
+#define DRIFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry_queue.h"
+#include "tilt.h"
+
+// 長期の傾斜変化 (クリープ) の解析。
+// 瞬間の傾きではなく、日単位の変化速度を見る。DRIFT_INTERVAL_S ごとに傾斜 (ピッチ・ロール) を1点ずつ
+// 指数重み付きの線形回帰 (時定数 DRIFT_WINDOW_S) に入れ、傾きを速度 (°/日) とする。
+// 回帰の和は要約1回ごとに O(1) で更新し、内蔵フラッシュのリング (2セクタ) に追記して電源断をまたぐ。
+// 要約の間の起床では最新の状態の時刻を見るだけで、何も計算しない。
+// 変化点は、回帰の予測と新しい点との差の CUSUM (両側) で検出し、検出したら回帰をやり直す
+// (新しい速度を古い期間と混ぜない)。
+// powman タイマーが巻き戻った (チップリセット) ときも、経過時間が分からないのでやり直す。
+
+// 要約の間隔と回帰の時定数
+#ifndef DRIFT_INTERVAL_S
+#define DRIFT_INTERVAL_S 3600u
+#endif
+#ifndef DRIFT_WINDOW_S
+#define DRIFT_WINDOW_S (7u * 24u * 3600u)
+#endif
+// 速度の警報しきい値 (0.001°/日) と、警報を出すのに必要な要約の数
+#ifndef DRIFT_RATE_ALERT_MDEG_PER_DAY
+#define DRIFT_RATE_ALERT_MDEG_PER_DAY 100
+#endif
+#ifndef DRIFT_MIN_INTERVALS
+#define DRIFT_MIN_INTERVALS 24u
+#endif
+// CUSUM の許容幅としきい値 (0.01°)
+#ifndef DRIFT_CUSUM_K_CDEG
+#define DRIFT_CUSUM_K_CDEG 2.0f
+#endif
+#ifndef DRIFT_CUSUM_H_CDEG
+#define DRIFT_CUSUM_H_CDEG 20.0f
+#endif
+// 傾斜を変位に換算する腕の長さ (mm)。傾斜計の取り付け高さなど
+#ifndef DRIFT_LEVER_MM
+#define DRIFT_LEVER_MM 1000u
+#endif
+
+// 状態の保存領域 (内蔵フラッシュ、テレメトリの退避領域の直後)
+#ifndef DRIFT_STORE_OFFSET
+#define DRIFT_STORE_OFFSET (TQ_SPILL_OFFSET + TQ_SPILL_SECTORS * 4096u)
+#endif
+#define DRIFT_STORE_SECTORS 2u
+
+// ログ・テレメトリに書く記録 (要約ごと)
+#define DRIFT_RECORD_TAG 0x44u // 'D'
+
+#define DRIFT_FLAG_RATE_PITCH   (1u << 0) // 速度がしきい値を超えている
+#define DRIFT_FLAG_RATE_ROLL    (1u << 1)
+#define DRIFT_FLAG_CHANGE_PITCH (1u << 2) // 今回の要約で変化点を検出した
+#define DRIFT_FLAG_CHANGE_ROLL  (1u << 3)
+#define DRIFT_FLAG_NEW_ALERT    (1u << 7) // 前回の要約になかった警報がある (イベントとして送る)
+
+typedef struct {
+    uint8_t tag;
+    uint8_t flags;                 // DRIFT_FLAG_*
+    uint16_t intervals;            // 回帰に入っている要約の数
+    int32_t rate_mdeg_per_day[2];  // ピッチ・ロールの速度
+    int32_t creep_um_per_day[2];   // DRIFT_LEVER_MM の先端の変位速度
+} drift_record;
+
+// 傾斜 (TILT_OUTPUT_PITCH_ROLL または TILT_OUTPUT_AXIS_ANGLES の v[0], v[1]) を渡す。
+// 前回の要約から DRIFT_INTERVAL_S 経っていれば回帰を更新して保存し、out に結果を書いて PICO_OK。
+// まだなら PICO_ERROR_NO_DATA (何もしない)。重力ベクトル出力は PICO_ERROR_INVALID_ARG
+int drift_add(uint64_t now_ms, const tilt_record *tilt, drift_record *out);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "fixed_trig.h"
+
+// 表は const にしない (.data として SRAM に置き、フラッシュを止めていても読めるようにする)
+
+// atan(2^-i) (° × 2^22)
+#define CORDIC_ANGLE_Q 22
+static int32_t cordic_angles[] = {
+    188743680, 111421900, 58872272, 29884485, 15000234, 7507429, 3754631, 1877430,
+    938729,    469366,    234683,   117342,   58671,    29335,   14668,   7334,
+    3667,      1833,      917,      458,      229,      115,     57,      29,
+};
+// 段階ごとの反復回数 (ホストで全範囲の最大誤差を確かめた値)
+static uint8_t cordic_iterations[FIXED_TRIG_TIER_COUNT] = {11, 14, 19};
+// CORDIC の利得の逆数 (1 / 1.6467602581, Q32)
+#define CORDIC_INV_GAIN_Q32 2608131496u
+
+// atan(t) ≈ t·(c0 + c1·t² + c2·t⁴ + ...) の [0, 1] でのミニマックス係数 (Q30)。
+// 近似誤差は 5次 0.035°、7次 0.0047°、11次 0.000095°
+#define POLY_Q 30
+static int32_t poly_5[] = {1068757466, -309978783, 85189647};
+static int32_t poly_7[] = {1072897662, -344858997, 157050272, -41861451};
+static int32_t poly_11[] = {1073717363, -357151042, 207812396, -125011983, 56529663, -12583326};
+static const int32_t *poly_coeffs[FIXED_TRIG_TIER_COUNT] = {poly_5, poly_7, poly_11};
+static uint8_t poly_terms[FIXED_TRIG_TIER_COUNT] = {count_of(poly_5), count_of(poly_7), count_of(poly_11)};
+// 180000 / π (Q16)
+#define RAD_TO_MDEG_Q16 3754936206u
+
+static __force_inline uint32_t abs_u32(int32_t v) {
+    return v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+}
+
+int32_t __not_in_flash_func(fixed_atan2_hypot)(int32_t y, int32_t x, fixed_trig_tier tier, uint32_t *hypot_q8) {
+    uint32_t m = MAX(abs_u32(x), abs_u32(y));
+    if (m == 0) {
+        if (hypot_q8) {
+            *hypot_q8 = 0;
+        }
+        return 0;
+    }
+
+    // 大きい方が [2^28, 2^29) に入るように揃える (利得 1.65 倍と √2 倍でも int32 に収まる)
+    int shift = __builtin_clz(m) - 3;
+    int32_t xs = shift >= 0 ? (int32_t)((uint32_t)x << shift) : x >> -shift;
+    int32_t ys = shift >= 0 ? (int32_t)((uint32_t)y << shift) : y >> -shift;
+
+    // 右半平面に移す (180° 回す)
+    int32_t base_mdeg = 0;
+    if (xs < 0) {
+        base_mdeg = y >= 0 ? 180000 : -180000;
+        xs = -xs;
+        ys = -ys;
+    }
+
+    int32_t z = 0;
+    uint n = cordic_iterations[tier];
+    for (uint i = 0; i < n; ++i) {
+        int32_t dx = ys >> i;
+        int32_t dy = xs >> i;
+        if (ys > 0) {
+            xs += dx;
+            ys -= dy;
+            z += cordic_angles[i];
+        } else {
+            xs -= dx;
+            ys += dy;
+            z -= cordic_angles[i];
+        }
+    }
+
+    if (hypot_q8) {
+        // xs = 利得 × 長さ × 2^shift
+        *hypot_q8 = (uint32_t)(((uint64_t)(uint32_t)xs * CORDIC_INV_GAIN_Q32) >> (32 - 8 + shift));
+    }
+    return base_mdeg + (int32_t)(((int64_t)z * 1000 + (1 << (CORDIC_ANGLE_Q - 1))) >> CORDIC_ANGLE_Q);
+}
+
+int32_t __not_in_flash_func(fixed_atan2_cordic)(int32_t y, int32_t x, fixed_trig_tier tier) {
+    return fixed_atan2_hypot(y, x, tier, NULL);
+}
+
+int32_t fixed_atan2_poly(int32_t y, int32_t x, fixed_trig_tier tier) {
+    uint32_t ax = abs_u32(x), ay = abs_u32(y);
+    if (ax == 0 && ay == 0) {
+        return 0;
+    }
+    // 0..45° に折り返す
+    bool swap = ay > ax;
+    uint32_t num = swap ? ax : ay;
+    uint32_t den = swap ? ay : ax;
+    int64_t t = (int64_t)(((uint64_t)num << POLY_Q) / den);
+    int64_t t2 = (t * t) >> POLY_Q;
+
+    const int32_t *c = poly_coeffs[tier];
+    int64_t acc = c[poly_terms[tier] - 1];
+    for (int k = poly_terms[tier] - 2; k >= 0; --k) {
+        acc = ((acc * t2) >> POLY_Q) + c[k];
+    }
+    int64_t rad = (acc * t) >> POLY_Q;
+    int32_t a = (int32_t)((rad * RAD_TO_MDEG_Q16 + (1ll << (POLY_Q + 15))) >> (POLY_Q + 16));
+
+    if (swap) {
+        a = 90000 - a;
+    }
+    if (x < 0) {
+        a = 180000 - a;
+    }
+    return y < 0 ? -a : a;
+}
+
+int32_t __not_in_flash_func(fixed_asin)(int32_t s, int32_t r, fixed_trig_tier tier) {
+    if (s >= r) {
+        return 90000;
+    }
+    if (s <= -r) {
+        return -90000;
+    }
+    // asin(s / r) = atan2(s, √(r² - s²))。r が小さいと √ の量子化がそのまま角度の誤差になるので、
+    // r を [2^22, 2^23) に揃えてから √ を小数8ビットまで求め、四捨五入する
+    int shift = __builtin_clz((uint32_t)r) - 9;
+    if (shift >= 0) {
+        s = (int32_t)((uint32_t)s << shift);
+        r <<= shift;
+    } else {
+        s >>= -shift;
+        r >>= -shift;
+    }
+    uint64_t v = (uint64_t)((int64_t)r * r - (int64_t)s * s) << 16;
+    uint32_t c_q8 = fixed_isqrt64(v);
+    if (v - (uint64_t)c_q8 * c_q8 > c_q8) {
+        c_q8++;
+    }
+    return fixed_atan2_cordic((int32_t)((uint32_t)s << 8), (int32_t)c_q8, tier);
+}
+
+uint32_t __not_in_flash_func(fixed_isqrt64)(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
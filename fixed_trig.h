@@ -0,0 +1,34 @@
+#ifndef FIXED_TRIG_H
+#define FIXED_TRIG_H
+
+#include <stdint.h>
+
+// 固定小数点の逆三角関数 (傾斜計算用)。48MHz では libm の float 版が測定レートに追いつかないので、
+// 整数演算だけで atan2 / asin / 平方根を求める。角度はすべて 0.001° 単位 (-180000..180000)。
+// 精度は段階 (fixed_trig_tier) で選び、段階ごとの最大誤差 (出力の丸めを含む) を超えない範囲で
+// 最も軽い計算にする。カーネルは2種類:
+//   - CORDIC: 乗算・除算なし (シフトと加算のみ)。ベクトルの長さも同時に得られる。
+//     表も含めて SRAM に置くので flash_power_run() の中からも使える
+//   - 多項式 (ミニマックス近似): 除算1回と乗算数回。64ビット除算はライブラリ (フラッシュ上) を呼ぶので、
+//     フラッシュを止めている間は使えない
+// 入力は |x|, |y| < 2^23 (長さ・asin を使うとき)。atan2 だけなら int32 の全範囲。
+// libm との速さの比較は tests/fixed_trig_bench.c (実機では CMake の INCLINOMETER_FIXED_TRIG_BENCH)。
+
+typedef enum {
+    FIXED_TRIG_TIER_0_1,   // 最大誤差 0.1°
+    FIXED_TRIG_TIER_0_01,  // 0.01°
+    FIXED_TRIG_TIER_0_001, // 0.001°
+    FIXED_TRIG_TIER_COUNT
+} fixed_trig_tier;
+
+// atan2(y, x) (0.001°)
+int32_t fixed_atan2_cordic(int32_t y, int32_t x, fixed_trig_tier tier);
+int32_t fixed_atan2_poly(int32_t y, int32_t x, fixed_trig_tier tier);
+// atan2(y, x) と sqrt(x² + y²) (Q8: 下位8ビットが小数) を CORDIC 1回で求める
+int32_t fixed_atan2_hypot(int32_t y, int32_t x, fixed_trig_tier tier, uint32_t *hypot_q8);
+// asin(s / r) (0.001°)。r > 0、|s| > r は ±90°
+int32_t fixed_asin(int32_t s, int32_t r, fixed_trig_tier tier);
+// floor(sqrt(v))
+uint32_t fixed_isqrt64(uint64_t v);
+
+#endif
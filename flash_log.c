@@ -0,0 +1,811 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "powman_scratch.h"
+#include "blockdev.h"
+#include "crc32.h"
+#include "flash_log.h"
+
+// ブロックデバイス層 (blockdev.h) 上の追記型リングログ。
+// 各セクタ先頭にヘッダ (seq と最初のレコード時刻) を置き、RAM 上に
+// セクタごとの先頭時刻インデックスを保持して時刻範囲を二分探索する。
+// インデックスは FLASH_LOG_INDEX_ENTRIES 項目まで。それより大きいデバイス (SD) では index_stride セクタに
+// 1項目だけ持ち、二分探索で index_stride セクタの幅まで絞ってから、その中のヘッダを読んで探す。
+// 時刻が戻ったら (コールドスタートで powman タイマーが初期値に戻るなど) 書き込み中セクタを閉じ、
+// 区間番号 (epoch) を1つ進めた新しいセクタから書く。時刻は区間の中でだけ単調で、検索は区間ごとに行う。
+//
+// 起床ごとの初期化を軽くするため、書き込み中セクタを powman スクラッチに残しておき、起動時はそこから
+// seq をたどってヘッダを数個読むだけで書き込み位置を決める。インデックスは最初の検索のときに作る。
+// スクラッチが消えた (チップリセット) ときは、seq が途切れる位置を二分探索する。
+// それでも合わないときだけ、全セクタのヘッダを読む。
+//
+// 電源断対策: セクタヘッダとレコードは「データを書く → コミットマークを書く」の
+// 2段階で書き込み、段階の間で blockdev_flush() してデバイスへの書き込み順序を保証する。NOR フラッシュは 1→0 の書き込みしかできないため、途中で
+// 電源が落ちた場合はコミットマークが立たず、起動時にそのレコード以降を破棄する。
+// ページ全体を書き換えるバックエンド (SD, storage_backend.page_rewrite) では、コミットマークを後から書くと
+// ページの書き換えになり、その途中の電源断で同じページのコミット済みレコードまで失う。そこでコミット欄に
+// CRC を入れて1回で書き、コミットのあとは次のページから書く (一度書いたページには二度と書かない)。
+// ページごと書き換えるので、セクタを開くときに消去しない (SD の消去は 0xff の書き込みで、書き込みが倍になる)。
+// 前の周のレコードが残るが、レコードの CRC はセクタの seq から始めるので無効になる。
+
+#define SECTOR_MAGIC 0x474f4c53u // "SLOG"
+#define REC_MAGIC 0x5243u        // "CR"
+#define COMMIT_MARK 0x54494d43u  // "CMIT" (消去状態 0xffffffff から書き込む)
+#define TS_EMPTY UINT64_MAX
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint64_t first_ts_ms;
+    uint32_t commit;
+    uint32_t epoch; // 区間番号 (区間導入前のログは 0xffffffff で、区間 0 として扱う)
+} sector_hdr;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint32_t commit;
+    uint64_t timestamp_ms;
+} rec_hdr;
+
+_Static_assert(sizeof(sector_hdr) + sizeof(rec_hdr) + FLASH_LOG_MAX_PAYLOAD <= FLASH_LOG_SECTOR_SIZE, "payload too large");
+
+static bool ready;
+static bool page_rewrite;   // バックエンドがページ全体を書き換える (コミット欄は CRC)
+static uint32_t page_size;
+static bool index_ready;    // index_ts / index_epoch が使用中の全セクタについて揃っている
+static uint32_t nsectors;   // バックエンドの容量から決まるセクタ数 (index_stride の倍数)
+static uint32_t index_stride; // インデックス1項目あたりのセクタ数 (2 の累乗)
+static uint32_t hint_unit;    // スクラッチの手がかりの単位 (セクタ数、2 の累乗)
+
+// 物理番号が index_stride の倍数のセクタの先頭時刻と区間番号 (物理セクタ順)。TS_EMPTY は未使用セクタ
+static uint64_t index_ts[FLASH_LOG_INDEX_ENTRIES];
+static uint32_t index_epoch[FLASH_LOG_INDEX_ENTRIES];
+static uint32_t oldest;     // 最古セクタ (物理番号)
+static uint32_t used;       // 使用中セクタ数
+static uint32_t head_seq;   // 書き込み中セクタの seq
+static uint32_t write_off;  // 書き込み中セクタ内の次の書き込み位置
+static uint64_t last_ts_ms; // 最後に追記したレコードの時刻
+static uint32_t epoch;      // 書き込み中セクタの区間番号
+static uint32_t pending_off = UINT32_MAX; // 未コミットの最初のレコード (書き込み中セクタ内)
+static uint32_t hdr_cache_phys = UINT32_MAX; // read_sector_hdr が最後に読んだセクタ
+static sector_hdr hdr_cache;
+
+static inline uint32_t align4(uint32_t v) {
+    return (v + 3u) & ~3u;
+}
+
+static inline uint32_t phys_sector(uint32_t logical) {
+    return (oldest + logical) % nsectors;
+}
+
+static inline uint32_t head_sector(void) {
+    return phys_sector(used - 1);
+}
+
+static inline uint32_t hdr_epoch(const sector_hdr *hdr) {
+    return hdr->epoch == UINT32_MAX ? 0u : hdr->epoch;
+}
+
+// commit 欄を除いたヘッダの CRC (page_rewrite のバックエンドでコミットマークの代わりにする)
+static uint32_t hdr_crc(const sector_hdr *hdr) {
+    uint32_t crc = crc32_update(0, hdr, offsetof(sector_hdr, commit));
+    return crc32_update(crc, &hdr->epoch, sizeof(hdr->epoch));
+}
+
+// レコードの CRC はセクタの seq から始める (前の周に同じ位置に書いたレコードを通さない)
+static uint32_t rec_hdr_crc(uint32_t seq, const rec_hdr *rec) {
+    uint32_t crc = crc32_update(0, &seq, sizeof(seq));
+    crc = crc32_update(crc, rec, offsetof(rec_hdr, commit));
+    return crc32_update(crc, &rec->timestamp_ms, sizeof(rec->timestamp_ms));
+}
+
+// 未使用、または消去/ヘッダ書き込み中に電源断したセクタは false。
+// SD でもコミットマークは受け付ける (CRC にする前に書いたログ)
+static inline bool hdr_valid(const sector_hdr *hdr) {
+    return hdr->magic == SECTOR_MAGIC && (hdr->commit == COMMIT_MARK || (page_rewrite && hdr->commit == hdr_crc(hdr)));
+}
+
+static inline int read_hdr(uint32_t phys, sector_hdr *hdr) {
+    return blockdev_read(phys * FLASH_LOG_SECTOR_SIZE, hdr, sizeof(*hdr));
+}
+
+// 読み出し用: 同じセクタを続けて読むときはヘッダを読み直さない
+static int read_sector_hdr(uint32_t phys, sector_hdr *hdr) {
+    if (phys != hdr_cache_phys) {
+        int rc = read_hdr(phys, &hdr_cache);
+        if (rc != PICO_OK) {
+            hdr_cache_phys = UINT32_MAX;
+            return rc;
+        }
+        hdr_cache_phys = phys;
+    }
+    *hdr = hdr_cache;
+    return PICO_OK;
+}
+
+// 論理セクタ s の先頭時刻と区間番号。インデックスにあるセクタ (物理番号が index_stride の倍数) は RAM から、
+// それ以外はヘッダを読む (読めない・無効なセクタは未使用と同じ扱い)
+static void sector_key(uint32_t s, uint64_t *ts, uint32_t *e) {
+    uint32_t p = phys_sector(s);
+    if (p % index_stride == 0) {
+        *ts = index_ts[p / index_stride];
+        *e = index_epoch[p / index_stride];
+        return;
+    }
+    sector_hdr hdr;
+    bool valid = read_sector_hdr(p, &hdr) == PICO_OK && hdr_valid(&hdr);
+    *ts = valid ? hdr.first_ts_ms : TS_EMPTY;
+    *e = valid ? hdr_epoch(&hdr) : 0u;
+}
+
+#define HINT_MAX (LOG_HEAD_HINT_MASK >> LOG_HEAD_HINT_LSB)
+
+// 書き込み中セクタの物理番号 / hint_unit + 1 (0 = 手がかりなし)
+static inline uint32_t head_hint(void) {
+    return (powman_hw->scratch[SCRATCH_SUPPLY] & LOG_HEAD_HINT_MASK) >> LOG_HEAD_HINT_LSB;
+}
+
+static inline uint32_t hint_of(uint32_t phys) {
+    return phys / hint_unit + 1u;
+}
+
+static inline void set_head_hint(uint32_t hint) {
+    powman_hw->scratch[SCRATCH_SUPPLY] =
+        (powman_hw->scratch[SCRATCH_SUPPLY] & ~LOG_HEAD_HINT_MASK) | ((hint << LOG_HEAD_HINT_LSB) & LOG_HEAD_HINT_MASK);
+}
+
+// base + off のレコードヘッダを読む。limit までに収まり、最後まで書き込まれたレコードなら *valid = true。
+// sector はそのセクタのヘッダ (コミットマークのセクタのレコードはコミットマーク、CRC のセクタは CRC で確かめる)
+static int read_rec(const sector_hdr *sector, uint32_t base, uint32_t off, uint32_t limit, rec_hdr *rec,
+                    bool *valid) {
+    *valid = false;
+    if (off + sizeof(rec_hdr) > limit) {
+        return PICO_OK;
+    }
+    int rc = blockdev_read(base + off, rec, sizeof(*rec));
+    if (rc != PICO_OK || rec->magic != REC_MAGIC || off + sizeof(rec_hdr) + rec->len > limit) {
+        return rc;
+    }
+    if (sector->commit == COMMIT_MARK) {
+        *valid = rec->commit == COMMIT_MARK;
+        return PICO_OK;
+    }
+    uint32_t crc = rec_hdr_crc(sector->seq, rec);
+    uint8_t buf[64];
+    for (uint32_t i = 0; i < rec->len;) {
+        uint32_t n = rec->len - i < sizeof(buf) ? rec->len - i : sizeof(buf);
+        rc = blockdev_read(base + off + sizeof(rec_hdr) + i, buf, n);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        crc = crc32_update(crc, buf, n);
+        i += n;
+    }
+    *valid = crc == rec->commit;
+    return PICO_OK;
+}
+
+// off で無効なレコードに当たったときの次の読み出し位置。SD はコミットごとに次のページから書くので
+// ページの残り (消去状態の詰め物) を飛ばす。ページ先頭で無効ならそこで終わり (off をそのまま返す)
+static inline uint32_t skip_padding(uint32_t off) {
+    if (!page_rewrite || off % page_size == 0) {
+        return off;
+    }
+    return off - off % page_size + page_size;
+}
+
+// 未コミットのレコードを書き出し、続けてコミットマークを書く
+// (page_rewrite のバックエンドはレコードが CRC 付きなので、書き出して次のページへ進むだけ)
+static int commit_pending(void) {
+    int rc = blockdev_flush();
+    if (rc != PICO_OK || pending_off == UINT32_MAX) {
+        return rc;
+    }
+    if (page_rewrite) {
+        write_off = skip_padding(write_off);
+        pending_off = UINT32_MAX;
+        return PICO_OK;
+    }
+    uint32_t base = head_sector() * FLASH_LOG_SECTOR_SIZE;
+    const uint32_t mark = COMMIT_MARK;
+    for (uint32_t off = pending_off; off < write_off;) {
+        rec_hdr rec;
+        rc = blockdev_read(base + off, &rec, sizeof(rec));
+        if (rc == PICO_OK) {
+            rc = blockdev_write(base + off + offsetof(rec_hdr, commit), &mark, sizeof(mark));
+        }
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        off += align4(sizeof(rec_hdr) + rec.len);
+    }
+    rc = blockdev_flush();
+    if (rc == PICO_OK) {
+        pending_off = UINT32_MAX;
+    }
+    return rc;
+}
+
+// 次のセクタを消去してヘッダを書く。満杯なら最古セクタを再利用する
+static int open_sector(uint64_t first_ts_ms, uint32_t sector_epoch) {
+    int rc = commit_pending();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+
+    uint32_t phys;
+    if (used == 0) {
+        phys = oldest;
+    } else {
+        phys = (head_sector() + 1u) % nsectors;
+        if (used == nsectors) {
+            oldest = (oldest + 1u) % nsectors;
+            used--;
+        }
+    }
+    if (!page_rewrite) {
+        rc = blockdev_erase(phys * FLASH_LOG_SECTOR_SIZE, FLASH_LOG_SECTOR_SIZE);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+    }
+
+    sector_hdr hdr = {
+        .magic = SECTOR_MAGIC,
+        .seq = ++head_seq,
+        .first_ts_ms = first_ts_ms,
+        .commit = UINT32_MAX,
+        .epoch = sector_epoch,
+    };
+    uint32_t base = phys * FLASH_LOG_SECTOR_SIZE;
+    const uint32_t mark = COMMIT_MARK;
+    if (page_rewrite) {
+        // 最初のレコードと一緒に、次のコミットで書き出す
+        hdr.commit = hdr_crc(&hdr);
+        rc = blockdev_write(base, &hdr, sizeof(hdr));
+    } else {
+        rc = blockdev_write(base, &hdr, sizeof(hdr));
+        if (rc == PICO_OK) {
+            rc = blockdev_flush();
+        }
+        if (rc == PICO_OK) {
+            rc = blockdev_write(base + offsetof(sector_hdr, commit), &mark, sizeof(mark));
+        }
+        if (rc == PICO_OK) {
+            rc = blockdev_flush();
+        }
+    }
+    hdr_cache_phys = UINT32_MAX;
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    if (phys % index_stride == 0) {
+        index_ts[phys / index_stride] = first_ts_ms;
+        index_epoch[phys / index_stride] = sector_epoch;
+    }
+    epoch = sector_epoch;
+    used++;
+    write_off = sizeof(sector_hdr);
+    set_head_hint(hint_of(phys));
+    return PICO_OK;
+}
+
+// off からセクタ末尾までが消去状態か (書きかけページの検出用)
+static bool sector_tail_erased(uint32_t base, uint32_t off) {
+    uint8_t buf[64];
+    while (off < FLASH_LOG_SECTOR_SIZE) {
+        uint32_t n = FLASH_LOG_SECTOR_SIZE - off < sizeof(buf) ? FLASH_LOG_SECTOR_SIZE - off : sizeof(buf);
+        if (blockdev_read(base + off, buf, n) != PICO_OK) {
+            return false;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            if (buf[i] != 0xffu) {
+                return false;
+            }
+        }
+        off += n;
+    }
+    return true;
+}
+
+// 物理セクタ start から seq が続く限り進めて書き込み中セクタを探し、その次から最古セクタを決める。
+// start が使えなければ PICO_ERROR_NOT_FOUND
+static int locate_from(uint32_t start, uint32_t *head_out, sector_hdr *head_hdr) {
+    uint32_t head = start;
+    sector_hdr hdr, next;
+    int rc = read_hdr(head, &hdr);
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    if (!hdr_valid(&hdr)) {
+        return PICO_ERROR_NOT_FOUND;
+    }
+    for (uint32_t i = 1; i < nsectors; ++i) {
+        uint32_t p = (head + 1u) % nsectors;
+        rc = read_hdr(p, &next);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (!hdr_valid(&next) || next.seq != hdr.seq + 1u) {
+            break;
+        }
+        head = p;
+        hdr = next;
+    }
+
+    // 一周していれば、書き込み中セクタの次 (そこを消去中に電源断していればさらに次) が最古セクタ。
+    // どちらも使っていなければ、ログは物理セクタ 0 から始まっている
+    uint32_t first = 0;
+    for (uint32_t k = 1; k <= 2 && k < nsectors; ++k) {
+        uint32_t p = (head + k) % nsectors;
+        rc = read_hdr(p, &next);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (hdr_valid(&next)) {
+            first = p;
+            break;
+        }
+    }
+    if (first == 0) {
+        rc = read_hdr(0, &next);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+    }
+    // 最古セクタから書き込み中セクタまで seq が続いていること
+    if (!hdr_valid(&next) || next.seq != hdr.seq - (head + nsectors - first) % nsectors) {
+        return PICO_ERROR_NOT_FOUND;
+    }
+    oldest = first;
+    *head_out = head;
+    *head_hdr = hdr;
+    return PICO_OK;
+}
+
+// スクラッチの手がかりから探す (hint_unit が 1 でなければ、書き込み中セクタの少し手前から)
+static int locate_from_hint(uint32_t *head_out, sector_hdr *head_hdr) {
+    uint32_t hint = head_hint();
+    if (hint == 0 || (hint - 1u) * hint_unit >= nsectors) {
+        return PICO_ERROR_NOT_FOUND;
+    }
+    return locate_from((hint - 1u) * hint_unit, head_out, head_hdr);
+}
+
+// 手がかりがないとき: seq は物理セクタ順に1ずつ増え、書き込み中セクタの次で途切れる (未使用・消去中・
+// 前の周のセクタ)。セクタ 0 (そこを消去中に電源断していればセクタ 1) から seq が続く最後のセクタを
+// 二分探索する。どちらも無効ならログは空で PICO_ERROR_NO_DATA
+static int locate_by_search(uint32_t *head_out, sector_hdr *head_hdr) {
+    uint32_t base = 0;
+    sector_hdr first, hdr;
+    int rc = read_hdr(0, &first);
+    if (rc == PICO_OK && !hdr_valid(&first)) {
+        base = 1;
+        rc = read_hdr(1, &first);
+    }
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    if (!hdr_valid(&first)) {
+        return PICO_ERROR_NO_DATA;
+    }
+    uint32_t lo = base + 1u;
+    uint32_t hi = nsectors;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        rc = read_hdr(mid, &hdr);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (hdr_valid(&hdr) && hdr.seq - first.seq == mid - base) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    return locate_from(lo - 1u, head_out, head_hdr);
+}
+
+// 全セクタのヘッダを読み、seq の最小/最大から最古セクタと書き込み中セクタを決める (インデックスも揃う)。
+// seq が途切れているなど、二分探索で決まらなかったときだけ使う。ログが空なら PICO_ERROR_NO_DATA
+static int locate_by_scan(uint32_t *head_out, sector_hdr *head_hdr) {
+    uint32_t min_seq = UINT32_MAX;
+    uint32_t max_seq = 0;
+    for (uint32_t p = 0; p < nsectors; ++p) {
+        sector_hdr hdr;
+        int rc = read_hdr(p, &hdr);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (p % index_stride == 0) {
+            index_ts[p / index_stride] = hdr_valid(&hdr) ? hdr.first_ts_ms : TS_EMPTY;
+            index_epoch[p / index_stride] = hdr_valid(&hdr) ? hdr_epoch(&hdr) : 0u;
+        }
+        if (!hdr_valid(&hdr)) {
+            continue;
+        }
+        if (hdr.seq < min_seq) {
+            min_seq = hdr.seq;
+            oldest = p;
+        }
+        if (hdr.seq >= max_seq) {
+            max_seq = hdr.seq;
+            *head_out = p;
+            *head_hdr = hdr;
+        }
+    }
+    index_ready = true;
+    return min_seq == UINT32_MAX ? PICO_ERROR_NO_DATA : PICO_OK;
+}
+
+// 使用中セクタのうちインデックスに載るもののヘッダを読んでインデックスを作る
+// (初期化を手がかりで済ませたときは最初の検索で)
+static int build_index(void) {
+    if (index_ready) {
+        return PICO_OK;
+    }
+    for (uint32_t s = (index_stride - oldest % index_stride) % index_stride; s < used; s += index_stride) {
+        uint32_t p = phys_sector(s);
+        sector_hdr hdr;
+        int rc = read_hdr(p, &hdr);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        index_ts[p / index_stride] = hdr_valid(&hdr) ? hdr.first_ts_ms : TS_EMPTY;
+        index_epoch[p / index_stride] = hdr_valid(&hdr) ? hdr_epoch(&hdr) : 0u;
+    }
+    index_ready = true;
+    return PICO_OK;
+}
+
+// 書き込み中セクタを決めてから、そのセクタだけを走査してコミット済みの末尾を探す
+// (最大 FLASH_LOG_SECTOR_SIZE バイト)
+int flash_log_init(const storage_backend *backend) {
+    if (backend->page_size > STORAGE_MAX_PAGE_SIZE || FLASH_LOG_SECTOR_SIZE % backend->page_size ||
+        FLASH_LOG_SECTOR_SIZE % backend->erase_size) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    ready = false;
+    int rc = blockdev_init(backend);
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    page_rewrite = backend->page_rewrite;
+    page_size = backend->page_size;
+    nsectors = blockdev_size() / FLASH_LOG_SECTOR_SIZE;
+    if (nsectors < 2) {
+        return PICO_ERROR_INSUFFICIENT_RESOURCES;
+    }
+    // インデックスと手がかりに収まるまで単位を大きくする (端数のセクタは使わない)
+    index_stride = 1;
+    while (nsectors / index_stride > FLASH_LOG_INDEX_ENTRIES) {
+        index_stride *= 2u;
+    }
+    nsectors -= nsectors % index_stride;
+    hint_unit = 1;
+    while ((nsectors - 1u) / hint_unit + 1u > HINT_MAX) {
+        hint_unit *= 2u;
+    }
+
+    oldest = 0;
+    used = 0;
+    head_seq = 0;
+    last_ts_ms = 0;
+    epoch = 0;
+    pending_off = UINT32_MAX;
+    index_ready = false;
+    hdr_cache_phys = UINT32_MAX;
+
+    uint32_t head = 0;
+    sector_hdr hdr;
+    rc = locate_from_hint(&head, &hdr);
+    if (rc == PICO_ERROR_NOT_FOUND) {
+        rc = locate_by_search(&head, &hdr);
+    }
+    if (rc == PICO_ERROR_NOT_FOUND) {
+        oldest = 0;
+        rc = locate_by_scan(&head, &hdr);
+    }
+    if (rc == PICO_ERROR_NO_DATA) {
+        set_head_hint(0);
+        ready = true;
+        return PICO_OK;
+    }
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    used = (head + nsectors - oldest) % nsectors + 1u;
+    head_seq = hdr.seq;
+    epoch = hdr_epoch(&hdr);
+    set_head_hint(hint_of(head));
+    ready = true;
+
+    // 書き込み中セクタのコミット済み末尾を探す
+    uint32_t base = head * FLASH_LOG_SECTOR_SIZE;
+    uint32_t off = sizeof(sector_hdr);
+    last_ts_ms = hdr.first_ts_ms;
+    while (off < FLASH_LOG_SECTOR_SIZE) {
+        rec_hdr rec;
+        bool valid;
+        rc = read_rec(&hdr, base, off, FLASH_LOG_SECTOR_SIZE, &rec, &valid);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (!valid) {
+            uint32_t next = skip_padding(off);
+            if (next == off) {
+                break;
+            }
+            off = next;
+            continue;
+        }
+        last_ts_ms = rec.timestamp_ms;
+        off += align4(sizeof(rec_hdr) + rec.len);
+    }
+    // 末尾に書きかけのデータが残っていれば、上書きできないのでセクタを閉じる。
+    // page_rewrite のバックエンドは off (ページ境界) からページごと書き換えるので、そのまま続けられる
+    // (ただしコミットマークで書いた古いセクタには CRC のレコードを足さない)
+    if (page_rewrite) {
+        write_off = hdr.commit == COMMIT_MARK ? FLASH_LOG_SECTOR_SIZE : off;
+    } else {
+        write_off = sector_tail_erased(base, off) ? off : FLASH_LOG_SECTOR_SIZE;
+    }
+    return PICO_OK;
+}
+
+int flash_log_append(uint64_t timestamp_ms, const void *data, size_t len) {
+    if (!ready) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    if (len > FLASH_LOG_MAX_PAYLOAD) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    // インデックスの二分探索は時刻の単調性に依存するので、時刻が戻ったら新しい区間を始める
+    bool rewind = used > 0 && timestamp_ms < last_ts_ms;
+    uint32_t need = align4(sizeof(rec_hdr) + (uint32_t)len);
+    if (used == 0 || rewind || write_off + need > FLASH_LOG_SECTOR_SIZE) {
+        int rc = open_sector(timestamp_ms, rewind ? epoch + 1u : epoch);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+    }
+
+    rec_hdr rec = {
+        .magic = REC_MAGIC,
+        .len = (uint16_t)len,
+        .commit = UINT32_MAX,
+        .timestamp_ms = timestamp_ms,
+    };
+    if (page_rewrite) {
+        rec.commit = crc32_update(rec_hdr_crc(head_seq, &rec), data, len);
+    }
+    uint32_t off = head_sector() * FLASH_LOG_SECTOR_SIZE + write_off;
+    int rc = blockdev_write(off, &rec, sizeof(rec));
+    if (rc == PICO_OK) {
+        rc = blockdev_write(off + sizeof(rec), data, len);
+    }
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    if (pending_off == UINT32_MAX) {
+        pending_off = write_off;
+    }
+    write_off += need;
+    last_ts_ms = timestamp_ms;
+    return PICO_OK;
+}
+
+// 追記済みレコードを書き出してコミットする (スリープ前に呼ぶ)。
+// コミット前のレコードは読み出しの対象外で、電源断時には失われる
+int flash_log_flush(void) {
+    if (!ready) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    return commit_pending();
+}
+
+// コミットしてからバックエンドを低消費電力状態にする (電源断の直前に呼ぶ)
+int flash_log_sleep(void) {
+    int rc = flash_log_flush();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    return blockdev_sleep();
+}
+
+typedef struct {
+    bool by_epoch; // 区間番号で探す (false なら区間の中で先頭時刻で探す)
+    bool upper;    // 先頭時刻が ts と等しいセクタも手前に含める
+    uint32_t epoch;
+    uint64_t ts;
+} bound_key;
+
+// 論理セクタ s が探している位置より手前か
+static bool before(uint32_t s, const bound_key *k) {
+    uint64_t ts;
+    uint32_t e;
+    sector_key(s, &ts, &e);
+    if (k->by_epoch) {
+        return e < k->epoch;
+    }
+    return ts < k->ts || (k->upper && ts == k->ts);
+}
+
+// 論理セクタ [lo, hi) のうち before() が偽になる最初のセクタ。インデックスにあるセクタだけで二分探索して
+// index_stride セクタの幅まで絞り、その中はヘッダを読んで二分探索する (index_stride が 1 なら読まない)
+static uint32_t bound(uint32_t lo, uint32_t hi, const bound_key *k) {
+    uint32_t first = lo + (index_stride - phys_sector(lo) % index_stride) % index_stride;
+    uint32_t n = first < hi ? (hi - first - 1u) / index_stride + 1u : 0u;
+    uint32_t a = 0;
+    uint32_t b = n;
+    while (a < b) {
+        uint32_t mid = a + (b - a) / 2u;
+        if (before(first + mid * index_stride, k)) {
+            a = mid + 1u;
+        } else {
+            b = mid;
+        }
+    }
+    uint32_t l = a > 0 ? first + (a - 1u) * index_stride + 1u : lo;
+    uint32_t h = a < n ? first + a * index_stride : hi;
+    while (l < h) {
+        uint32_t mid = l + (h - l) / 2u;
+        if (before(mid, k)) {
+            l = mid + 1u;
+        } else {
+            h = mid;
+        }
+    }
+    return l;
+}
+
+// 区間番号が e 以上の最初の論理セクタ番号 (区間番号は論理セクタ順に増える)
+static uint32_t epoch_lower_bound(uint32_t e) {
+    return bound(0, used, &(bound_key){.by_epoch = true, .epoch = e});
+}
+
+// 論理セクタ [lo, hi) (1つの区間) のうち、先頭時刻が ts より大きい (upper) または
+// ts 以上 (!upper) の最初の論理セクタ番号
+static uint32_t ts_bound(uint32_t lo, uint32_t hi, uint64_t ts, bool upper) {
+    return bound(lo, hi, &(bound_key){.upper = upper, .ts = ts});
+}
+
+// begin は t1 を含みうる最初のセクタ、end は t2 より後に始まる最初のセクタ (または区間の終わり) を指す。
+// 境界セクタ内の範囲外レコードは読み出し側で時刻を比較して除外すること
+int flash_log_find_range_in(uint32_t e, uint64_t t1_ms, uint64_t t2_ms, flash_log_cursor *begin,
+                            flash_log_cursor *end) {
+    if (t1_ms > t2_ms) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    int rc = build_index();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    uint32_t lo = epoch_lower_bound(e);
+    uint32_t hi = e == UINT32_MAX ? used : epoch_lower_bound(e + 1u);
+    uint32_t last = ts_bound(lo, hi, t2_ms, true);
+    if (last == lo) {
+        return PICO_ERROR_NO_DATA;
+    }
+    // t1 と同じ時刻のレコードは、先頭時刻が t1 のセクタの1つ前から続いていることがある
+    uint32_t first = ts_bound(lo, last, t1_ms, false);
+    if (first > lo) {
+        first--;
+    }
+    begin->sector = first;
+    begin->offset = sizeof(sector_hdr);
+    end->sector = last;
+    end->offset = 0;
+    return PICO_OK;
+}
+
+int flash_log_find_range(uint64_t t1_ms, uint64_t t2_ms, flash_log_cursor *begin, flash_log_cursor *end) {
+    return flash_log_find_range_in(epoch, t1_ms, t2_ms, begin, end);
+}
+
+static inline bool cursor_before(const flash_log_cursor *a, const flash_log_cursor *b) {
+    return a->sector < b->sector || (a->sector == b->sector && a->offset < b->offset);
+}
+
+int flash_log_read(flash_log_cursor *cursor, const flash_log_cursor *end,
+                   uint64_t *timestamp_ms, void *buf, size_t buf_len, size_t *len) {
+    while (cursor_before(cursor, end) && cursor->sector < used) {
+        // 書き込み中セクタは未コミットのレコードの手前まで
+        bool is_head = cursor->sector == used - 1u;
+        uint32_t limit = !is_head ? FLASH_LOG_SECTOR_SIZE : pending_off != UINT32_MAX ? pending_off : write_off;
+        uint32_t phys = phys_sector(cursor->sector);
+        uint32_t base = phys * FLASH_LOG_SECTOR_SIZE;
+        sector_hdr hdr;
+        rec_hdr rec;
+        bool valid;
+        int rc = read_sector_hdr(phys, &hdr);
+        if (rc == PICO_OK) {
+            rc = read_rec(&hdr, base, cursor->offset, limit, &rec, &valid);
+        }
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        if (valid) {
+            size_t n = rec.len < buf_len ? rec.len : buf_len;
+            rc = blockdev_read(base + cursor->offset + sizeof(rec_hdr), buf, n);
+            if (rc != PICO_OK) {
+                return rc;
+            }
+            *timestamp_ms = rec.timestamp_ms;
+            *len = rec.len;
+            cursor->offset += align4(sizeof(rec_hdr) + rec.len);
+            return rec.len <= buf_len ? PICO_OK : PICO_ERROR_BUFFER_TOO_SMALL;
+        }
+        uint32_t next = skip_padding(cursor->offset);
+        if (next != cursor->offset && next < limit) {
+            cursor->offset = next;
+            continue;
+        }
+        // セクタ末尾または未コミット: 次のセクタへ
+        cursor->sector++;
+        cursor->offset = sizeof(sector_hdr);
+    }
+    return PICO_ERROR_NO_DATA;
+}
+
+// 区間ごとに検索し、区間が変わるところで区間番号を出力する
+int flash_log_print_range(uint64_t t1_ms, uint64_t t2_ms) {
+    if (t1_ms > t2_ms) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    int rc = build_index();
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    uint8_t buf[FLASH_LOG_MAX_PAYLOAD];
+    int count = 0;
+    for (uint32_t s = 0; s < used;) {
+        uint64_t first_ts;
+        uint32_t e;
+        sector_key(s, &first_ts, &e);
+        flash_log_cursor cur, end;
+        if (flash_log_find_range_in(e, t1_ms, t2_ms, &cur, &end) == PICO_OK) {
+            uint64_t ts;
+            size_t len;
+            bool header = false;
+            while (flash_log_read(&cur, &end, &ts, buf, sizeof(buf), &len) == PICO_OK) {
+                if (ts < t1_ms) {
+                    continue;
+                }
+                if (ts > t2_ms) {
+                    break;
+                }
+                if (!header) {
+                    printf("epoch %" PRIu32 "\n", e);
+                    header = true;
+                }
+                printf("%" PRIu64 ":", ts);
+                for (size_t i = 0; i < len; ++i) {
+                    printf(" %02x", buf[i]);
+                }
+                printf("\n");
+                count++;
+            }
+        }
+        if (e == UINT32_MAX) {
+            break;
+        }
+        s = epoch_lower_bound(e + 1u);
+    }
+    return count ? count : PICO_ERROR_NO_DATA;
+}
+
+uint32_t flash_log_epoch(void) {
+    return epoch;
+}
+
+uint32_t flash_log_sector_count(void) {
+    return used;
+}
+
+uint32_t flash_log_sector_capacity(void) {
+    return nsectors;
+}
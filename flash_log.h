@@ -0,0 +1,53 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "storage.h"
+
+#define FLASH_LOG_SECTOR_SIZE 4096u
+// RAM 上のインデックスの項目数 (1項目 12 バイトで 48KB)。16MB までは1セクタ1項目で、検索はメモリだけで済む。
+// それより大きいデバイスは2の累乗セクタに1項目にして、境界1つの検索ごとにヘッダを log2(間隔) 個まで読む。
+// デバイス全体を使い (端数の数セクタを除く)、上限はバックエンドの 4GB (SD で 256 セクタに1項目)
+// SD はコミットごとに 512B ブロックの残りを空けて次のブロックから書くので、1回のコミットで最低 512B 使う
+#ifndef FLASH_LOG_INDEX_ENTRIES
+#define FLASH_LOG_INDEX_ENTRIES 4096u
+#endif
+
+// 1レコードのペイロード上限 (セクタヘッダとレコードヘッダを除いた残り)
+#define FLASH_LOG_MAX_PAYLOAD 1024u
+
+// 読み出し位置 (論理セクタ番号 = 最古セクタを0とした順番)
+typedef struct {
+    uint32_t sector;
+    uint32_t offset;
+} flash_log_cursor;
+
+// backend を初期化してインデックスを再構築する
+int flash_log_init(const storage_backend *backend);
+int flash_log_append(uint64_t timestamp_ms, const void *data, size_t len);
+int flash_log_flush(void);
+int flash_log_sleep(void);
+
+// 時刻が戻るたびに (コールドスタートで powman タイマーが初期値に戻るなど) 区間番号 (epoch) が1つ進む。
+// 時刻は区間の中でだけ単調なので、範囲の検索は区間を指定して行う
+
+// 書き込み中の区間番号
+uint32_t flash_log_epoch(void);
+// 区間 epoch の [t1, t2] の範囲を二分探索し、読み出し開始/終了位置を返す
+int flash_log_find_range_in(uint32_t epoch, uint64_t t1_ms, uint64_t t2_ms, flash_log_cursor *begin,
+                            flash_log_cursor *end);
+// 書き込み中の区間で検索する
+int flash_log_find_range(uint64_t t1_ms, uint64_t t2_ms, flash_log_cursor *begin, flash_log_cursor *end);
+// cursor から1レコード読み出して cursor を進める。end に達したら PICO_ERROR_NO_DATA
+int flash_log_read(flash_log_cursor *cursor, const flash_log_cursor *end,
+                   uint64_t *timestamp_ms, void *buf, size_t buf_len, size_t *len);
+// コンソール用: すべての区間の [t1, t2] のレコードを printf で出力 (区間ごとに区間番号の行を挟む)
+int flash_log_print_range(uint64_t t1_ms, uint64_t t2_ms);
+
+uint32_t flash_log_sector_count(void);
+// リングの大きさ (セクタ数)
+uint32_t flash_log_sector_capacity(void);
+
+#endif
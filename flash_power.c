@@ -0,0 +1,59 @@
+#include "pico/stdlib.h"
+#include "pico/bootrom.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/structs/qmi.h"
+#include "flash_power.h"
+
+#define FLASH_CMD_POWER_DOWN 0xb9u
+#define FLASH_CMD_RELEASE 0xabu
+#define FLASH_CMD_READ_STATUS 0x05u
+
+#if FLASH_POWER_DOWN_IN_PROCESSING
+// XIP を抜けた状態 (QMI 直接モード) で1バイトのコマンドを送る。XIP には戻らない
+// (flash_do_cmd は送った直後に XIP に戻るので、眠らせたフラッシュを読みに行ってしまう)
+static void __no_inline_not_in_flash_func(flash_cmd)(uint8_t cmd) {
+    uint32_t csr = qmi_hw->direct_csr;
+    qmi_hw->direct_csr = csr | QMI_DIRECT_CSR_EN_BITS;
+    while (qmi_hw->direct_csr & QMI_DIRECT_CSR_BUSY_BITS) {
+    }
+    hw_set_bits(&qmi_hw->direct_csr, QMI_DIRECT_CSR_ASSERT_CS0N_BITS);
+    qmi_hw->direct_tx = cmd;
+    // 受信バイトが来たら送り終わっている
+    while (qmi_hw->direct_csr & QMI_DIRECT_CSR_RXEMPTY_BITS) {
+    }
+    (void)qmi_hw->direct_rx;
+    hw_clear_bits(&qmi_hw->direct_csr, QMI_DIRECT_CSR_ASSERT_CS0N_BITS);
+    qmi_hw->direct_csr = csr;
+}
+#endif
+
+void __not_in_flash_func(flash_power_run)(void (*fn)(void *arg), void *arg) {
+#if FLASH_POWER_DOWN_IN_PROCESSING
+    // SDK の flash_range_* と同じ ROM の手順で XIP を抜ける
+    rom_connect_internal_flash_fn connect_internal_flash =
+        (rom_connect_internal_flash_fn)rom_func_lookup_inline(ROM_FUNC_CONNECT_INTERNAL_FLASH);
+    rom_flash_exit_xip_fn flash_exit_xip = (rom_flash_exit_xip_fn)rom_func_lookup_inline(ROM_FUNC_FLASH_EXIT_XIP);
+
+    uint32_t ints = save_and_disable_interrupts();
+    __compiler_memory_barrier();
+    connect_internal_flash();
+    flash_exit_xip();
+    flash_cmd(FLASH_CMD_POWER_DOWN);
+
+    fn(arg);
+
+    // 起こして tRES1 待ってから XIP に戻る
+    flash_cmd(FLASH_CMD_RELEASE);
+    uint32_t t0 = time_us_32();
+    while (time_us_32() - t0 < FLASH_POWER_RELEASE_US) {
+    }
+    // flash_do_cmd は最後にキャッシュを無効化し、起動時の XIP 設定で入り直す
+    // (SDK が保存している設定を使うため、害のないステータス読み出しを1つ送ってそれに任せる)
+    uint8_t status[2] = {FLASH_CMD_READ_STATUS, 0};
+    flash_do_cmd(status, status, sizeof(status));
+    restore_interrupts(ints);
+#else
+    fn(arg);
+#endif
+}
@@ -0,0 +1,21 @@
+#ifndef FLASH_POWER_H
+#define FLASH_POWER_H
+
+// 処理中の QSPI フラッシュの電源断 (deep power-down, 0xB9)。
+// FLASH_POWER_DOWN_IN_PROCESSING=1 (CMake の INCLINOMETER_FLASH_POWER_DOWN) のとき、
+// flash_power_run() は割り込みを止めてフラッシュを眠らせ、fn を実行してから起こす。
+// fn とそこから呼ぶ関数はすべて SRAM に置き (__not_in_flash_func)、フラッシュ上の
+// const データや内蔵フラッシュのログにも触れないこと (XIP キャッシュは電源断の前に無効化される)。
+// 0 のときは fn をそのまま呼ぶだけ。
+
+#ifndef FLASH_POWER_DOWN_IN_PROCESSING
+#define FLASH_POWER_DOWN_IN_PROCESSING 0
+#endif
+// 復帰コマンド (0xAB) から読み出せるまでの時間 (W25Q: tRES1 = 3µs)
+#ifndef FLASH_POWER_RELEASE_US
+#define FLASH_POWER_RELEASE_US 5u
+#endif
+
+void flash_power_run(void (*fn)(void *arg), void *arg);
+
+#endif
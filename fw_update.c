@@ -0,0 +1,211 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/bootrom.h"
+#include "pico/sha256.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/structs/otp.h"
+#include "fw_update.h"
+#include "clock_profile.h"
+
+typedef enum {
+    FWU_IDLE,
+    FWU_RECEIVING,
+    FWU_VERIFIED,
+} fwu_state;
+
+typedef struct {
+    uint32_t start; // フラッシュ上のオフセット
+    uint32_t size;
+} partition_range;
+
+static fwu_state state;
+static partition_range target;  // 書き込み先
+static partition_range running; // 実行中 (差分のコピー元)
+static uint32_t image_size;
+static uint32_t written; // 先頭からここまで受け取った
+static uint8_t expected_hash[FW_UPDATE_HASH_LEN];
+static uint8_t __uninitialized_ram(page)[FLASH_PAGE_SIZE];
+// パーティションテーブル読み込みと explicit_buy 用の作業領域 (ブートROMは 4KB を要求)
+static uint8_t __uninitialized_ram(workarea)[FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+
+static int partition_get(int index, partition_range *out) {
+    uint32_t info[3];
+    int rc = rom_get_partition_table_info(info, count_of(info),
+                                          PT_INFO_PARTITION_LOCATION_AND_FLAGS | PT_INFO_SINGLE_PARTITION |
+                                              ((uint32_t)index << 24));
+    if (rc != (int)count_of(info) || !(info[0] & PT_INFO_PARTITION_LOCATION_AND_FLAGS)) {
+        return PICO_ERROR_NOT_FOUND;
+    }
+    uint32_t first = (info[1] & PICOBIN_PARTITION_LOCATION_FIRST_SECTOR_BITS) >> PICOBIN_PARTITION_LOCATION_FIRST_SECTOR_LSB;
+    uint32_t last = (info[1] & PICOBIN_PARTITION_LOCATION_LAST_SECTOR_BITS) >> PICOBIN_PARTITION_LOCATION_LAST_SECTOR_LSB;
+    out->start = first * FLASH_SECTOR_SIZE;
+    out->size = (last + 1u - first) * FLASH_SECTOR_SIZE;
+    return PICO_OK;
+}
+
+// 実行中のパーティション番号。パーティションから起動していなければ負
+static int running_partition(void) {
+    boot_info_t info;
+    if (!rom_get_boot_info(&info)) {
+        return PICO_ERROR_NOT_FOUND;
+    }
+    return info.partition;
+}
+
+// 署名はブートROMが起動時に検証する。セキュアブートが無効だと誰のイメージでも起動するので更新させない
+static bool update_permitted(void) {
+#if FW_UPDATE_ALLOW_UNSIGNED
+    return true;
+#else
+    return (otp_hw->critical & OTP_CRITICAL_SECURE_BOOT_ENABLE_BITS) != 0;
+#endif
+}
+
+static inline const uint8_t *flash_ptr(uint32_t offset) {
+    return (const uint8_t *)(XIP_NOCACHE_NOALLOC_NOTRANSLATE_BASE + offset);
+}
+
+// ページ単位で書き込み先に流し込む。セクタ先頭に来たらそのセクタを消去する
+static void put_byte(uint8_t b) {
+    uint32_t pos = written % FLASH_PAGE_SIZE;
+    page[pos] = b;
+    ++written;
+    if (pos + 1u == FLASH_PAGE_SIZE || written == image_size) {
+        uint32_t page_base = (written - 1u) & ~(FLASH_PAGE_SIZE - 1u);
+        memset(page + pos + 1u, 0xff, FLASH_PAGE_SIZE - pos - 1u);
+        uint32_t ints = save_and_disable_interrupts();
+        if (page_base % FLASH_SECTOR_SIZE == 0) {
+            flash_range_erase(target.start + page_base, FLASH_SECTOR_SIZE);
+        }
+        flash_range_program(target.start + page_base, page, FLASH_PAGE_SIZE);
+        restore_interrupts(ints);
+    }
+}
+
+int fw_update_begin(uint32_t size, const uint8_t hash[FW_UPDATE_HASH_LEN]) {
+    state = FWU_IDLE;
+    if (!update_permitted()) {
+        return PICO_ERROR_NOT_PERMITTED;
+    }
+    int cur = running_partition();
+    if (cur < 0) {
+        return PICO_ERROR_NOT_PERMITTED; // A/B 構成で起動していない
+    }
+    int rc = rom_load_partition_table(workarea, sizeof(workarea), false);
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    // テーブルは A=0, B=1 の2つだけなので相手は番号の反転
+    if ((rc = partition_get(cur, &running)) != PICO_OK || (rc = partition_get(cur ^ 1, &target)) != PICO_OK) {
+        return rc;
+    }
+    if (size == 0 || size > target.size) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    image_size = size;
+    written = 0;
+    memcpy(expected_hash, hash, FW_UPDATE_HASH_LEN);
+    state = FWU_RECEIVING;
+    return PICO_OK;
+}
+
+// 書き込み位置を確認する。再送された既知の範囲は true を返して読み捨てさせる
+static int check_position(uint32_t offset, uint32_t len, bool *duplicate) {
+    if (state != FWU_RECEIVING) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    *duplicate = offset + len <= written;
+    if (*duplicate) {
+        return PICO_OK;
+    }
+    if (offset != written || len > image_size - offset) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    return PICO_OK;
+}
+
+int fw_update_write(uint32_t offset, const void *data, size_t len) {
+    bool duplicate;
+    int rc = check_position(offset, (uint32_t)len, &duplicate);
+    if (rc != PICO_OK || duplicate) {
+        return rc;
+    }
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; ++i) {
+        put_byte(p[i]);
+    }
+    return PICO_OK;
+}
+
+int fw_update_copy(uint32_t offset, uint32_t src_offset, uint32_t len) {
+    bool duplicate;
+    int rc = check_position(offset, len, &duplicate);
+    if (rc != PICO_OK || duplicate) {
+        return rc;
+    }
+    if (src_offset > running.size || len > running.size - src_offset) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    const uint8_t *src = flash_ptr(running.start + src_offset);
+    for (uint32_t i = 0; i < len; ++i) {
+        put_byte(src[i]);
+    }
+    return PICO_OK;
+}
+
+int fw_update_finish(void) {
+    if (state != FWU_RECEIVING) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    if (written != image_size) {
+        return PICO_ERROR_PRECONDITION_NOT_MET;
+    }
+    // 書いた内容をフラッシュから読み戻してハッシュを取る (SHA-256 ハードウェア)。
+    // イメージ全体を読むので、この間だけクロックと電圧を上げる
+    pico_sha256_state_t sha;
+    int rc = pico_sha256_start_blocking(&sha, SHA256_BIG_ENDIAN, false);
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    clock_profile_id prev = clock_profile_get();
+    clock_profile_set(CLOCK_PROFILE_BURST);
+    pico_sha256_update_blocking(&sha, flash_ptr(target.start), image_size);
+    sha256_result_t result;
+    pico_sha256_finish(&sha, &result);
+    clock_profile_set(prev);
+    if (memcmp(result.bytes, expected_hash, FW_UPDATE_HASH_LEN) != 0) {
+        state = FWU_IDLE;
+        return PICO_ERROR_INVALID_DATA;
+    }
+    state = FWU_VERIFIED;
+    return PICO_OK;
+}
+
+bool fw_update_ready(void) {
+    return state == FWU_VERIFIED;
+}
+
+int fw_update_apply(void) {
+    if (state != FWU_VERIFIED) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    if (!update_permitted()) {
+        return PICO_ERROR_NOT_PERMITTED;
+    }
+    // FLASH_UPDATE 指定の再起動では、そのパーティションのイメージを TBYB で1回だけ試す
+    return rom_reboot(REBOOT2_FLAG_REBOOT_TYPE_FLASH_UPDATE | REBOOT2_FLAG_NO_RETURN_ON_SUCCESS, 100,
+                      XIP_BASE + target.start, 0);
+}
+
+bool fw_update_pending_confirm(void) {
+    boot_info_t info;
+    return rom_get_boot_info(&info) && (info.tbyb_and_update_info & BOOT_TBYB_AND_UPDATE_FLAG_BUY_PENDING);
+}
+
+int fw_update_confirm(void) {
+    if (!fw_update_pending_confirm()) {
+        return PICO_OK;
+    }
+    return rom_explicit_buy(workarea, sizeof(workarea));
+}
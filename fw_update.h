@@ -0,0 +1,52 @@
+#ifndef FW_UPDATE_H
+#define FW_UPDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A/B パーティションによるファームウェア更新 (partition_table.json の A=0, B=1)。
+// 実行中でない方のパーティションにイメージを先頭から順に書き込み、SHA-256 を検証してから
+// try-before-you-buy (TBYB) で再起動する。新しいイメージが fw_update_confirm() を呼ぶ前に
+// 落ちるか固まると、ブートROMのウォッチドッグ (約16.7秒) で次の起動時に元のイメージへ戻る。
+//
+// 差分更新: 実行中イメージと同じ部分は fw_update_copy() でパーティション間コピーし、
+// 変わった部分だけ fw_update_write() で送る。どちらも書き込み位置は先頭から連続であること。
+//
+// SHA-256 は転送と書き込みの誤りを見つけるだけで、イメージの出どころは確かめない。署名の検証は
+// ブートROMのセキュアブートに任せ、OTP でセキュアブートが有効でないチップでは更新を受け付けない
+// (fw_update_begin / fw_update_apply が PICO_ERROR_NOT_PERMITTED)。有効なチップのブートROMは、
+// OTP の鍵で署名されていないイメージを TBYB の試用起動でも起動せず、元のイメージのまま起動する。
+// イメージの署名は CMake の INCLINOMETER_SIGNING_KEY。開発用のボードに限り
+// INCLINOMETER_FW_UPDATE_ALLOW_UNSIGNED (FW_UPDATE_ALLOW_UNSIGNED) で確認を外せる。
+
+#define FW_UPDATE_HASH_LEN 32u
+
+#ifndef FW_UPDATE_ALLOW_UNSIGNED
+#define FW_UPDATE_ALLOW_UNSIGNED 0
+#endif
+
+// 更新を開始する。書き込み先パーティションを決め、期待するイメージサイズとハッシュを覚える。
+// セキュアブートが無効なら PICO_ERROR_NOT_PERMITTED
+int fw_update_begin(uint32_t image_size, const uint8_t hash[FW_UPDATE_HASH_LEN]);
+// イメージの offset から data を書く。既に書いた範囲の再送は読み捨てて PICO_OK
+int fw_update_write(uint32_t offset, const void *data, size_t len);
+// 実行中イメージの src_offset から len バイトを offset にコピーする (差分更新用)
+int fw_update_copy(uint32_t offset, uint32_t src_offset, uint32_t len);
+// 書き込みを終え、書き込み先を読み戻してハッシュを検証する
+int fw_update_finish(void);
+// 検証済みで適用できる状態か
+bool fw_update_ready(void);
+// 検証済みイメージで TBYB 再起動する (成功すれば戻らない)
+int fw_update_apply(void);
+
+// TBYB で起動して確定待ちか
+bool fw_update_pending_confirm(void);
+// 正常に動作できたら呼ぶ。確定待ちでなければ何もしない
+int fw_update_confirm(void);
+
+// シリアル (UART) 経由の受信。ホストが接続されていなければすぐに PICO_ERROR_NO_DATA で戻る。
+// 検証済みイメージを受け取り、ホストが適用を指示したら PICO_OK
+int fw_update_serial_poll(void);
+
+#endif
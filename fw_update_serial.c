@@ -0,0 +1,133 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+#include "hardware/watchdog.h"
+#include "fw_update.h"
+#include "crc32.h"
+#include "periph_power.h"
+#include "board_pins.h"
+
+// UART でのイメージ受信。ホスト側ツールが1フレームずつ送り、毎回の応答を待ってから次を送る。
+//   要求: [0xa5][cmd][len: u16][payload: len][crc32: u32]  (crc32 は cmd から payload まで、リトルエンディアン)
+//   応答: [0x5a][cmd][status: int8]
+//   'B' 開始    payload = image_size: u32, sha256: 32 バイト
+//   'D' データ  payload = offset: u32, data
+//   'C' コピー  payload = offset: u32, src_offset: u32, len: u32 (実行中イメージから。差分更新用)
+//   'E' 終了    payload なし。ハッシュを検証する
+//   'R' 適用    payload なし。検証済みなら応答後に poll から PICO_OK で戻る
+// 取りこぼしたフレームはホストが同じ offset で再送する (書き込み済みの範囲は読み捨てる)。
+
+#ifndef FW_UPDATE_UART
+#define FW_UPDATE_UART uart1
+#endif
+#ifndef FW_UPDATE_BAUD
+#define FW_UPDATE_BAUD 115200u
+#endif
+// この時間フレームが来なければセッションを終える
+#ifndef FW_UPDATE_IDLE_TIMEOUT_MS
+#define FW_UPDATE_IDLE_TIMEOUT_MS 30000u
+#endif
+#define FW_UPDATE_BYTE_TIMEOUT_US (100u * 1000u)
+
+#define FRAME_SYNC 0xa5u
+#define REPLY_SYNC 0x5au
+#define FRAME_MAX_PAYLOAD (12u + 1024u)
+
+static uint8_t __uninitialized_ram(frame)[FRAME_MAX_PAYLOAD];
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool read_bytes(uint8_t *dst, size_t len, uint32_t timeout_us) {
+    for (size_t i = 0; i < len; ++i) {
+        if (!uart_is_readable_within_us(FW_UPDATE_UART, timeout_us)) {
+            return false;
+        }
+        dst[i] = (uint8_t)uart_getc(FW_UPDATE_UART);
+    }
+    return true;
+}
+
+static void reply(uint8_t cmd, int status) {
+    uint8_t buf[3] = {REPLY_SYNC, cmd, (uint8_t)(int8_t)status};
+    uart_write_blocking(FW_UPDATE_UART, buf, sizeof(buf));
+}
+
+// 1フレーム受信して処理する。cmd には受けたコマンドを返す
+static int handle_frame(uint8_t *cmd) {
+    uint8_t hdr[3];
+    if (!read_bytes(hdr, sizeof(hdr), FW_UPDATE_BYTE_TIMEOUT_US)) {
+        return PICO_ERROR_TIMEOUT;
+    }
+    *cmd = hdr[0];
+    size_t len = (size_t)hdr[1] | ((size_t)hdr[2] << 8);
+    if (len > sizeof(frame)) {
+        return PICO_ERROR_BUFFER_TOO_SMALL;
+    }
+    uint8_t crc_le[4];
+    if (!read_bytes(frame, len, FW_UPDATE_BYTE_TIMEOUT_US) || !read_bytes(crc_le, 4, FW_UPDATE_BYTE_TIMEOUT_US)) {
+        return PICO_ERROR_TIMEOUT;
+    }
+    uint32_t crc = crc32_update(crc32_update(0, hdr, sizeof(hdr)), frame, len);
+    if (crc != get_u32(crc_le)) {
+        return PICO_ERROR_INVALID_DATA;
+    }
+
+    switch (*cmd) {
+        case 'B':
+            return len == 4u + FW_UPDATE_HASH_LEN ? fw_update_begin(get_u32(frame), frame + 4) : PICO_ERROR_INVALID_ARG;
+        case 'D':
+            return len > 4u ? fw_update_write(get_u32(frame), frame + 4, len - 4u) : PICO_ERROR_INVALID_ARG;
+        case 'C':
+            return len == 12u ? fw_update_copy(get_u32(frame), get_u32(frame + 4), get_u32(frame + 8))
+                              : PICO_ERROR_INVALID_ARG;
+        case 'E':
+            return fw_update_finish();
+        case 'R':
+            return fw_update_ready() ? PICO_OK : PICO_ERROR_INVALID_STATE;
+        default:
+            return PICO_ERROR_INVALID_ARG;
+    }
+}
+
+int fw_update_serial_poll(void) {
+    // 未接続の RX はプルダウンで Low、USB-UART が繋がっていればアイドルの High になる
+    gpio_init(FW_UPDATE_PIN_RX);
+    gpio_pull_down(FW_UPDATE_PIN_RX);
+    sleep_us(50);
+    if (!gpio_get(FW_UPDATE_PIN_RX)) {
+        return PICO_ERROR_NO_DATA;
+    }
+
+    periph_acquire((periph_id)(PERIPH_UART0 + uart_get_index(FW_UPDATE_UART)));
+    uart_init(FW_UPDATE_UART, FW_UPDATE_BAUD);
+    gpio_set_function(FW_UPDATE_PIN_TX, GPIO_FUNC_UART);
+    gpio_set_function(FW_UPDATE_PIN_RX, GPIO_FUNC_UART);
+
+    int result = PICO_ERROR_NO_DATA;
+    uint64_t deadline = time_us_64() + FW_UPDATE_IDLE_TIMEOUT_MS * 1000ull;
+    while (time_us_64() < deadline) {
+        uint8_t sync;
+        watchdog_update();
+        if (!read_bytes(&sync, 1, 10u * 1000u) || sync != FRAME_SYNC) {
+            continue;
+        }
+        uint8_t cmd = 0;
+        int rc = handle_frame(&cmd);
+        reply(cmd, rc);
+        deadline = time_us_64() + FW_UPDATE_IDLE_TIMEOUT_MS * 1000ull;
+        if (cmd == 'R' && rc == PICO_OK) {
+            result = PICO_OK;
+            break;
+        }
+    }
+
+    uart_tx_wait_blocking(FW_UPDATE_UART);
+    uart_deinit(FW_UPDATE_UART);
+    periph_release((periph_id)(PERIPH_UART0 + uart_get_index(FW_UPDATE_UART)));
+    gpio_deinit(FW_UPDATE_PIN_TX);
+    gpio_deinit(FW_UPDATE_PIN_RX);
+    return result;
+}
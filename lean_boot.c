@@ -0,0 +1,58 @@
+#include "pico/stdlib.h"
+#include "pico/runtime_init.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/xosc.h"
+#include "hardware/ticks.h"
+#include "hardware/powman.h"
+#include "lean_boot.h"
+#include "powman_example.h"
+#include "powman_resume.h"
+
+static boot_time_record boot_time;
+
+#if PICO_RUNTIME_SKIP_INIT_CLOCKS
+// SDK の runtime_init_clocks の代わり。clk_sys/clk_peri/clk_adc を pll_usb の 48MHz で動かし、
+// pll_sys は起こさない (clock_profile_set で 48MHz より上げるときに初めて起動する)
+void lean_boot_clocks(void) {
+    xosc_init();
+    pll_init(pll_usb, PLL_USB_REFDIV, PLL_USB_VCO_FREQ_HZ, PLL_USB_POSTDIV1, PLL_USB_POSTDIV2);
+
+    clock_configure_undivided(clk_ref, CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC, 0, XOSC_HZ);
+    clock_configure_undivided(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                              CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+    clock_configure_undivided(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+    clock_configure_undivided(clk_adc, 0, CLOCKS_CLK_ADC_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+    // USB と HSTX は使わない
+    clock_stop(clk_usb);
+    clock_stop(clk_hstx);
+
+    // µs タイマー・ウォッチドッグなどのティックは clk_ref (XOSC) から作る
+    for (uint i = 0; i < TICK_COUNT; ++i) {
+        tick_start((tick_gen_num_t)i, XOSC_HZ / MHZ);
+    }
+}
+PICO_RUNTIME_INIT_FUNCTION(lean_boot_clocks, PICO_RUNTIME_INIT_CLOCKS);
+#endif
+
+void lean_boot_mark_main(void) {
+    // µs タイマーはクロック設定で動き始めるので、その時点からの経過時間になる
+    boot_time.clocks_to_main_us = time_us_32();
+    boot_time.tag = BOOT_TIME_RECORD_TAG;
+    boot_time.flags = powman_resume_woke() ? BOOT_TIME_FLAG_RESUMED : 0;
+    boot_time.wake_to_main_ms = BOOT_TIME_UNKNOWN_MS;
+
+    // ブートROMの時間も含めた値は、powman タイマー (ms) で起床アラームの時刻から測る。
+    // GPIO で先に起きたときはアラームがまだ先なので測れない
+    if (powman_timer_is_running()) {
+        uint64_t now = powman_timer_get_ms();
+        uint64_t alarm = powman_example_alarm_ms();
+        if (now >= alarm && now - alarm < BOOT_TIME_UNKNOWN_MS) {
+            boot_time.wake_to_main_ms = (uint16_t)(now - alarm);
+        }
+    }
+}
+
+void lean_boot_get(boot_time_record *out) {
+    *out = boot_time;
+}
@@ -0,0 +1,37 @@
+#ifndef LEAN_BOOT_H
+#define LEAN_BOOT_H
+
+#include <stdint.h>
+
+// 起動時間の短縮と計測。
+// タイマー起床のたびに再起動するので、起動時間がそのまま起床回数倍で効く。
+// LEAN_BOOT (CMake の INCLINOMETER_LEAN_BOOT) では SDK の実行時初期化のうち
+//   - クロック初期化 (XOSC → pll_sys 150MHz、直後に main で 48MHz に下げ直していた)
+//     → pll_usb の 48MHz だけを起こす lean_boot_clocks() に置き換え
+//   - USB PHY の電源断 (periph_power_init が行う)
+//   - クロック設定後の周辺リセット解除 (periph_power_init がすぐにリセットし直す)
+// を省く。大きな作業用バッファは __uninitialized_ram に置き、crt0 のゼロ埋めを省いている。
+
+// ログ・テレメトリに書く記録
+#define BOOT_TIME_RECORD_TAG 0x42u // 'B'
+#define BOOT_TIME_UNKNOWN_MS UINT16_MAX
+#define BOOT_TIME_FLAG_RESUMED 0x01u // powman_resume の直接再開で main() に入った
+
+typedef struct {
+    uint8_t tag;
+    uint8_t flags;              // BOOT_TIME_FLAG_*
+    uint16_t wake_to_main_ms;   // 起床アラームの時刻から main() まで (アラーム以外の起床は BOOT_TIME_UNKNOWN_MS)
+    uint32_t clocks_to_main_us; // クロック設定 (µs タイマー開始) から main() まで
+} boot_time_record;
+
+#if PICO_RUNTIME_SKIP_INIT_CLOCKS
+// 起動時のクロック設定。直接再開 (powman_resume) でも同じものを呼ぶ
+void lean_boot_clocks(void);
+#endif
+
+// main() の先頭で呼ぶ
+void lean_boot_mark_main(void);
+// lean_boot_mark_main() で測った値
+void lean_boot_get(boot_time_record *out);
+
+#endif
@@ -0,0 +1,22 @@
+#include "pico/stdlib.h"
+#include "lora_radio.h"
+
+// データレートごとの最大ペイロード長と送信時間 (ハードウェアに触らないのでホストのテストでも使う)
+
+static const uint8_t dr_max_payload[LORA_DR_COUNT] = {51, 51, 51, 115, 222, 222};
+
+size_t lora_max_payload(uint32_t data_rate) {
+    return data_rate < LORA_DR_COUNT ? dr_max_payload[data_rate] : 0;
+}
+
+// Semtech AN1200.13 の式 (125kHz, CR 4/5, 明示ヘッダ, CRC あり)
+uint32_t lora_time_on_air_us(uint32_t data_rate, size_t len) {
+    int32_t sf = (int32_t)lora_dr_sf(data_rate);
+    int32_t de = sf >= 11 ? 1 : 0;
+    uint32_t tsym_us = (1u << sf) * 8u; // 2^SF / 125kHz
+    int32_t num = 8 * (int32_t)len - 4 * sf + 28 + 16;
+    int32_t den = 4 * (sf - 2 * de);
+    int32_t n = num > 0 ? (num + den - 1) / den : 0;
+    uint32_t payload_symbols = 8u + (uint32_t)n * (LORA_CR_4_5 + 4u);
+    return (LORA_PREAMBLE_LEN * 4u + 17u) * tsym_us / 4u + payload_symbols * tsym_us;
+}
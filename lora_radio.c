@@ -0,0 +1,166 @@
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "lora_radio.h"
+#include "periph_power.h"
+#include "board_pins.h"
+
+// SPI バスは外付け NOR と共用し、CS で切り替える
+#ifndef LORA_SPI
+#define LORA_SPI spi0
+#endif
+#ifndef LORA_BAUD
+#define LORA_BAUD (8u * 1000u * 1000u)
+#endif
+#ifndef LORA_FREQ_HZ
+#define LORA_FREQ_HZ 923200000u // AS923 (日本)
+#endif
+#ifndef LORA_TX_POWER_DBM
+#define LORA_TX_POWER_DBM 13
+#endif
+
+#define REG_FIFO 0x00
+#define REG_OP_MODE 0x01
+#define REG_FRF_MSB 0x06
+#define REG_FRF_MID 0x07
+#define REG_FRF_LSB 0x08
+#define REG_PA_CONFIG 0x09
+#define REG_FIFO_ADDR_PTR 0x0d
+#define REG_FIFO_TX_BASE_ADDR 0x0e
+#define REG_IRQ_FLAGS 0x12
+#define REG_MODEM_CONFIG_1 0x1d
+#define REG_MODEM_CONFIG_2 0x1e
+#define REG_PREAMBLE_MSB 0x20
+#define REG_PREAMBLE_LSB 0x21
+#define REG_PAYLOAD_LENGTH 0x22
+#define REG_MODEM_CONFIG_3 0x26
+#define REG_SYNC_WORD 0x39
+#define REG_VERSION 0x42
+
+#define MODE_LONG_RANGE 0x80
+#define MODE_SLEEP 0x00
+#define MODE_STDBY 0x01
+#define MODE_TX 0x03
+#define IRQ_TX_DONE 0x08
+#define PA_BOOST 0x80
+#define SX1276_VERSION 0x12
+#define LORAWAN_SYNC_WORD 0x34
+
+#define LORA_BW_125K 0x07
+
+static bool bus_acquired;
+
+static inline periph_id lora_bus(void) {
+    return (periph_id)(PERIPH_SPI0 + spi_get_index(LORA_SPI));
+}
+
+static void reg_write(uint8_t reg, uint8_t value) {
+    uint8_t buf[2] = {(uint8_t)(reg | 0x80u), value};
+    gpio_put(LORA_PIN_CS, 0);
+    spi_write_blocking(LORA_SPI, buf, sizeof(buf));
+    gpio_put(LORA_PIN_CS, 1);
+}
+
+static uint8_t reg_read(uint8_t reg) {
+    uint8_t addr = reg & 0x7fu;
+    uint8_t value;
+    gpio_put(LORA_PIN_CS, 0);
+    spi_write_blocking(LORA_SPI, &addr, 1);
+    spi_read_blocking(LORA_SPI, 0, &value, 1);
+    gpio_put(LORA_PIN_CS, 1);
+    return value;
+}
+
+int lora_radio_init(void) {
+    if (!bus_acquired) {
+        periph_acquire(lora_bus());
+        bus_acquired = true;
+    }
+    spi_init(LORA_SPI, LORA_BAUD);
+    gpio_set_function(LORA_PIN_SCK, GPIO_FUNC_SPI);
+    gpio_set_function(LORA_PIN_MOSI, GPIO_FUNC_SPI);
+    gpio_set_function(LORA_PIN_MISO, GPIO_FUNC_SPI);
+    gpio_init(LORA_PIN_CS);
+    gpio_put(LORA_PIN_CS, 1);
+    gpio_set_dir(LORA_PIN_CS, GPIO_OUT);
+
+    // RESET はオープンドレイン的に扱う (Low で駆動 → 入力に戻す)
+    gpio_init(LORA_PIN_RESET);
+    gpio_set_dir(LORA_PIN_RESET, GPIO_OUT);
+    gpio_put(LORA_PIN_RESET, 0);
+    sleep_us(100);
+    gpio_set_dir(LORA_PIN_RESET, GPIO_IN);
+    sleep_ms(5);
+
+    if (reg_read(REG_VERSION) != SX1276_VERSION) {
+        periph_release(lora_bus());
+        bus_acquired = false;
+        return PICO_ERROR_IO;
+    }
+
+    // LoRa モードへの切り替えは Sleep 中にしかできない
+    reg_write(REG_OP_MODE, MODE_SLEEP);
+    reg_write(REG_OP_MODE, MODE_LONG_RANGE | MODE_SLEEP);
+
+    uint64_t frf = ((uint64_t)LORA_FREQ_HZ << 19) / 32000000u;
+    reg_write(REG_FRF_MSB, (uint8_t)(frf >> 16));
+    reg_write(REG_FRF_MID, (uint8_t)(frf >> 8));
+    reg_write(REG_FRF_LSB, (uint8_t)frf);
+    reg_write(REG_PA_CONFIG, PA_BOOST | (uint8_t)(LORA_TX_POWER_DBM - 2));
+    reg_write(REG_FIFO_TX_BASE_ADDR, 0);
+    reg_write(REG_PREAMBLE_MSB, 0);
+    reg_write(REG_PREAMBLE_LSB, LORA_PREAMBLE_LEN);
+    reg_write(REG_SYNC_WORD, LORAWAN_SYNC_WORD);
+    reg_write(REG_MODEM_CONFIG_1, (LORA_BW_125K << 4) | (LORA_CR_4_5 << 1));
+    return PICO_OK;
+}
+
+int lora_radio_transmit(uint32_t data_rate, const uint8_t *data, size_t len) {
+    if (data_rate >= LORA_DR_COUNT || len == 0 || len > lora_max_payload(data_rate)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (!bus_acquired) {
+        return PICO_ERROR_INVALID_STATE; // lora_radio_init() が必要
+    }
+    uint32_t sf = lora_dr_sf(data_rate);
+    reg_write(REG_OP_MODE, MODE_LONG_RANGE | MODE_STDBY);
+    reg_write(REG_MODEM_CONFIG_2, (uint8_t)((sf << 4) | 0x04u)); // CRC on
+    // シンボル長が 16ms を超える SF11/12 では LowDataRateOptimize が必須
+    reg_write(REG_MODEM_CONFIG_3, (sf >= 11 ? 0x08u : 0x00u) | 0x04u);
+
+    reg_write(REG_FIFO_ADDR_PTR, 0);
+    uint8_t addr = REG_FIFO | 0x80u;
+    gpio_put(LORA_PIN_CS, 0);
+    spi_write_blocking(LORA_SPI, &addr, 1);
+    spi_write_blocking(LORA_SPI, data, len);
+    gpio_put(LORA_PIN_CS, 1);
+    reg_write(REG_PAYLOAD_LENGTH, (uint8_t)len);
+
+    reg_write(REG_IRQ_FLAGS, 0xff);
+    reg_write(REG_OP_MODE, MODE_LONG_RANGE | MODE_TX);
+
+    // 送信時間 + 余裕を超えたらタイムアウト
+    uint64_t deadline = time_us_64() + lora_time_on_air_us(data_rate, len) + 100u * 1000u;
+    int rc = PICO_OK;
+    while (!(reg_read(REG_IRQ_FLAGS) & IRQ_TX_DONE)) {
+        if (time_us_64() > deadline) {
+            rc = PICO_ERROR_TIMEOUT;
+            break;
+        }
+        sleep_ms(1);
+    }
+    reg_write(REG_IRQ_FLAGS, 0xff);
+    lora_radio_sleep();
+    return rc;
+}
+
+// チップを Sleep にして SPI ブロックを手放す (既に手放していれば何もしない)
+int lora_radio_sleep(void) {
+    if (!bus_acquired) {
+        return PICO_OK;
+    }
+    reg_write(REG_OP_MODE, MODE_LONG_RANGE | MODE_SLEEP);
+    periph_release(lora_bus());
+    bus_acquired = false;
+    return PICO_OK;
+}
@@ -0,0 +1,31 @@
+#ifndef LORA_RADIO_H
+#define LORA_RADIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// SX1276/RFM95 系 LoRa トランシーバのドライバ (LoRa 変調の送信のみ)。
+// データレートは LoRaWAN Regional Parameters (AS923/EU868) の DR0-DR5 (SF12-SF7, 125kHz) に合わせる
+
+#define LORA_DR_COUNT 6
+// 変調の設定 (送信時間の計算にも使う)
+#define LORA_CR_4_5 0x01
+#define LORA_PREAMBLE_LEN 8
+
+static inline uint32_t lora_dr_sf(uint32_t data_rate) {
+    return 12u - data_rate;
+}
+
+int lora_radio_init(void);
+int lora_radio_transmit(uint32_t data_rate, const uint8_t *data, size_t len);
+// 最低消費電力 (Sleep モード) にする。レジスタ設定は保持される
+int lora_radio_sleep(void);
+
+// ここから下はハードウェアに触らない (lora_airtime.c)
+
+// データレートごとの最大ペイロード長 (LoRaWAN の N 値)
+size_t lora_max_payload(uint32_t data_rate);
+// 送信時間 (µs)。デューティ比の計算に使う
+uint32_t lora_time_on_air_us(uint32_t data_rate, size_t len);
+
+#endif
@@ -0,0 +1,63 @@
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "powman_example.h"
+#include "powman_scratch.h"
+#include "supply_monitor.h"
+#include "wake_sources.h"
+#include "micro_wake.h"
+
+#define MICRO_WAKE_TICKS_MAX 0xffffu
+
+static inline uint32_t ticks_get(void) {
+    return powman_hw->scratch[SCRATCH_SLEEP_ENTRY] >> MICRO_WAKE_TICKS_LSB;
+}
+
+static inline void ticks_set(uint32_t ticks) {
+    powman_hw->scratch[SCRATCH_SLEEP_ENTRY] =
+        (powman_hw->scratch[SCRATCH_SLEEP_ENTRY] & SLEEP_ENTRY_US_MASK) | (ticks << MICRO_WAKE_TICKS_LSB);
+}
+
+void micro_wake_run(void) {
+#if MICRO_WAKE_INTERVAL_MS
+    // 残りティックは通常の起床処理が眠る直前にだけ設定する (チップリセットで 0)
+    uint32_t ticks = ticks_get();
+    if (ticks == 0) {
+        return;
+    }
+    // GPIO で起きたら通常の処理に任せる (ティックは残し、処理の後で中断されたアラームまで眠る)
+    if (wake_sources_primary() != WAKE_SOURCE_ALARM) {
+        return;
+    }
+    ticks_set(ticks - 1u);
+    powman_hw->scratch[SCRATCH_WAKE_COUNT]++;
+
+    // ピンはスリープ時の状態のまま保持されている。触るのは ADC の入力ピンだけ
+    uint32_t mv = supply_monitor_read_mv();
+    uint32_t ref_mv = powman_hw->scratch[SCRATCH_SUPPLY] & SUPPLY_MV_MASK; // 前回の通常起床で測った値
+    uint32_t delta = mv > ref_mv ? mv - ref_mv : ref_mv - mv;
+    if (mv < SUPPLY_LOW_MV || delta >= MICRO_WAKE_SUPPLY_DELTA_MV) {
+        ticks_set(0);
+        return;
+    }
+
+    powman_example_init(0); // タイマーは動いているので時刻は変わらない
+    powman_example_sleep_decided();
+    wake_sources_off_for_ms(MICRO_WAKE_INTERVAL_MS);
+    // 電源断に失敗したら通常の起床処理に任せる (失敗の記録とフォールバックはそちらで行う)
+    ticks_set(0);
+#endif
+}
+
+int micro_wake_off(uint32_t sleep_ms) {
+#if MICRO_WAKE_INTERVAL_MS
+    uint32_t n = sleep_ms / MICRO_WAKE_INTERVAL_MS;
+    if (n >= 2u) {
+        // n - 1 回のティックの後、n 回目の起床で通常の処理に戻る
+        ticks_set(MIN(n - 1u, MICRO_WAKE_TICKS_MAX));
+        int rc = wake_sources_off_for_ms(MICRO_WAKE_INTERVAL_MS);
+        ticks_set(0);
+        return rc;
+    }
+#endif
+    return wake_sources_off_for_ms(sleep_ms);
+}
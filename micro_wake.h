@@ -0,0 +1,27 @@
+#ifndef MICRO_WAKE_H
+#define MICRO_WAKE_H
+
+#include <stdint.h>
+
+// 高頻度のタイマー起床を短い経路で済ませる。
+// 休止時間を MICRO_WAKE_INTERVAL_MS ごとの短い起床 (ティック) に分け、ティックでは
+// 電源電圧を1回測ってウェイク回数を数えるだけで、ログ・設定・キュー・ピン・周辺機器の
+// 初期化をせずにすぐ眠り直す。状態 (残りティック数) は powman スクラッチだけに置く。
+// 電圧がしきい値を割るか前回の通常起床から MICRO_WAKE_SUPPLY_DELTA_MV 以上変わったら、
+// そのまま通常の起床処理に進む。アラーム以外 (GPIO) で起きたときもティックを数えずに進む。
+// MICRO_WAKE_INTERVAL_MS = 0 (既定) なら無効で、休止時間をそのまま1回で眠る。
+
+#ifndef MICRO_WAKE_INTERVAL_MS
+#define MICRO_WAKE_INTERVAL_MS 0u
+#endif
+#ifndef MICRO_WAKE_SUPPLY_DELTA_MV
+#define MICRO_WAKE_SUPPLY_DELTA_MV 100u
+#endif
+
+// main() の先頭 (クロック設定の直後) で呼ぶ。ティックなら眠り直して戻らない。
+// 通常の起床処理が必要なら戻る
+void micro_wake_run(void);
+// 通常の起床処理の最後に呼ぶ。sleep_ms をティックに分けて眠る。成功すれば戻らない
+int micro_wake_off(uint32_t sleep_ms);
+
+#endif
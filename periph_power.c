@@ -0,0 +1,105 @@
+#include "pico/stdlib.h"
+#include "hardware/resets.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/usb.h"
+#include "periph_power.h"
+
+typedef struct {
+    uint32_t reset_bits;
+    uint32_t clk_en0; // WAKE_EN0/SLEEP_EN0 のビット (両方同じ配置)
+    uint32_t clk_en1; // WAKE_EN1/SLEEP_EN1 のビット
+} periph_desc;
+
+static const periph_desc periphs[PERIPH_COUNT] = {
+    [PERIPH_ADC] = {RESETS_RESET_ADC_BITS, CLOCKS_WAKE_EN0_CLK_SYS_ADC_BITS | CLOCKS_WAKE_EN0_CLK_ADC_BITS, 0},
+    [PERIPH_SPI0] = {RESETS_RESET_SPI0_BITS, 0, CLOCKS_WAKE_EN1_CLK_SYS_SPI0_BITS | CLOCKS_WAKE_EN1_CLK_PERI_SPI0_BITS},
+    [PERIPH_SPI1] = {RESETS_RESET_SPI1_BITS, 0, CLOCKS_WAKE_EN1_CLK_SYS_SPI1_BITS | CLOCKS_WAKE_EN1_CLK_PERI_SPI1_BITS},
+    [PERIPH_I2C0] = {RESETS_RESET_I2C0_BITS, CLOCKS_WAKE_EN0_CLK_SYS_I2C0_BITS, 0},
+    [PERIPH_I2C1] = {RESETS_RESET_I2C1_BITS, CLOCKS_WAKE_EN0_CLK_SYS_I2C1_BITS, 0},
+    [PERIPH_UART0] = {RESETS_RESET_UART0_BITS, 0, CLOCKS_WAKE_EN1_CLK_SYS_UART0_BITS | CLOCKS_WAKE_EN1_CLK_PERI_UART0_BITS},
+    [PERIPH_UART1] = {RESETS_RESET_UART1_BITS, 0, CLOCKS_WAKE_EN1_CLK_SYS_UART1_BITS | CLOCKS_WAKE_EN1_CLK_PERI_UART1_BITS},
+    [PERIPH_PWM] = {RESETS_RESET_PWM_BITS, CLOCKS_WAKE_EN0_CLK_SYS_PWM_BITS, 0},
+    [PERIPH_USB] = {RESETS_RESET_USBCTRL_BITS, 0, CLOCKS_WAKE_EN1_CLK_SYS_USBCTRL_BITS | CLOCKS_WAKE_EN1_CLK_USB_BITS},
+};
+
+static uint8_t refcount[PERIPH_COUNT];
+
+static void clocks_on(const periph_desc *p) {
+    hw_set_bits(&clocks_hw->wake_en0, p->clk_en0);
+    hw_set_bits(&clocks_hw->sleep_en0, p->clk_en0);
+    hw_set_bits(&clocks_hw->wake_en1, p->clk_en1);
+    hw_set_bits(&clocks_hw->sleep_en1, p->clk_en1);
+}
+
+static void clocks_off(const periph_desc *p) {
+    hw_clear_bits(&clocks_hw->wake_en0, p->clk_en0);
+    hw_clear_bits(&clocks_hw->sleep_en0, p->clk_en0);
+    hw_clear_bits(&clocks_hw->wake_en1, p->clk_en1);
+    hw_clear_bits(&clocks_hw->sleep_en1, p->clk_en1);
+}
+
+// USB PHY を電源断し、DP/DM をプルダウンする (USBCTRL のクロックが動いている間に書くこと)
+static void usb_phy_off(void) {
+    usb_hw->phy_direct = USB_USBPHY_DIRECT_TX_PD_BITS | USB_USBPHY_DIRECT_RX_PD_BITS | USB_USBPHY_DIRECT_DM_PULLDN_EN_BITS | USB_USBPHY_DIRECT_DP_PULLDN_EN_BITS;
+    usb_hw->phy_direct_override = USB_USBPHY_DIRECT_RX_DM_BITS | USB_USBPHY_DIRECT_RX_DP_BITS | USB_USBPHY_DIRECT_RX_DD_BITS |
+        USB_USBPHY_DIRECT_OVERRIDE_TX_DIFFMODE_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DM_PULLUP_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_FSSLEW_OVERRIDE_EN_BITS |
+        USB_USBPHY_DIRECT_OVERRIDE_TX_PD_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_RX_PD_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DM_OVERRIDE_EN_BITS |
+        USB_USBPHY_DIRECT_OVERRIDE_TX_DP_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DM_OE_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_TX_DP_OE_OVERRIDE_EN_BITS |
+        USB_USBPHY_DIRECT_OVERRIDE_DM_PULLDN_EN_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLDN_EN_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLUP_EN_OVERRIDE_EN_BITS |
+        USB_USBPHY_DIRECT_OVERRIDE_DM_PULLUP_HISEL_OVERRIDE_EN_BITS | USB_USBPHY_DIRECT_OVERRIDE_DP_PULLUP_HISEL_OVERRIDE_EN_BITS;
+}
+
+static void power_off(periph_id id) {
+    const periph_desc *p = &periphs[id];
+    if (id == PERIPH_USB) {
+        usb_phy_off();
+    } else {
+        reset_block(p->reset_bits);
+    }
+    clocks_off(p);
+}
+
+void periph_power_init(void) {
+    // USB の PHY レジスタはリセット解除されていないと書けない
+    const periph_desc *usb = &periphs[PERIPH_USB];
+    clocks_on(usb);
+    unreset_block_wait(usb->reset_bits);
+
+    for (int id = 0; id < PERIPH_COUNT; ++id) {
+        refcount[id] = 0;
+        power_off((periph_id)id);
+    }
+}
+
+int periph_acquire(periph_id id) {
+    if ((unsigned)id >= PERIPH_COUNT || refcount[id] == UINT8_MAX) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (refcount[id]++ == 0) {
+        const periph_desc *p = &periphs[id];
+        clocks_on(p);
+        if (id == PERIPH_USB) {
+            usb_hw->phy_direct_override = 0;
+        } else {
+            unreset_block_wait(p->reset_bits);
+        }
+    }
+    return PICO_OK;
+}
+
+int periph_release(periph_id id) {
+    if ((unsigned)id >= PERIPH_COUNT) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (refcount[id] == 0) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    if (--refcount[id] == 0) {
+        power_off(id);
+    }
+    return PICO_OK;
+}
+
+uint32_t periph_refcount(periph_id id) {
+    return (unsigned)id < PERIPH_COUNT ? refcount[id] : 0;
+}
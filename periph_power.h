@@ -0,0 +1,32 @@
+#ifndef PERIPH_POWER_H
+#define PERIPH_POWER_H
+
+#include <stdint.h>
+
+// 周辺機器の電源管理 (参照カウント)。
+// 誰も使っていないブロックはリセットに入れ、クロックの WAKE_EN/SLEEP_EN も落としておく。
+// ドライバは使う前に periph_acquire()、使い終わったら periph_release() を呼ぶ
+// (SDK の spi_init/uart_init/adc_init は acquire の後に呼ぶこと)。
+// USB だけは PHY の電源断オーバーライドを保持するためリセットせず、クロックだけを止める。
+
+typedef enum {
+    PERIPH_ADC,
+    PERIPH_SPI0,
+    PERIPH_SPI1,
+    PERIPH_I2C0,
+    PERIPH_I2C1,
+    PERIPH_UART0,
+    PERIPH_UART1,
+    PERIPH_PWM,
+    PERIPH_USB,
+    PERIPH_COUNT
+} periph_id;
+
+// 起動時に1回。管理対象をすべて停止状態にする (USB は PHY を電源断してプルダウン)
+void periph_power_init(void);
+int periph_acquire(periph_id id);
+// 参照が 0 になったらリセットしてクロックを止める。取得していなければ PICO_ERROR_INVALID_STATE
+int periph_release(periph_id id);
+uint32_t periph_refcount(periph_id id);
+
+#endif
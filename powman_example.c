@@ -5,17 +5,40 @@
 #include "pico/sync.h"
 #include "hardware/gpio.h"
 #include "hardware/powman.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/xosc.h"
 #include "powman_example.h"
+#include "powman_scratch.h"
+#include "powman_resume.h"
 
+// Set to 1 to print each power off over stdio (adds a stdio flush to every sleep entry)
+#ifndef POWMAN_EXAMPLE_VERBOSE
+#define POWMAN_EXAMPLE_VERBOSE 0
+#endif
 
 static powman_power_state off_state;
 static powman_power_state on_state;
 
-// Initialise everything
-void powman_example_init(uint64_t abs_time_ms) {
-    // start powman and set the time
-    powman_timer_start();
-    powman_timer_set_ms(abs_time_ms);
+// Everything about power off that does not change between cycles, worked out by init
+static int off_config_rc = PICO_ERROR_INVALID_STATE;
+static uint32_t off_state_req; // value for the STATE register, password included
+
+// Sleep entry timing (time_us_32 when the caller decided to sleep)
+static uint32_t decided_us;
+static bool decided;
+
+// Initialise everything. Returns true on a cold start
+bool powman_example_init(uint64_t abs_time_ms) {
+    // start powman and set the time, unless it kept running through power down
+    bool cold_start = !powman_timer_is_running();
+    if (cold_start) {
+        powman_timer_start();
+        powman_timer_set_ms(abs_time_ms);
+    }
+
+    // Wake sources survive power down, so start from a clean slate every boot
+    powman_disable_all_wakeups();
 
     // Allow power down when debugger connected
     powman_set_debug_power_request_ignored(true);
@@ -27,77 +50,168 @@ void powman_example_init(uint64_t abs_time_ms) {
     P0_3 = powman_power_state_with_domain_on(P0_3, POWMAN_POWER_DOMAIN_SWITCHED_CORE);
     P0_3 = powman_power_state_with_domain_on(P0_3, POWMAN_POWER_DOMAIN_XIP_CACHE);
 
+#if POWMAN_DIRECT_RESUME
+    // Keep both SRAM banks powered while off so the resume entry and the saved context survive
+    P1_7 = powman_power_state_with_domain_on(P1_7, POWMAN_POWER_DOMAIN_SRAM_BANK0);
+    P1_7 = powman_power_state_with_domain_on(P1_7, POWMAN_POWER_DOMAIN_SRAM_BANK1);
+    P0_3 = powman_power_state_with_domain_on(P0_3, POWMAN_POWER_DOMAIN_SRAM_BANK0);
+    P0_3 = powman_power_state_with_domain_on(P0_3, POWMAN_POWER_DOMAIN_SRAM_BANK1);
+#endif
+
     off_state = P1_7;
     on_state = P0_3;
+    decided = false;
+
+    // The wakeup state lives in powman (always on), so configure it once here rather than per sleep
+    off_config_rc = powman_configure_wakeup_state(off_state, on_state) ? PICO_OK : PICO_ERROR_INVALID_STATE;
+    off_state_req = POWMAN_PASSWORD_BITS | ((~(uint32_t)off_state << POWMAN_STATE_REQ_LSB) & POWMAN_STATE_REQ_BITS);
+
+    // Boot vector: all zero reboots to main, otherwise the bootrom jumps to the resume entry
+    uint32_t boot[4];
+    powman_resume_boot_vector(boot);
+    for (uint i = 0; i < 4; ++i) {
+        powman_hw->boot[i] = boot[i];
+    }
+    return cold_start;
+}
+
+void powman_example_sleep_decided(void) {
+    decided_us = time_us_32();
+    decided = true;
+}
+
+uint32_t powman_example_last_sleep_entry_us(void) {
+    return powman_hw->scratch[SCRATCH_SLEEP_ENTRY] & SLEEP_ENTRY_US_MASK;
 }
 
-// Initiate power off
+// Initiate power off. Only the per-cycle part is left here: init has already
+// configured the wakeup state, set the boot vector and built the request
 static int powman_example_off(void) {
-    // Get ready to power off
+    if (off_config_rc != PICO_OK) {
+        return off_config_rc;
+    }
+#if POWMAN_EXAMPLE_VERBOSE
     stdio_flush();
+#endif
 
-    // Set power states
-    bool valid_state = powman_configure_wakeup_state(off_state, on_state);
-    if (!valid_state) {
-        return PICO_ERROR_INVALID_STATE;
+    // Record how long sleep entry took (read back after the next wake)
+    uint32_t now = time_us_32();
+    uint32_t elapsed = decided ? now - decided_us : 0;
+    if (elapsed > SLEEP_ENTRY_US_MASK) {
+        elapsed = SLEEP_ENTRY_US_MASK;
     }
+    powman_hw->scratch[SCRATCH_SLEEP_ENTRY] = (powman_hw->scratch[SCRATCH_SLEEP_ENTRY] & ~SLEEP_ENTRY_US_MASK) | elapsed;
 
-    // reboot to main
-    powman_hw->boot[0] = 0;
-    powman_hw->boot[1] = 0;
-    powman_hw->boot[2] = 0;
-    powman_hw->boot[3] = 0;
+    // Last, so the saved NVIC/timer state is what we actually power off with
+    powman_resume_save();
 
-    // Switch to required power state
-    int rc = powman_set_power_state(off_state);
-    if (rc != PICO_OK) {
-        return rc;
+    // Switch to the off state (same checks as powman_set_power_state)
+    hw_clear_bits(&powman_hw->state, POWMAN_PASSWORD_BITS | POWMAN_STATE_REQ_IGNORED_BITS);
+    powman_hw->state = off_state_req;
+    if (powman_hw->state & POWMAN_STATE_REQ_IGNORED_BITS) {
+        return PICO_ERROR_PRECONDITION_NOT_MET;
+    }
+    if (powman_hw->state & POWMAN_STATE_BAD_SW_REQ_BITS) {
+        return PICO_ERROR_INVALID_ARG;
     }
 
     // Power down
     while (true) __wfi();
 }
 
-// Power off until a gpio goes high
-int powman_example_off_until_gpio_high(int gpio) {
+// Power off until a gpio changes to the given level. The wake is edge triggered, so
+// a pin already at that level has to leave it and come back first - the same thing
+// the old code waited for by polling, but done by powman while powered off
+static int powman_example_off_until_gpio_edge(int gpio, bool high) {
     gpio_init(gpio);
     gpio_set_dir(gpio, false);
-    if (gpio_get(gpio)) {
-        printf("Waiting for gpio %d to go low\n", gpio);
-        while(gpio_get(gpio)) {
-            sleep_ms(100);
-        }
-    }
-    printf("Powering off until GPIO %d goes high\n", gpio);
-    powman_enable_gpio_wakeup(0, gpio, false, true);
+#if POWMAN_EXAMPLE_VERBOSE
+    printf("Powering off until GPIO %d goes %s\n", gpio, high ? "high" : "low");
+#endif
+    powman_enable_gpio_wakeup(0, gpio, true, high);
     return powman_example_off();
 }
 
+// Power off until a gpio goes high
+int powman_example_off_until_gpio_high(int gpio) {
+    return powman_example_off_until_gpio_edge(gpio, true);
+}
+
 // Power off until a gpio goes low
 int powman_example_off_until_gpio_low(int gpio) {
+    return powman_example_off_until_gpio_edge(gpio, false);
+}
+
+// Power off until a gpio is at the given level, or until an absolute time (0 = no timeout).
+// Unlike the functions above this is level triggered, so the caller must make sure
+// the pin is not already at the wake level (or it wakes straight away).
+int powman_example_off_until_gpio_level(int gpio, bool high, uint64_t abs_time_ms) {
     gpio_init(gpio);
     gpio_set_dir(gpio, false);
-    if (!gpio_get(gpio)) {
-        printf("Waiting for gpio %d to go high\n", gpio);
-        while(!gpio_get(gpio)) {
-            sleep_ms(100);
-        }
+    powman_enable_gpio_wakeup(0, gpio, false, high);
+    if (abs_time_ms) {
+        powman_enable_alarm_wakeup_at_ms(abs_time_ms);
     }
-    printf("Powering off until GPIO %d goes low\n", gpio);
-    powman_enable_gpio_wakeup(0, gpio, false, false);
     return powman_example_off();
 }
 
 // Power off until an absolute time
 int powman_example_off_until_time(uint64_t abs_time_ms) {
     // Start powman timer and turn off
+#if POWMAN_EXAMPLE_VERBOSE
     printf("Powering off for %"PRIu64"ms\n", abs_time_ms - powman_timer_get_ms());
+#endif
     powman_enable_alarm_wakeup_at_ms(abs_time_ms);
     return powman_example_off();
 }
 
+uint64_t powman_example_alarm_ms(void) {
+    return ((uint64_t)powman_hw->alarm_time_63to48 << 48) | ((uint64_t)powman_hw->alarm_time_47to32 << 32) |
+           ((uint64_t)powman_hw->alarm_time_31to16 << 16) | powman_hw->alarm_time_15to0;
+}
+
 // Power off for a number of milliseconds
 int powman_example_off_for_ms(uint64_t duration_ms) {
     uint64_t ms = powman_timer_get_ms();
     return powman_example_off_until_time(ms + duration_ms);
 }
+
+// Fallback when power off fails: stay powered but stop all clocks (DORMANT)
+// until an absolute time. The powman timer keeps running from the LPOSC and its
+// alarm restarts the XOSC. Returns after waking, running from the XOSC with the
+// PLLs off, so the caller should reboot to restore the normal clock setup.
+int powman_example_dormant_until_time(uint64_t abs_time_ms) {
+    if (abs_time_ms <= powman_timer_get_ms()) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    stdio_flush();
+
+    // The timer must not depend on the XOSC we are about to stop
+    powman_timer_use_lposc();
+
+    // Run everything from the XOSC so the PLLs can be stopped
+    if (!clock_configure_undivided(clk_ref, CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC, 0, XOSC_HZ) ||
+        !clock_configure_undivided(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0, XOSC_HZ) ||
+        !clock_configure_undivided(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS, XOSC_HZ)) {
+        return PICO_ERROR_GENERIC;
+    }
+    clock_stop(clk_usb);
+    clock_stop(clk_adc);
+    clock_stop(clk_hstx);
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+
+    // The alarm interrupt is what takes the XOSC out of DORMANT (it is not enabled in the NVIC)
+    powman_enable_alarm_wakeup_at_ms(abs_time_ms);
+    hw_set_bits(&powman_hw->inte, POWMAN_INTE_TIMER_BITS);
+
+    xosc_dormant();
+
+    hw_clear_bits(&powman_hw->inte, POWMAN_INTE_TIMER_BITS);
+    powman_disable_alarm_wakeup();
+    return PICO_OK;
+}
+
+int powman_example_dormant_for_ms(uint64_t duration_ms) {
+    return powman_example_dormant_until_time(powman_timer_get_ms() + duration_ms);
+}
@@ -1,10 +1,36 @@
 #ifndef POWMAN_EXAMPLE_H
 #define POWMAN_EXAMPLE_H
 
-void powman_example_init(uint64_t abs_time_ms);
+#include <stdint.h>
+#include <stdbool.h>
+
+bool powman_example_init(uint64_t abs_time_ms);
 int powman_example_off_until_gpio_high(int gpio);
 int powman_example_off_until_gpio_low(int gpio);
+int powman_example_off_until_gpio_level(int gpio, bool high, uint64_t abs_time_ms);
 int powman_example_off_until_time(uint64_t abs_time_ms);
 int powman_example_off_for_ms(uint64_t duration_ms);
+int powman_example_dormant_until_time(uint64_t abs_time_ms);
+int powman_example_dormant_for_ms(uint64_t duration_ms);
+
+// The wake alarm time as last programmed (ms). Survives power down, so after a wake it
+// still holds the alarm that was armed for the sleep just ended
+uint64_t powman_example_alarm_ms(void);
+
+// Sleep entry instrumentation. Call powman_example_sleep_decided() at the point the
+// wake cycle decides to sleep; the next power off stores the time from there to the
+// power state request (µs, saturating at 65535) for the following wake to read back.
+void powman_example_sleep_decided(void);
+uint32_t powman_example_last_sleep_entry_us(void);
+
+// Log/telemetry record for the value above
+#define SLEEP_ENTRY_RECORD_TAG 0x45u // 'E'
+
+typedef struct {
+    uint8_t tag;
+    uint8_t reserved;
+    uint16_t entry_us;
+    uint32_t wake_count;
+} sleep_entry_record;
 
 #endif
@@ -0,0 +1,148 @@
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "pico/bootrom.h"
+#include "hardware/flash.h"
+#include "hardware/resets.h"
+#include "hardware/structs/m33.h"
+#include "hardware/structs/nvic.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/timer.h"
+#include "crc32.h"
+#include "lean_boot.h"
+#include "powman_resume.h"
+
+#if POWMAN_DIRECT_RESUME
+
+#if !PICO_RUNTIME_SKIP_INIT_CLOCKS
+#error "POWMAN_DIRECT_RESUME needs the lean boot clock setup (INCLINOMETER_LEAN_BOOT)"
+#endif
+
+// ブートベクタの形式 (ウォッチドッグのスクラッチと同じ)
+#define BOOT_VECTOR_MAGIC 0xb007c0d3u
+#define RESUME_CONTEXT_MAGIC 0x52534d31u // "RSM1"
+
+#define NVIC_ENABLE_WORDS ((NUM_IRQS + 31) / 32)
+#define NVIC_PRIORITY_WORDS ((NUM_IRQS + 3) / 4)
+
+// 電源断でリセットされたままになり、ほかに解除するところのないブロック
+// (periph_power が管理する周辺・未使用の HSTX・pll_init が自分でリセットする PLL を除く)
+#define RESUME_UNRESET_BITS                                                                                   \
+    (RESETS_RESET_BITS &                                                                                      \
+     ~(RESETS_RESET_ADC_BITS | RESETS_RESET_HSTX_BITS | RESETS_RESET_I2C0_BITS | RESETS_RESET_I2C1_BITS |    \
+       RESETS_RESET_PWM_BITS | RESETS_RESET_SPI0_BITS | RESETS_RESET_SPI1_BITS | RESETS_RESET_UART0_BITS |   \
+       RESETS_RESET_UART1_BITS | RESETS_RESET_USBCTRL_BITS | RESETS_RESET_PLL_SYS_BITS |                      \
+       RESETS_RESET_PLL_USB_BITS))
+
+// 電源断で消えるコアの状態 (保持された SRAM に置く)
+typedef struct {
+    uint32_t magic;
+    uint32_t entry;
+    uint32_t vtor;
+    uint32_t cpacr;
+    uint32_t nvic_enable[NVIC_ENABLE_WORDS];
+    uint32_t nvic_priority[NVIC_PRIORITY_WORDS];
+    uint32_t timer_inte;
+    uint32_t crc; // ここまでの CRC
+} resume_context;
+
+static resume_context context;
+static bool resumed;
+
+extern uint32_t __StackTop;
+extern int main(void);
+
+static void powman_resume_entry(void);
+
+static uint32_t __not_in_flash_func(context_crc)(void) {
+    return crc32_update(0, &context, offsetof(resume_context, crc));
+}
+
+// 再開をあきらめ、ベクタを消して通常の起動で再起動する
+static void __no_inline_not_in_flash_func(resume_fallback)(void) {
+    powman_hw->boot[0] = 0;
+    rom_reboot(REBOOT2_FLAG_REBOOT_TYPE_NORMAL | REBOOT2_FLAG_NO_RETURN_ON_SUCCESS, 1, 0, 0);
+    while (true) {
+        __wfi();
+    }
+}
+
+// XIP が戻ってから (フラッシュ上で) 実行する。SDK の実行時初期化の代わり
+static void resume_runtime_init(void) {
+    unreset_block_wait(RESUME_UNRESET_BITS);
+    lean_boot_clocks();
+    timer_hw->inte = context.timer_inte;
+    for (uint i = 0; i < NVIC_PRIORITY_WORDS; ++i) {
+        nvic_hw->ipr[i] = context.nvic_priority[i];
+    }
+    for (uint i = 0; i < NVIC_ENABLE_WORDS; ++i) {
+        nvic_hw->iser[i] = context.nvic_enable[i];
+    }
+}
+
+// ブートROMから SP = __StackTop で入る。XIP が戻るまでフラッシュに触れないこと
+static void __no_inline_not_in_flash_func(powman_resume_entry)(void) {
+    if (context.magic != RESUME_CONTEXT_MAGIC || context.entry != (uintptr_t)powman_resume_entry ||
+        context.crc != context_crc()) {
+        resume_fallback();
+    }
+    // 1回限り: 保存し直さなかった起床で同じ状態を使わないように
+    context.magic = 0;
+
+    // SDK がフラッシュ操作のあとに行うのと同じ手順で XIP に戻る
+    unreset_block_wait(RESETS_RESET_IO_QSPI_BITS | RESETS_RESET_PADS_QSPI_BITS);
+    uint8_t read_status[2] = {0x05, 0};
+    flash_do_cmd(read_status, read_status, sizeof(read_status));
+
+    scb_hw->vtor = context.vtor;
+    m33_hw->cpacr = context.cpacr;
+    resumed = true;
+
+    resume_runtime_init();
+    main();
+    resume_fallback();
+}
+
+void powman_resume_boot_vector(uint32_t boot[4]) {
+    uint32_t pc = (uintptr_t)powman_resume_entry;
+    boot[0] = BOOT_VECTOR_MAGIC;
+    boot[1] = pc ^ -BOOT_VECTOR_MAGIC;
+    boot[2] = (uintptr_t)&__StackTop;
+    boot[3] = pc;
+}
+
+void powman_resume_save(void) {
+    context.magic = RESUME_CONTEXT_MAGIC;
+    context.entry = (uintptr_t)powman_resume_entry;
+    context.vtor = scb_hw->vtor;
+    context.cpacr = m33_hw->cpacr;
+    for (uint i = 0; i < NVIC_ENABLE_WORDS; ++i) {
+        context.nvic_enable[i] = nvic_hw->iser[i];
+    }
+    for (uint i = 0; i < NVIC_PRIORITY_WORDS; ++i) {
+        context.nvic_priority[i] = nvic_hw->ipr[i];
+    }
+    context.timer_inte = timer_hw->inte;
+    context.crc = context_crc();
+}
+
+bool powman_resume_woke(void) {
+    return resumed;
+}
+
+#else
+
+void powman_resume_boot_vector(uint32_t boot[4]) {
+    // すべて 0: 通常の起動で main に入る
+    for (uint i = 0; i < 4; ++i) {
+        boot[i] = 0;
+    }
+}
+
+void powman_resume_save(void) {
+}
+
+bool powman_resume_woke(void) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef POWMAN_RESUME_H
+#define POWMAN_RESUME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 起床時のブートROM経由の直接再開 (POWMAN_DIRECT_RESUME=1、CMake の INCLINOMETER_DIRECT_RESUME)。
+// 休止中も SRAM を保持し、BOOT0..3 で SRAM 上の再開処理に入る。ブートROMのイメージ検査・crt0・
+// SDK の実行時初期化を省き、電源断で消えるコアの状態と XIP・クロックを戻して main() を呼び直す。
+// 保存した状態が壊れていれば通常の起動で再起動する。main() の static は電源断の時点のまま残るので、
+// 一度だけの初期化は初期化済みの状態で呼ばれても動くこと。休止中は SRAM の保持電流が増える。
+
+#ifndef POWMAN_DIRECT_RESUME
+#define POWMAN_DIRECT_RESUME 0
+#endif
+
+// BOOT0..3 の値 (無効なときはすべて 0 = 通常の起動)
+void powman_resume_boot_vector(uint32_t boot[4]);
+// 再開処理が戻す状態を保存する。電源断を要求する直前に呼ぶ
+void powman_resume_save(void);
+// 今回の main() が再開処理から呼ばれたか
+bool powman_resume_woke(void);
+
+#endif
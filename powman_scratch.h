@@ -0,0 +1,24 @@
+#ifndef POWMAN_SCRATCH_H
+#define POWMAN_SCRATCH_H
+
+// powman スクラッチレジスタ (P1.7 の電源断でも保持、チップリセットで 0) の割り当て
+enum powman_scratch_index {
+    SCRATCH_WAKE_COUNT = 0,     // ウェイク回数
+    SCRATCH_UPLINK_EARLIEST_S = 1, // デューティ比制限による次の送信可能時刻 (s)
+    SCRATCH_UPLINK_SCHED_S = 2,    // 次の定期送信時刻 (s)
+    SCRATCH_FAULT = 3,             // 最後の故障と連続故障回数 (supervisor.c)
+    SCRATCH_SUPPLY = 4,            // [31] 低電圧停止中フラグ、[15:0] 最後の電源電圧 (supply_monitor.c)
+                                   // [30:16] ログの書き込み中セクタ / 単位 + 1 (0 = 不明, flash_log.c)
+    SCRATCH_SOLAR_AVG_UW = 5,      // 発電電力の移動平均 (µW, solar_scheduler.c)
+    SCRATCH_SOLAR_LAST_S = 6,      // 移動平均を最後に更新した時刻 (s)
+    SCRATCH_SLEEP_ENTRY = 7,       // [15:0] 前回の電源断の判断から要求までの時間 (µs, powman_example.c)
+                                   // [31:16] 次の通常起床までの残りティック数 (micro_wake.c)
+};
+
+#define SLEEP_ENTRY_US_MASK 0xffffu
+#define SUPPLY_MV_MASK 0xffffu
+#define LOG_HEAD_HINT_LSB 16u
+#define LOG_HEAD_HINT_MASK 0x7fff0000u
+#define MICRO_WAKE_TICKS_LSB 16u
+
+#endif
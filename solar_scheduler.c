@@ -0,0 +1,115 @@
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/structs/powman.h"
+#include "powman_scratch.h"
+#include "periph_power.h"
+#include "solar_scheduler.h"
+
+#define ADC_SAMPLES 16u
+#define ADC_VREF_MV 3300u
+
+// 測定と計算は毎回の起床で通るので SRAM に置く (XIP キャッシュミスを避ける)。
+// ピンと ADC の初期化は SDK のフラッシュ上の関数なので、呼び出し側で済ませておく
+static uint32_t __not_in_flash_func(adc_read_mv)(uint32_t pin) {
+    adc_select_input(pin - 26u);
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < ADC_SAMPLES; ++i) {
+        sum += adc_read();
+    }
+    return sum * ADC_VREF_MV / (ADC_SAMPLES * 4096u);
+}
+
+// 電池に入っている電力 (µW)。パネル電圧が電池より低い (夜間) ときはオフセット誤差とみなして 0
+static uint32_t measure_harvest_uw(uint32_t battery_mv) {
+    periph_acquire(PERIPH_ADC);
+    adc_init();
+    adc_gpio_init(SOLAR_PANEL_ADC_PIN);
+    adc_gpio_init(SOLAR_CURRENT_ADC_PIN);
+    uint32_t panel_mv = adc_read_mv(SOLAR_PANEL_ADC_PIN) * SOLAR_PANEL_DIVIDER;
+    uint32_t current_ua = (uint32_t)((uint64_t)adc_read_mv(SOLAR_CURRENT_ADC_PIN) * 1000000u / SOLAR_CURRENT_UV_PER_MA);
+    periph_release(PERIPH_ADC);
+    if (panel_mv <= battery_mv) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)current_ua * battery_mv / 1000u);
+}
+
+void solar_scheduler_update(uint64_t now_ms, uint32_t battery_mv, energy_plan *plan) {
+    solar_scheduler_plan(now_ms, battery_mv, measure_harvest_uw(battery_mv), plan);
+}
+
+// 前回の測定から dt の間 harvest_uw が続いたとみなして移動平均を進める
+static uint32_t __not_in_flash_func(update_average)(uint32_t now_s, uint32_t harvest_uw) {
+    uint32_t last_s = powman_hw->scratch[SCRATCH_SOLAR_LAST_S];
+    uint32_t avg = powman_hw->scratch[SCRATCH_SOLAR_AVG_UW];
+    if (last_s == 0) {
+        avg = harvest_uw; // コールドスタート
+    } else {
+        uint32_t dt = now_s - last_s;
+        if (dt > SOLAR_WINDOW_S) {
+            dt = SOLAR_WINDOW_S;
+        }
+        int64_t diff = (int64_t)harvest_uw - (int64_t)avg;
+        avg = (uint32_t)((int64_t)avg + diff * (int64_t)dt / (int64_t)SOLAR_WINDOW_S);
+    }
+    powman_hw->scratch[SCRATCH_SOLAR_AVG_UW] = avg;
+    powman_hw->scratch[SCRATCH_SOLAR_LAST_S] = now_s ? now_s : 1u;
+    return avg;
+}
+
+static __force_inline void set_sample_hz(energy_plan *plan, uint32_t hz) {
+    plan->sample_hz = hz;
+    plan->awake_uw = SOLAR_AWAKE_UW + (hz - SOLAR_SAMPLE_MIN_HZ) * SOLAR_SAMPLE_UW_PER_HZ;
+}
+
+void __not_in_flash_func(solar_scheduler_plan)(uint64_t now_ms, uint32_t battery_mv, uint32_t harvest_uw, energy_plan *plan) {
+    uint32_t avg = update_average((uint32_t)(now_ms / 1000u), harvest_uw);
+    plan->harvest_uw = harvest_uw;
+    plan->harvest_avg_uw = avg;
+
+    // 予備の下限を割っていたら、発電量に関係なく最小動作で電池を回復させる
+    if (battery_mv <= SOLAR_RESERVE_MV) {
+        plan->awake_ms = SOLAR_AWAKE_RESERVE_MS;
+        plan->sleep_ms = SOLAR_SLEEP_MAX_MS;
+        set_sample_hz(plan, SOLAR_SAMPLE_MIN_HZ);
+        return;
+    }
+    plan->awake_ms = SOLAR_AWAKE_MS;
+    if (battery_mv >= SOLAR_FULL_MV) {
+        plan->sleep_ms = SOLAR_SLEEP_MIN_MS; // 満充電: 余る発電は捨てるだけなので最大動作
+        set_sample_hz(plan, SOLAR_SAMPLE_MAX_HZ);
+        return;
+    }
+
+    // 使ってよい平均電力。電池残量が中間より多ければ多めに、少なければ控えめにして残量を中間へ寄せる
+    uint32_t factor = 500u + (battery_mv - SOLAR_RESERVE_MV) * 1000u / (SOLAR_FULL_MV - SOLAR_RESERVE_MV);
+    uint64_t budget = (uint64_t)avg * SOLAR_CHARGE_EFFICIENCY_PERMILLE / 1000u * factor / 1000u;
+
+    // 最短の休止時間で平均消費が budget になる測定中の電力 Pa = (budget*(Ta + Ts) - Ps*Ts) / Ta。
+    // 最低レートの電力を超える分だけレートを上げる
+    uint64_t full_uw = budget * (plan->awake_ms + SOLAR_SLEEP_MIN_MS);
+    uint64_t sleep_uw = (uint64_t)SOLAR_SLEEP_UW * SOLAR_SLEEP_MIN_MS;
+    uint64_t spare_hz = 0;
+    if (full_uw > sleep_uw + (uint64_t)SOLAR_AWAKE_UW * plan->awake_ms) {
+        spare_hz = (full_uw - sleep_uw - (uint64_t)SOLAR_AWAKE_UW * plan->awake_ms) /
+                   ((uint64_t)SOLAR_SAMPLE_UW_PER_HZ * plan->awake_ms);
+    }
+    set_sample_hz(plan, (uint32_t)MIN(SOLAR_SAMPLE_MIN_HZ + spare_hz, SOLAR_SAMPLE_MAX_HZ));
+
+    // 平均消費 (Pa*Ta + Ps*Ts) / (Ta + Ts) = budget を Ts について解く
+    uint64_t sleep_ms;
+    if (budget <= SOLAR_SLEEP_UW) {
+        sleep_ms = SOLAR_SLEEP_MAX_MS;
+    } else if (budget >= plan->awake_uw) {
+        sleep_ms = SOLAR_SLEEP_MIN_MS;
+    } else {
+        sleep_ms = (uint64_t)(plan->awake_uw - budget) * plan->awake_ms / (budget - SOLAR_SLEEP_UW);
+    }
+    if (sleep_ms < SOLAR_SLEEP_MIN_MS) {
+        sleep_ms = SOLAR_SLEEP_MIN_MS;
+    }
+    if (sleep_ms > SOLAR_SLEEP_MAX_MS) {
+        sleep_ms = SOLAR_SLEEP_MAX_MS;
+    }
+    plan->sleep_ms = (uint32_t)sleep_ms;
+}
@@ -0,0 +1,83 @@
+#ifndef SOLAR_SCHEDULER_H
+#define SOLAR_SCHEDULER_H
+
+#include <stdint.h>
+#include "board_pins.h"
+
+// 太陽電池の発電量に合わせた起床間隔の決定 (エネルギー収支ゼロ)。
+// 起床ごとに充電電流と電池電圧から発電電力を測り、SOLAR_WINDOW_S の指数移動平均を
+// powman スクラッチに保持する (電源断をまたぐので RAM のリングバッファは使えない)。
+// 平均消費電力 = 平均発電電力 × 充電効率 × 電池残量による係数 になるよう休止時間を決め、
+// 電池が予備の下限を割っていれば発電量に関係なく最も控えめな間隔にする。
+// 測定中のセンサーの標本化レートも同じ予算から決める: 最短の休止時間でも予算が余るときだけ、
+// 余った分でレートを SOLAR_SAMPLE_MIN_HZ から上げる (足りないときは最低レートで休止を延ばす)。
+
+#ifndef SOLAR_PANEL_DIVIDER
+#define SOLAR_PANEL_DIVIDER 3u
+#endif
+#ifndef SOLAR_CURRENT_UV_PER_MA
+#define SOLAR_CURRENT_UV_PER_MA 5000u // 0.1Ω × 50倍
+#endif
+
+// 移動平均の時間窓 (日周期をならす)
+#ifndef SOLAR_WINDOW_S
+#define SOLAR_WINDOW_S (24u * 60u * 60u)
+#endif
+#ifndef SOLAR_CHARGE_EFFICIENCY_PERMILLE
+#define SOLAR_CHARGE_EFFICIENCY_PERMILLE 800u
+#endif
+// 電池電圧: これ以下は予備 (最小動作)、これ以上は満充電 (最大動作)
+#ifndef SOLAR_RESERVE_MV
+#define SOLAR_RESERVE_MV 3600u
+#endif
+#ifndef SOLAR_FULL_MV
+#define SOLAR_FULL_MV 4100u
+#endif
+
+// 消費電力のモデル
+#ifndef SOLAR_AWAKE_UW
+#define SOLAR_AWAKE_UW 50000u // 48MHz 動作 + センサー (SOLAR_SAMPLE_MIN_HZ)
+#endif
+#ifndef SOLAR_SLEEP_UW
+#define SOLAR_SLEEP_UW 150u // P1.7
+#endif
+// 標本化レートの範囲と、最低レートから 1Hz 上げるごとに増える測定中の電力 (センサーと SPI の読み出し)
+#ifndef SOLAR_SAMPLE_MIN_HZ
+#define SOLAR_SAMPLE_MIN_HZ 10u
+#endif
+#ifndef SOLAR_SAMPLE_MAX_HZ
+#define SOLAR_SAMPLE_MAX_HZ 100u
+#endif
+#ifndef SOLAR_SAMPLE_UW_PER_HZ
+#define SOLAR_SAMPLE_UW_PER_HZ 100u
+#endif
+
+// 休止時間・起床時間の範囲
+#ifndef SOLAR_SLEEP_MIN_MS
+#define SOLAR_SLEEP_MIN_MS 5000u
+#endif
+#ifndef SOLAR_SLEEP_MAX_MS
+#define SOLAR_SLEEP_MAX_MS (60u * 60u * 1000u)
+#endif
+#ifndef SOLAR_AWAKE_MS
+#define SOLAR_AWAKE_MS 10000u
+#endif
+#ifndef SOLAR_AWAKE_RESERVE_MS
+#define SOLAR_AWAKE_RESERVE_MS 2000u // 予備の下限を割っているときの測定時間
+#endif
+
+typedef struct {
+    uint32_t awake_ms; // 今回の測定時間
+    uint32_t sleep_ms; // 次の起床までの休止時間
+    uint32_t sample_hz; // 今回の測定中のセンサーの標本化レート
+    uint32_t awake_uw;  // sample_hz での測定中の消費電力 (モデル)
+    uint32_t harvest_uw;     // 今回の発電電力
+    uint32_t harvest_avg_uw; // 発電電力の移動平均
+} energy_plan;
+
+// 発電量を測って移動平均を更新し、今回の起床時間・標本化レートと次の休止時間を決める
+void solar_scheduler_update(uint64_t now_ms, uint32_t battery_mv, energy_plan *plan);
+// 測定値を与えて計画だけを立てる (移動平均の更新を含む)
+void solar_scheduler_plan(uint64_t now_ms, uint32_t battery_mv, uint32_t harvest_uw, energy_plan *plan);
+
+#endif
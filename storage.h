@@ -0,0 +1,60 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ログの保存先 (内蔵フラッシュ / 外付け SPI NOR / microSD) を切り替えるための共通インターフェース。
+// program/erase のオフセットと長さは page_size / erase_size の倍数であること。
+// erase 後の内容は 0xff として読めること (ログの空き領域判定に使う)。
+
+typedef enum {
+    STORAGE_ID_INTERNAL_FLASH = 0,
+    STORAGE_ID_SPI_NOR = 1,
+    STORAGE_ID_SD = 2,
+    STORAGE_ID_COUNT
+} storage_id;
+
+typedef struct storage_backend {
+    const char *name;
+    int (*init)(void);
+    int (*read)(uint32_t offset, void *dst, size_t len);
+    int (*program)(uint32_t offset, const void *src, size_t len);
+    int (*erase)(uint32_t offset, size_t len);
+    // スリープ前に呼ぶ (外付けデバイスを低消費電力状態にする)
+    int (*sleep)(void);
+    uint32_t (*size)(void);
+    uint32_t page_size;
+    uint32_t erase_size;
+    // program がページ全体を書き換える (SD)。書き換え中に電源が落ちるとページの既存の内容も失われる。
+    // false は NOR と同じく、書いたビットだけが 1→0 に変わる。
+    // true のバックエンドはログが消去を呼ばない (上書きだけで使う)
+    bool page_rewrite;
+} storage_backend;
+
+#define STORAGE_MAX_PAGE_SIZE 512u
+
+// 内蔵フラッシュのうちログに使う領域
+#ifndef STORAGE_FLASH_OFFSET
+#define STORAGE_FLASH_OFFSET (1u * 1024u * 1024u)
+#endif
+#ifndef STORAGE_FLASH_SIZE
+#define STORAGE_FLASH_SIZE (2u * 1024u * 1024u)
+#endif
+
+// 内蔵フラッシュのデータ領域を直接読むときのベースアドレス。
+// A/B パーティションから起動するとブートROMが XIP のアドレス変換を設定し、XIP_BASE は
+// 実行中パーティションの先頭を指すため、フラッシュの生オフセットで読む場合は変換なしの窓を使う。
+#ifndef STORAGE_XIP_BASE
+#define STORAGE_XIP_BASE XIP_NOCACHE_NOALLOC_NOTRANSLATE_BASE
+#endif
+
+extern const storage_backend storage_internal_flash;
+extern const storage_backend storage_spi_nor;
+extern const storage_backend storage_sd;
+
+// id に対応するバックエンド。範囲外なら内蔵フラッシュ
+const storage_backend *storage_backend_get(uint32_t id);
+
+#endif
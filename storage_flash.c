@@ -0,0 +1,64 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "storage.h"
+
+// 内蔵 QSPI フラッシュ (XIP) のバックエンド
+
+_Static_assert(STORAGE_FLASH_OFFSET % FLASH_SECTOR_SIZE == 0, "storage offset must be sector aligned");
+_Static_assert(STORAGE_FLASH_SIZE % FLASH_SECTOR_SIZE == 0, "storage size must be whole sectors");
+
+static int flash_init(void) {
+    return PICO_OK;
+}
+
+static int flash_read(uint32_t offset, void *dst, size_t len) {
+    memcpy(dst, (const void *)(STORAGE_XIP_BASE + STORAGE_FLASH_OFFSET + offset), len);
+    return PICO_OK;
+}
+
+static int flash_program(uint32_t offset, const void *src, size_t len) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(STORAGE_FLASH_OFFSET + offset, src, len);
+    restore_interrupts(ints);
+    return PICO_OK;
+}
+
+static int flash_erase(uint32_t offset, size_t len) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(STORAGE_FLASH_OFFSET + offset, len);
+    restore_interrupts(ints);
+    return PICO_OK;
+}
+
+static int flash_sleep(void) {
+    return PICO_OK;
+}
+
+static uint32_t flash_size(void) {
+    return STORAGE_FLASH_SIZE;
+}
+
+const storage_backend storage_internal_flash = {
+    .name = "flash",
+    .init = flash_init,
+    .read = flash_read,
+    .program = flash_program,
+    .erase = flash_erase,
+    .sleep = flash_sleep,
+    .size = flash_size,
+    .page_size = FLASH_PAGE_SIZE,
+    .erase_size = FLASH_SECTOR_SIZE,
+};
+
+const storage_backend *storage_backend_get(uint32_t id) {
+    switch (id) {
+        case STORAGE_ID_SPI_NOR:
+            return &storage_spi_nor;
+        case STORAGE_ID_SD:
+            return &storage_sd;
+        default:
+            return &storage_internal_flash;
+    }
+}
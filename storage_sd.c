@@ -0,0 +1,368 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "storage.h"
+#include "periph_power.h"
+#include "board_pins.h"
+
+// microSD (SPI モード) のバックエンド。
+// カードはファイルシステムなしの生ブロックデバイスとして STORAGE_SD_BASE_BLOCK から使う。
+// 書き込みはマルチブロック (CMD25) とし、事前に ACMD23 でブロック数を通知して
+// カード側のプレイレースを有効にする。消去は 0xff のマルチブロック書き込みで行う。
+
+#ifndef STORAGE_SD_SPI
+#define STORAGE_SD_SPI spi1
+#endif
+#ifndef STORAGE_SD_BAUD
+#define STORAGE_SD_BAUD (12500u * 1000u)
+#endif
+#ifndef STORAGE_SD_BASE_BLOCK
+#define STORAGE_SD_BASE_BLOCK 0u
+#endif
+
+#define SD_BLOCK_SIZE 512u
+#define SD_ERASE_SIZE 4096u
+#define SD_INIT_BAUD (400u * 1000u)
+
+#define SD_CMD0 0      // GO_IDLE_STATE
+#define SD_CMD8 8      // SEND_IF_COND
+#define SD_CMD9 9      // SEND_CSD
+#define SD_CMD12 12    // STOP_TRANSMISSION
+#define SD_CMD16 16    // SET_BLOCKLEN
+#define SD_CMD17 17    // READ_SINGLE_BLOCK
+#define SD_CMD24 24    // WRITE_BLOCK
+#define SD_CMD25 25    // WRITE_MULTIPLE_BLOCK
+#define SD_CMD55 55    // APP_CMD
+#define SD_CMD58 58    // READ_OCR
+#define SD_ACMD23 0x97 // SET_WR_BLK_ERASE_COUNT (0x80 は ACMD の印)
+#define SD_ACMD41 0xa9 // SD_SEND_OP_COND
+
+#define SD_R1_IDLE 0x01u
+#define SD_TOKEN_START 0xfeu
+#define SD_TOKEN_START_MULTI 0xfcu
+#define SD_TOKEN_STOP_MULTI 0xfdu
+#define SD_DATA_ACCEPTED 0x05u
+
+static bool sd_block_addressing; // SDHC/SDXC はブロック単位アドレス
+static bool sd_bus_acquired;
+static uint32_t sd_blocks;
+
+// 読み出し用の1ブロックキャッシュ (ログはヘッダ単位の小さな読み出しが多い)
+static uint8_t __uninitialized_ram(block_buf)[SD_BLOCK_SIZE];
+static uint32_t cached_block = UINT32_MAX;
+
+static uint8_t sd_xfer(uint8_t out) {
+    uint8_t in;
+    spi_write_read_blocking(STORAGE_SD_SPI, &out, &in, 1);
+    return in;
+}
+
+static bool sd_wait_ready(uint32_t timeout_ms) {
+    uint64_t deadline = time_us_64() + timeout_ms * 1000u;
+    while (sd_xfer(0xff) != 0xff) {
+        if (time_us_64() > deadline) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void sd_deselect(void) {
+    gpio_put(STORAGE_SD_PIN_CS, 1);
+    sd_xfer(0xff); // CS 解除後に 1 バイト分クロックを送って DO を解放させる
+}
+
+static inline periph_id sd_bus(void) {
+    return (periph_id)(PERIPH_SPI0 + spi_get_index(STORAGE_SD_SPI));
+}
+
+// SPI ブロックを手放す (リセットされるので設定も失われる)
+static void sd_bus_release(void) {
+    if (sd_bus_acquired) {
+        periph_release(sd_bus());
+        sd_bus_acquired = false;
+    }
+}
+
+// スリープ後の再アクセスでは SPI を取り直して設定し直す (カードは初期化済みのまま)
+static void sd_bus_resume(void) {
+    if (!sd_bus_acquired) {
+        periph_acquire(sd_bus());
+        sd_bus_acquired = true;
+        spi_init(STORAGE_SD_SPI, STORAGE_SD_BAUD);
+    }
+}
+
+static bool sd_select(void) {
+    gpio_put(STORAGE_SD_PIN_CS, 0);
+    sd_xfer(0xff);
+    if (sd_wait_ready(500)) {
+        return true;
+    }
+    sd_deselect();
+    return false;
+}
+
+// コマンドを送って R1 を返す。成功時は CS を選択したまま戻る
+static uint8_t sd_cmd(uint8_t cmd, uint32_t arg) {
+    if (cmd & 0x80u) {
+        cmd &= 0x7fu;
+        uint8_t r = sd_cmd(SD_CMD55, 0);
+        if (r > SD_R1_IDLE) {
+            return r;
+        }
+    }
+    sd_deselect();
+    if (!sd_select()) {
+        return 0xff;
+    }
+    uint8_t crc = cmd == SD_CMD0 ? 0x95 : cmd == SD_CMD8 ? 0x87 : 0x01;
+    uint8_t frame[6] = {
+        (uint8_t)(0x40u | cmd), (uint8_t)(arg >> 24), (uint8_t)(arg >> 16), (uint8_t)(arg >> 8), (uint8_t)arg, crc,
+    };
+    spi_write_blocking(STORAGE_SD_SPI, frame, sizeof(frame));
+    if (cmd == SD_CMD12) {
+        sd_xfer(0xff); // stuff byte
+    }
+    uint8_t r;
+    int n = 10;
+    do {
+        r = sd_xfer(0xff);
+    } while ((r & 0x80u) && --n);
+    return r;
+}
+
+static bool sd_read_data(uint8_t *dst, size_t len) {
+    uint64_t deadline = time_us_64() + 200u * 1000u;
+    uint8_t token;
+    while ((token = sd_xfer(0xff)) == 0xff) {
+        if (time_us_64() > deadline) {
+            return false;
+        }
+    }
+    if (token != SD_TOKEN_START) {
+        return false;
+    }
+    spi_read_blocking(STORAGE_SD_SPI, 0xff, dst, len);
+    sd_xfer(0xff); // CRC
+    sd_xfer(0xff);
+    return true;
+}
+
+static bool sd_write_data(uint8_t token, const uint8_t *src) {
+    if (!sd_wait_ready(500)) {
+        return false;
+    }
+    sd_xfer(token);
+    spi_write_blocking(STORAGE_SD_SPI, src, SD_BLOCK_SIZE);
+    sd_xfer(0xff); // CRC (SPI モードでは無視される)
+    sd_xfer(0xff);
+    return (sd_xfer(0xff) & 0x1fu) == SD_DATA_ACCEPTED;
+}
+
+static uint32_t sd_csd_blocks(const uint8_t *csd) {
+    if ((csd[0] >> 6) == 1) {
+        // CSD v2.0: (C_SIZE + 1) * 512KB
+        uint32_t c_size = ((uint32_t)(csd[7] & 0x3f) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+        return (c_size + 1u) * 1024u;
+    }
+    uint32_t c_size = ((uint32_t)(csd[6] & 0x03) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+    uint32_t c_size_mult = ((csd[9] & 0x03u) << 1) | (csd[10] >> 7);
+    uint32_t read_bl_len = csd[5] & 0x0fu;
+    return (c_size + 1u) << (c_size_mult + 2u + read_bl_len - 9u);
+}
+
+static int sd_init(void) {
+    if (!sd_bus_acquired) {
+        periph_acquire(sd_bus());
+        sd_bus_acquired = true;
+    }
+    spi_init(STORAGE_SD_SPI, SD_INIT_BAUD);
+    gpio_set_function(STORAGE_SD_PIN_SCK, GPIO_FUNC_SPI);
+    gpio_set_function(STORAGE_SD_PIN_MOSI, GPIO_FUNC_SPI);
+    gpio_set_function(STORAGE_SD_PIN_MISO, GPIO_FUNC_SPI);
+    gpio_pull_up(STORAGE_SD_PIN_MISO);
+    gpio_init(STORAGE_SD_PIN_CS);
+    gpio_put(STORAGE_SD_PIN_CS, 1);
+    gpio_set_dir(STORAGE_SD_PIN_CS, GPIO_OUT);
+    cached_block = UINT32_MAX;
+
+    // CS を上げたまま 80 クロック以上送って SPI モードに入れる
+    for (int i = 0; i < 10; ++i) {
+        sd_xfer(0xff);
+    }
+
+    int rc = PICO_ERROR_IO;
+    if (sd_cmd(SD_CMD0, 0) != SD_R1_IDLE) {
+        goto done;
+    }
+    uint64_t deadline = time_us_64() + 1000u * 1000u;
+    uint8_t ocr[4];
+    if (sd_cmd(SD_CMD8, 0x1aa) == SD_R1_IDLE) {
+        // SD v2: 電圧範囲とチェックパターンを確認し、HCS 付きで初期化
+        spi_read_blocking(STORAGE_SD_SPI, 0xff, ocr, sizeof(ocr));
+        if ((ocr[2] & 0x0f) != 0x01 || ocr[3] != 0xaa) {
+            goto done;
+        }
+        while (sd_cmd(SD_ACMD41, 1u << 30) != 0) {
+            if (time_us_64() > deadline) {
+                goto done;
+            }
+        }
+        if (sd_cmd(SD_CMD58, 0) != 0) {
+            goto done;
+        }
+        spi_read_blocking(STORAGE_SD_SPI, 0xff, ocr, sizeof(ocr));
+        sd_block_addressing = (ocr[0] & 0x40u) != 0;
+    } else {
+        // SD v1
+        while (sd_cmd(SD_ACMD41, 0) != 0) {
+            if (time_us_64() > deadline) {
+                goto done;
+            }
+        }
+        sd_block_addressing = false;
+        if (sd_cmd(SD_CMD16, SD_BLOCK_SIZE) != 0) {
+            goto done;
+        }
+    }
+
+    uint8_t csd[16];
+    if (sd_cmd(SD_CMD9, 0) != 0 || !sd_read_data(csd, sizeof(csd))) {
+        goto done;
+    }
+    sd_blocks = sd_csd_blocks(csd);
+    if (sd_blocks <= STORAGE_SD_BASE_BLOCK) {
+        goto done;
+    }
+    spi_set_baudrate(STORAGE_SD_SPI, STORAGE_SD_BAUD);
+    rc = PICO_OK;
+
+done:
+    sd_deselect();
+    if (rc != PICO_OK) {
+        sd_bus_release();
+    }
+    return rc;
+}
+
+static inline uint32_t sd_addr(uint32_t block) {
+    block += STORAGE_SD_BASE_BLOCK;
+    return sd_block_addressing ? block : block * SD_BLOCK_SIZE;
+}
+
+static int sd_read_block(uint32_t block) {
+    if (block == cached_block) {
+        return PICO_OK;
+    }
+    sd_bus_resume();
+    int rc = PICO_ERROR_IO;
+    if (sd_cmd(SD_CMD17, sd_addr(block)) == 0 && sd_read_data(block_buf, SD_BLOCK_SIZE)) {
+        cached_block = block;
+        rc = PICO_OK;
+    }
+    sd_deselect();
+    return rc;
+}
+
+static int sd_read(uint32_t offset, void *dst, size_t len) {
+    uint8_t *p = dst;
+    while (len > 0) {
+        uint32_t block = offset / SD_BLOCK_SIZE;
+        uint32_t in = offset % SD_BLOCK_SIZE;
+        size_t n = SD_BLOCK_SIZE - in < len ? SD_BLOCK_SIZE - in : len;
+        int rc = sd_read_block(block);
+        if (rc != PICO_OK) {
+            return rc;
+        }
+        memcpy(p, block_buf + in, n);
+        p += n;
+        offset += (uint32_t)n;
+        len -= n;
+    }
+    return PICO_OK;
+}
+
+// count ブロックを書き込む。src が NULL なら 0xff で埋める
+static int sd_write_blocks(uint32_t block, const uint8_t *src, uint32_t count) {
+    static const uint8_t erased[SD_BLOCK_SIZE] = {[0 ... SD_BLOCK_SIZE - 1] = 0xff};
+    if (cached_block >= block && cached_block < block + count) {
+        cached_block = UINT32_MAX;
+    }
+    sd_bus_resume();
+
+    int rc = PICO_ERROR_IO;
+    if (count == 1) {
+        if (sd_cmd(SD_CMD24, sd_addr(block)) == 0 && sd_write_data(SD_TOKEN_START, src ? src : erased)) {
+            rc = sd_wait_ready(500) ? PICO_OK : PICO_ERROR_TIMEOUT;
+        }
+        sd_deselect();
+        return rc;
+    }
+
+    if (sd_cmd(SD_ACMD23, count) != 0 || sd_cmd(SD_CMD25, sd_addr(block)) != 0) {
+        sd_deselect();
+        return rc;
+    }
+    rc = PICO_OK;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!sd_write_data(SD_TOKEN_START_MULTI, src ? src + i * SD_BLOCK_SIZE : erased)) {
+            rc = PICO_ERROR_IO;
+            break;
+        }
+    }
+    // エラー時も必ず停止トークンを送ってカードを転送状態から戻す
+    sd_wait_ready(500);
+    sd_xfer(SD_TOKEN_STOP_MULTI);
+    sd_xfer(0xff);
+    if (!sd_wait_ready(500) && rc == PICO_OK) {
+        rc = PICO_ERROR_TIMEOUT;
+    }
+    sd_deselect();
+    return rc;
+}
+
+static uint32_t sd_size(void);
+
+static int sd_program(uint32_t offset, const void *src, size_t len) {
+    if (offset % SD_BLOCK_SIZE || len % SD_BLOCK_SIZE || offset + len > sd_size()) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    return sd_write_blocks(offset / SD_BLOCK_SIZE, src, (uint32_t)(len / SD_BLOCK_SIZE));
+}
+
+static int sd_erase(uint32_t offset, size_t len) {
+    if (offset % SD_ERASE_SIZE || len % SD_ERASE_SIZE || offset + len > sd_size()) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    return sd_write_blocks(offset / SD_BLOCK_SIZE, NULL, (uint32_t)(len / SD_BLOCK_SIZE));
+}
+
+// CS を上げておけばカードは自動的にアイドル (低消費電力) 状態に入る
+static int sd_sleep(void) {
+    if (sd_bus_acquired) {
+        sd_deselect();
+        sd_bus_release();
+    }
+    return PICO_OK;
+}
+
+// オフセットは 32bit なので 4GB 手前で打ち切る
+static uint32_t sd_size(void) {
+    uint64_t bytes = (uint64_t)(sd_blocks - STORAGE_SD_BASE_BLOCK) * SD_BLOCK_SIZE;
+    return bytes > 0xfffff000u ? 0xfffff000u : (uint32_t)bytes;
+}
+
+const storage_backend storage_sd = {
+    .name = "sd",
+    .init = sd_init,
+    .read = sd_read,
+    .program = sd_program,
+    .erase = sd_erase,
+    .sleep = sd_sleep,
+    .size = sd_size,
+    .page_size = SD_BLOCK_SIZE,
+    .erase_size = SD_ERASE_SIZE,
+    .page_rewrite = true,
+};
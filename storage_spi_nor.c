@@ -0,0 +1,195 @@
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "storage.h"
+#include "periph_power.h"
+#include "board_pins.h"
+
+// 外付け SPI NOR フラッシュ (W25Qxx 等の汎用コマンドセット、3バイトアドレス) のバックエンド
+
+#ifndef STORAGE_NOR_SPI
+#define STORAGE_NOR_SPI spi0
+#endif
+#ifndef STORAGE_NOR_BAUD
+#define STORAGE_NOR_BAUD (12u * 1000u * 1000u)
+#endif
+
+#define NOR_CMD_WRITE_ENABLE 0x06
+#define NOR_CMD_READ_STATUS 0x05
+#define NOR_CMD_READ_DATA 0x03
+#define NOR_CMD_PAGE_PROGRAM 0x02
+#define NOR_CMD_SECTOR_ERASE 0x20 // 4KB
+#define NOR_CMD_BLOCK_ERASE 0xd8  // 64KB
+#define NOR_CMD_JEDEC_ID 0x9f
+#define NOR_CMD_POWER_DOWN 0xb9
+#define NOR_CMD_RELEASE_POWER_DOWN 0xab
+
+#define NOR_STATUS_BUSY 0x01u
+#define NOR_PAGE_SIZE 256u
+#define NOR_SECTOR_SIZE 4096u
+#define NOR_BLOCK_SIZE 65536u
+#define NOR_MAX_SIZE (16u * 1024u * 1024u) // 3バイトアドレスの上限
+
+static uint32_t nor_bytes;
+static bool nor_powered_down;
+static bool nor_bus_acquired;
+
+static inline void cs_select(void) {
+    gpio_put(STORAGE_NOR_PIN_CS, 0);
+}
+
+static inline void cs_deselect(void) {
+    gpio_put(STORAGE_NOR_PIN_CS, 1);
+}
+
+static void nor_cmd(uint8_t cmd) {
+    cs_select();
+    spi_write_blocking(STORAGE_NOR_SPI, &cmd, 1);
+    cs_deselect();
+}
+
+static void nor_cmd_addr(uint8_t cmd, uint32_t addr) {
+    uint8_t buf[4] = {cmd, (uint8_t)(addr >> 16), (uint8_t)(addr >> 8), (uint8_t)addr};
+    spi_write_blocking(STORAGE_NOR_SPI, buf, sizeof(buf));
+}
+
+static void nor_wait_ready(void) {
+    uint8_t cmd = NOR_CMD_READ_STATUS;
+    uint8_t status;
+    cs_select();
+    spi_write_blocking(STORAGE_NOR_SPI, &cmd, 1);
+    do {
+        spi_read_blocking(STORAGE_NOR_SPI, 0, &status, 1);
+    } while (status & NOR_STATUS_BUSY);
+    cs_deselect();
+}
+
+static inline periph_id nor_bus(void) {
+    return (periph_id)(PERIPH_SPI0 + spi_get_index(STORAGE_NOR_SPI));
+}
+
+// ディープパワーダウンから復帰させる (tRES1 は最大 3us 程度)。
+// スリープ中は SPI ブロックも手放しているので取り直して設定し直す
+static void nor_wake(void) {
+    if (!nor_bus_acquired) {
+        periph_acquire(nor_bus());
+        nor_bus_acquired = true;
+        spi_init(STORAGE_NOR_SPI, STORAGE_NOR_BAUD);
+    }
+    if (nor_powered_down) {
+        nor_cmd(NOR_CMD_RELEASE_POWER_DOWN);
+        sleep_us(5);
+        nor_powered_down = false;
+    }
+}
+
+static int nor_init(void) {
+    if (!nor_bus_acquired) {
+        periph_acquire(nor_bus());
+        nor_bus_acquired = true;
+    }
+    spi_init(STORAGE_NOR_SPI, STORAGE_NOR_BAUD);
+    gpio_set_function(STORAGE_NOR_PIN_SCK, GPIO_FUNC_SPI);
+    gpio_set_function(STORAGE_NOR_PIN_MOSI, GPIO_FUNC_SPI);
+    gpio_set_function(STORAGE_NOR_PIN_MISO, GPIO_FUNC_SPI);
+    gpio_init(STORAGE_NOR_PIN_CS);
+    gpio_put(STORAGE_NOR_PIN_CS, 1);
+    gpio_set_dir(STORAGE_NOR_PIN_CS, GPIO_OUT);
+
+    // 前回のスリープでパワーダウンしている可能性があるので必ず解除する
+    nor_powered_down = true;
+    nor_wake();
+
+    uint8_t cmd = NOR_CMD_JEDEC_ID;
+    uint8_t id[3];
+    cs_select();
+    spi_write_blocking(STORAGE_NOR_SPI, &cmd, 1);
+    spi_read_blocking(STORAGE_NOR_SPI, 0, id, sizeof(id));
+    cs_deselect();
+
+    // 容量バイトは log2(バイト数)
+    if (id[0] == 0x00 || id[0] == 0xff || id[2] < 16 || id[2] > 31) {
+        periph_release(nor_bus());
+        nor_bus_acquired = false;
+        return PICO_ERROR_IO;
+    }
+    nor_bytes = 1u << id[2];
+    if (nor_bytes > NOR_MAX_SIZE) {
+        nor_bytes = NOR_MAX_SIZE;
+    }
+    return PICO_OK;
+}
+
+static int nor_read(uint32_t offset, void *dst, size_t len) {
+    nor_wake();
+    cs_select();
+    nor_cmd_addr(NOR_CMD_READ_DATA, offset);
+    spi_read_blocking(STORAGE_NOR_SPI, 0, dst, len);
+    cs_deselect();
+    return PICO_OK;
+}
+
+static int nor_program(uint32_t offset, const void *src, size_t len) {
+    if (offset % NOR_PAGE_SIZE || len % NOR_PAGE_SIZE || offset + len > nor_bytes) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    nor_wake();
+    const uint8_t *p = src;
+    for (size_t done = 0; done < len; done += NOR_PAGE_SIZE) {
+        nor_cmd(NOR_CMD_WRITE_ENABLE);
+        cs_select();
+        nor_cmd_addr(NOR_CMD_PAGE_PROGRAM, offset + done);
+        spi_write_blocking(STORAGE_NOR_SPI, p + done, NOR_PAGE_SIZE);
+        cs_deselect();
+        nor_wait_ready();
+    }
+    return PICO_OK;
+}
+
+// 64KB 境界に揃った部分はブロック消去でまとめて消す
+static int nor_erase(uint32_t offset, size_t len) {
+    if (offset % NOR_SECTOR_SIZE || len % NOR_SECTOR_SIZE || offset + len > nor_bytes) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    nor_wake();
+    uint32_t end = offset + (uint32_t)len;
+    while (offset < end) {
+        bool block = (offset % NOR_BLOCK_SIZE) == 0 && end - offset >= NOR_BLOCK_SIZE;
+        nor_cmd(NOR_CMD_WRITE_ENABLE);
+        cs_select();
+        nor_cmd_addr(block ? NOR_CMD_BLOCK_ERASE : NOR_CMD_SECTOR_ERASE, offset);
+        cs_deselect();
+        nor_wait_ready();
+        offset += block ? NOR_BLOCK_SIZE : NOR_SECTOR_SIZE;
+    }
+    return PICO_OK;
+}
+
+static int nor_sleep(void) {
+    if (!nor_bus_acquired) {
+        return PICO_OK;
+    }
+    if (!nor_powered_down) {
+        nor_cmd(NOR_CMD_POWER_DOWN);
+        nor_powered_down = true;
+    }
+    periph_release(nor_bus());
+    nor_bus_acquired = false;
+    return PICO_OK;
+}
+
+static uint32_t nor_size(void) {
+    return nor_bytes;
+}
+
+const storage_backend storage_spi_nor = {
+    .name = "spi_nor",
+    .init = nor_init,
+    .read = nor_read,
+    .program = nor_program,
+    .erase = nor_erase,
+    .sleep = nor_sleep,
+    .size = nor_size,
+    .page_size = NOR_PAGE_SIZE,
+    .erase_size = NOR_SECTOR_SIZE,
+};
@@ -0,0 +1,99 @@
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "hardware/structs/powman.h"
+#include "powman_scratch.h"
+#include "powman_example.h"
+#include "supervisor.h"
+
+// SCRATCH_FAULT のビット割り当て
+#define FAULT_COUNT_BITS 0x000000ffu    // 連続故障回数
+#define FAULT_CODE_LSB 8
+#define FAULT_CODE_BITS 0x00007f00u     // 最後の故障
+#define FAULT_REPORTED_BIT 0x00008000u  // ログ/送信済み
+#define FAULT_DETAIL_LSB 16             // 最後の故障の詳細 (int16)
+
+static inline uint32_t fault_word(void) {
+    return powman_hw->scratch[SCRATCH_FAULT];
+}
+
+bool supervisor_boot(void) {
+    if (watchdog_enable_caused_reboot()) {
+        supervisor_fault_record(FAULT_WATCHDOG, 0);
+    } else if (!watchdog_caused_reboot()) {
+        // powman による起床 = 前のサイクルは正常に電源断まで進んだ
+        powman_hw->scratch[SCRATCH_FAULT] = fault_word() & ~FAULT_COUNT_BITS;
+    }
+    // セーフモードで正常に眠れれば次の起床で回数が 0 に戻り、通常動作を再試行する
+    return (fault_word() & FAULT_COUNT_BITS) >= SUPERVISOR_SAFE_MODE_FAULTS;
+}
+
+void supervisor_start(void) {
+    watchdog_enable(SUPERVISOR_TIMEOUT_MS, true);
+}
+
+void supervisor_feed(void) {
+    watchdog_update();
+}
+
+void supervisor_sleep_ms(uint32_t ms) {
+    const uint32_t step = SUPERVISOR_TIMEOUT_MS / 4u;
+    while (ms > 0) {
+        uint32_t n = ms < step ? ms : step;
+        sleep_ms(n);
+        ms -= n;
+        watchdog_update();
+    }
+}
+
+static void fault_set(uint32_t count, fault_code code, int detail) {
+    powman_hw->scratch[SCRATCH_FAULT] = count | (((uint32_t)code << FAULT_CODE_LSB) & FAULT_CODE_BITS) |
+                                        ((uint32_t)(uint16_t)(int16_t)detail << FAULT_DETAIL_LSB);
+}
+
+void supervisor_fault_record(fault_code code, int detail) {
+    uint32_t count = fault_word() & FAULT_COUNT_BITS;
+    fault_set(count < FAULT_COUNT_BITS ? count + 1u : count, code, detail);
+}
+
+bool supervisor_fault_take(supervisor_fault *fault) {
+    uint32_t w = fault_word();
+    if ((w & FAULT_CODE_BITS) == 0 || (w & FAULT_REPORTED_BIT)) {
+        return false;
+    }
+    fault->tag = SUPERVISOR_FAULT_TAG;
+    fault->reserved = 0;
+    fault->code = (uint8_t)((w & FAULT_CODE_BITS) >> FAULT_CODE_LSB);
+    fault->consecutive = (uint8_t)(w & FAULT_COUNT_BITS);
+    fault->detail = (int16_t)(w >> FAULT_DETAIL_LSB);
+    powman_hw->scratch[SCRATCH_FAULT] = w | FAULT_REPORTED_BIT;
+    return true;
+}
+
+static uint64_t backoff_ms(uint32_t period_ms) {
+    uint32_t count = fault_word() & FAULT_COUNT_BITS;
+    uint64_t ms = period_ms;
+    while (count-- > 1 && ms < SUPERVISOR_BACKOFF_MAX_MS) {
+        ms <<= 1;
+    }
+    return ms < SUPERVISOR_BACKOFF_MAX_MS ? ms : SUPERVISOR_BACKOFF_MAX_MS;
+}
+
+void supervisor_off_failed(int rc, uint32_t period_ms) {
+    supervisor_fault_record(FAULT_OFF_RETURNED, rc);
+    uint64_t ms = backoff_ms(period_ms);
+
+    // 48MHz で回り続けると数日で電池がなくなるので、電源を入れたままでもクロックを止めて待つ
+    watchdog_disable();
+    int drc = powman_example_dormant_for_ms(ms);
+    if (drc != PICO_OK) {
+        // 同じ故障の続きなので回数は増やさず、中身だけ置き換える
+        fault_set(fault_word() & FAULT_COUNT_BITS, FAULT_DORMANT_FAILED, drc);
+        sleep_ms((uint32_t)ms);
+    }
+
+    // クロック設定を元に戻すため再起動して次のサイクルに任せる (続けばセーフモード)
+    watchdog_reboot(0, 0, 0);
+    while (true) {
+        __wfi();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ウォッチドッグによる起床サイクルの監視と故障記録。
+// 故障は powman スクラッチ (電源断でも保持) に残し、ログが開けた後で記録・送信する。
+// 連続して故障したら次の起動はセーフモード (周辺機器に触らず長めに眠るだけ) にする。
+
+typedef enum {
+    FAULT_NONE = 0,
+    FAULT_WATCHDOG = 1,     // 起床中に固まってウォッチドッグでリセットされた
+    FAULT_OFF_RETURNED = 2, // 電源断から戻ってきた (detail は戻り値)
+    FAULT_DORMANT_FAILED = 3, // 代わりの DORMANT にも入れなかった (detail は戻り値)
+} fault_code;
+
+// ログ・テレメトリにはこのまま書く (先頭の tag でウェイク回数などの記録と区別する)
+#define SUPERVISOR_FAULT_TAG 0x46u // 'F'
+
+typedef struct {
+    uint8_t tag;
+    uint8_t code;        // fault_code
+    uint8_t consecutive; // 正常なサイクルを挟まずに続いた回数
+    uint8_t reserved;
+    int32_t detail;
+} supervisor_fault;
+
+#ifndef SUPERVISOR_TIMEOUT_MS
+#define SUPERVISOR_TIMEOUT_MS 8000u
+#endif
+// この回数続けて故障したらセーフモードで眠ってから通常動作を再試行する
+#ifndef SUPERVISOR_SAFE_MODE_FAULTS
+#define SUPERVISOR_SAFE_MODE_FAULTS 3u
+#endif
+#ifndef SUPERVISOR_SAFE_MODE_SLEEP_MS
+#define SUPERVISOR_SAFE_MODE_SLEEP_MS (60u * 60u * 1000u)
+#endif
+// 電源断の失敗が続いたときの DORMANT の最長時間 (失敗ごとに倍にする)
+#ifndef SUPERVISOR_BACKOFF_MAX_MS
+#define SUPERVISOR_BACKOFF_MAX_MS (6u * 60u * 60u * 1000u)
+#endif
+
+// 起動直後に呼ぶ。ウォッチドッグリセットなら故障として記録し、電源断からの起床なら連続故障回数を
+// 0 に戻す。セーフモードで起動すべきなら true
+bool supervisor_boot(void);
+// ウォッチドッグを開始する / 餌をやる
+void supervisor_start(void);
+void supervisor_feed(void);
+// 餌をやりながら眠る
+void supervisor_sleep_ms(uint32_t ms);
+// 故障をスクラッチに記録する
+void supervisor_fault_record(fault_code code, int detail);
+// 未報告の故障があれば取り出して報告済みにする
+bool supervisor_fault_take(supervisor_fault *fault);
+// 電源断 (P1.7) が rc で戻ってきたときの回復 (戻らない)。
+// rc を記録し (次の起床でログとテレメトリに出る)、代わりに DORMANT で period_ms × 2^(連続故障-1)
+// 眠ってから再起動する。DORMANT にも入れなければクロックゲートの WFE で同じ時間待つ。
+__attribute__((noreturn)) void supervisor_off_failed(int rc, uint32_t period_ms);
+
+#endif
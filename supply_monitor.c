@@ -0,0 +1,64 @@
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/gpio.h"
+#include "hardware/structs/powman.h"
+#include "powman_example.h"
+#include "powman_scratch.h"
+#include "periph_power.h"
+#include "supply_monitor.h"
+
+#define ADC_SAMPLES 16u
+#define ADC_VREF_MV 3300u
+#define SUPPLY_LOW_FLAG 0x80000000u // SCRATCH_SUPPLY: 低電圧停止中
+
+// 毎回の起床で最初に通る変換ループは SRAM に置く。adc_select_input/adc_read はインライン展開される。
+// ADC の取得と初期化 (periph_acquire, adc_init, adc_gpio_init) は SDK のフラッシュ上の関数なので外で行う
+static uint32_t __not_in_flash_func(supply_adc_mv)(uint32_t input) {
+    adc_select_input(input);
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < ADC_SAMPLES; ++i) {
+        sum += adc_read();
+    }
+    return sum * ADC_VREF_MV * SUPPLY_ADC_DIVIDER / (ADC_SAMPLES * 4096u);
+}
+
+uint32_t supply_monitor_read_mv(void) {
+    periph_acquire(PERIPH_ADC);
+    adc_init();
+    adc_gpio_init(SUPPLY_ADC_PIN);
+    uint32_t mv = supply_adc_mv(SUPPLY_ADC_PIN - 26);
+    // 測り終えたら ADC は止めておく
+    periph_release(PERIPH_ADC);
+    return mv;
+}
+
+supply_state supply_monitor_check(supply_record *record) {
+    uint32_t mv = supply_monitor_read_mv();
+    bool was_low = (powman_hw->scratch[SCRATCH_SUPPLY] & SUPPLY_LOW_FLAG) != 0;
+    supply_state state;
+    if (was_low) {
+        state = mv >= SUPPLY_RESUME_MV ? SUPPLY_RECOVERED : SUPPLY_STILL_LOW;
+    } else {
+        state = mv < SUPPLY_LOW_MV ? SUPPLY_LOW : SUPPLY_OK;
+    }
+    bool low = state == SUPPLY_LOW || state == SUPPLY_STILL_LOW;
+    powman_hw->scratch[SCRATCH_SUPPLY] = (powman_hw->scratch[SCRATCH_SUPPLY] & LOG_HEAD_HINT_MASK) |
+                                         (low ? SUPPLY_LOW_FLAG : 0u) | (mv & SUPPLY_MV_MASK);
+
+    record->tag = SUPPLY_RECORD_TAG;
+    record->state = (uint8_t)state;
+    record->reserved = 0;
+    record->mv = mv;
+    return state;
+}
+
+int supply_monitor_off(void) {
+    gpio_init(SUPPLY_GOOD_PIN);
+    gpio_set_dir(SUPPLY_GOOD_PIN, GPIO_IN);
+    // 既に High なら GPIO では起きられない (すぐ起きてしまう) ので、時間で測り直す
+    if (gpio_get(SUPPLY_GOOD_PIN)) {
+        return powman_example_off_for_ms(SUPPLY_LOW_FALLBACK_MS);
+    }
+    uint64_t recheck_at = SUPPLY_LOW_RECHECK_MS ? powman_timer_get_ms() + SUPPLY_LOW_RECHECK_MS : 0;
+    return powman_example_off_until_gpio_level(SUPPLY_GOOD_PIN, true, recheck_at);
+}
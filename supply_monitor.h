@@ -0,0 +1,55 @@
+#ifndef SUPPLY_MONITOR_H
+#define SUPPLY_MONITOR_H
+
+#include <stdint.h>
+#include "board_pins.h"
+
+// 電源電圧の監視と低電圧停止。
+// 起床ごとに VSYS を測り、しきい値を下回ったら最後の状態を記録してログを閉じ、
+// 電源監視 IC の「電圧正常」出力 (SUPPLY_GOOD_PIN) だけで起きる P1.7 に入る。
+// 低電圧中に起きても、復帰電圧 (ヒステリシス付き) に戻るまではログに触らずにすぐ眠り直す。
+
+#ifndef SUPPLY_ADC_DIVIDER
+#define SUPPLY_ADC_DIVIDER 3u
+#endif
+#ifndef SUPPLY_LOW_MV
+#define SUPPLY_LOW_MV 3300u
+#endif
+#ifndef SUPPLY_RESUME_MV
+#define SUPPLY_RESUME_MV 3500u
+#endif
+// 電圧の入力ピン (SUPPLY_ADC_PIN, SUPPLY_GOOD_PIN) は board_pins.h
+// 0 以外なら GPIO に加えてこの間隔でも起きて測り直す (監視 IC がない基板向け)
+#ifndef SUPPLY_LOW_RECHECK_MS
+#define SUPPLY_LOW_RECHECK_MS 0u
+#endif
+// GPIO が既に High で待てないときの測り直し間隔
+#ifndef SUPPLY_LOW_FALLBACK_MS
+#define SUPPLY_LOW_FALLBACK_MS (60u * 60u * 1000u)
+#endif
+
+typedef enum {
+    SUPPLY_OK = 0,
+    SUPPLY_RECOVERED = 1, // 低電圧停止から復帰した
+    SUPPLY_LOW = 2,       // 今回しきい値を下回った (記録してから停止する)
+    SUPPLY_STILL_LOW = 3, // 低電圧停止中 (記録済みなので、すぐ停止する)
+} supply_state;
+
+// ログ・テレメトリに書く記録
+#define SUPPLY_RECORD_TAG 0x56u // 'V'
+
+typedef struct {
+    uint8_t tag;
+    uint8_t state; // supply_state
+    uint16_t reserved;
+    uint32_t mv;
+} supply_record;
+
+// VSYS を測って mV で返す
+uint32_t supply_monitor_read_mv(void);
+// 測定して状態を判定し、低電圧停止の状態 (スクラッチ) を更新する
+supply_state supply_monitor_check(supply_record *record);
+// 電圧が戻るまで P1.7 で眠る。成功すれば戻らない
+int supply_monitor_off(void);
+
+#endif
@@ -0,0 +1,416 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "telemetry_queue.h"
+
+// 退避領域は優先度ごとの領域 (セクタ単位) に分け、それぞれが 64 バイト固定長スロットの循環バッファ。
+// スロットは「データ → コミットマーク」の順に書き、送信済みになったら consumed ワードを
+// 0 に書き換える (消去不要)。セクタを再利用するときに未送信が残っていれば、それは捨てる
+// (同じ優先度の最古の項目なので、溢れても他の優先度は失われない)。
+// 起床ごとの初期化は領域全体を読まない: seq は書き込み順に増えるので最新のスロットを二分探索し、
+// そこから未送信のスロット (送信済みは古い方から順に付くので、最新側に続いている) だけを戻って読む。
+
+#define SLOT_MAGIC 0x5154u      // "TQ"
+#define COMMIT_MARK 0x54494d43u // "CMIT"
+#define SLOT_SIZE 64u
+#define SLOTS_PER_SECTOR (FLASH_SECTOR_SIZE / SLOT_SIZE)
+#define SPILL_SLOTS (TQ_SPILL_SECTORS * SLOTS_PER_SECTOR)
+
+typedef struct {
+    uint16_t magic;
+    uint8_t prio;
+    uint8_t len;
+    uint32_t seq;
+    uint64_t timestamp_ms;
+    uint8_t data[TQ_ITEM_MAX];
+    uint32_t commit;
+    uint32_t consumed;
+} spill_slot;
+
+_Static_assert(sizeof(spill_slot) == SLOT_SIZE, "spill slot must be 64 bytes");
+_Static_assert(TQ_SPILL_OFFSET % FLASH_SECTOR_SIZE == 0, "spill area must be sector aligned");
+
+// 優先度ごとの退避領域 (先頭スロットとスロット数)
+static const uint16_t region_first[TQ_PRIO_COUNT] = {
+    0,
+    TQ_SPILL_SECTORS_EVENT * SLOTS_PER_SECTOR,
+    (TQ_SPILL_SECTORS_EVENT + TQ_SPILL_SECTORS_HEALTH) * SLOTS_PER_SECTOR,
+    SPILL_SLOTS,
+};
+static const uint16_t region_slots[TQ_PRIO_COUNT] = {
+    TQ_SPILL_SECTORS_EVENT * SLOTS_PER_SECTOR,
+    TQ_SPILL_SECTORS_HEALTH * SLOTS_PER_SECTOR,
+    TQ_SPILL_SECTORS_SUMMARY * SLOTS_PER_SECTOR,
+    0,
+};
+
+// 退避しない優先度 / 昇格までの待ち時間 / 破棄までの期限
+static const bool prio_spill[TQ_PRIO_COUNT] = {true, true, true, false};
+static const uint64_t prio_age_ms[TQ_PRIO_COUNT] = {0, 6u * 3600u * 1000u, 24u * 3600u * 1000u, 3600u * 1000u};
+static const uint64_t prio_ttl_ms[TQ_PRIO_COUNT] = {
+    UINT64_MAX, 30ull * 24u * 3600u * 1000u, 14ull * 24u * 3600u * 1000u, 6u * 3600u * 1000u,
+};
+
+// 各 FIFO は単調増加のカウンタで管理する: [head, pop) が仮取り出し中, [pop, tail) が待ち
+typedef struct {
+    tq_item items[TQ_RAM_SLOTS];
+    uint32_t head, pop, tail;
+} ram_fifo;
+
+typedef struct {
+    uint16_t slots[SPILL_SLOTS];
+    uint32_t head, pop, tail;
+} spill_fifo;
+
+static ram_fifo ram[TQ_PRIO_COUNT];
+static spill_fifo spill[TQ_PRIO_COUNT];
+static tq_stats stats[TQ_PRIO_COUNT];
+static uint32_t expired[TQ_PRIO_COUNT]; // 仮取り出しのうち期限切れで送らなかった数 (commit で dropped に数える)
+static uint32_t write_slot[TQ_PRIO_COUNT]; // 優先度ごとの次に書くスロット
+static uint32_t next_seq;
+static int last_prio = -1;  // unpop 用
+static bool last_from_spill;
+
+// 領域内で次のスロット
+static inline uint32_t region_next(int prio, uint32_t idx) {
+    return idx + 1u == (uint32_t)region_first[prio] + region_slots[prio] ? region_first[prio] : idx + 1u;
+}
+
+static inline uint32_t region_prev(int prio, uint32_t idx) {
+    return idx == region_first[prio] ? (uint32_t)region_first[prio] + region_slots[prio] - 1u : idx - 1u;
+}
+
+static inline const spill_slot *slot_ptr(uint32_t idx) {
+    return (const spill_slot *)(STORAGE_XIP_BASE + TQ_SPILL_OFFSET + idx * SLOT_SIZE);
+}
+
+static bool slot_erased(uint32_t idx) {
+    const uint32_t *p = (const uint32_t *)slot_ptr(idx);
+    for (uint32_t i = 0; i < SLOT_SIZE / 4u; ++i) {
+        if (p[i] != 0xffffffffu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// スロットを含むページを、そのスロット以外 0xff にしてプログラムする
+static void program_slot_bytes(uint32_t idx, uint32_t offset, const void *src, size_t len) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t addr = idx * SLOT_SIZE + offset;
+    uint32_t base = addr & ~(FLASH_PAGE_SIZE - 1u);
+    memset(page, 0xff, sizeof(page));
+    memcpy(page + (addr - base), src, len);
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(TQ_SPILL_OFFSET + base, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+}
+
+static bool slot_committed(const spill_slot *s, int prio) {
+    return s->magic == SLOT_MAGIC && s->commit == COMMIT_MARK && s->prio == prio;
+}
+
+// [i, end) で最初のコミット済みスロット。書きかけ (電源断) は飛ばし、消去済みに当たったら UINT32_MAX
+static uint32_t next_committed(int prio, uint32_t i, uint32_t end) {
+    for (; i < end; ++i) {
+        if (slot_committed(slot_ptr(i), prio)) {
+            return i;
+        }
+        if (slot_erased(i)) {
+            break;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// 領域内で最新の seq を持つスロット (なければ UINT32_MAX)。
+// 物理順に並べると [今の周: seq が増える][消去済み][前の周: seq が増える (今の周より小さい)] なので、
+// 先頭から最初のコミット済みスロットの seq 以上である最後のスロットを二分探索する
+static uint32_t find_newest(int prio) {
+    uint32_t end = (uint32_t)region_first[prio] + region_slots[prio];
+    uint32_t first = region_first[prio];
+    // 先頭のセクタを消去した直後 (まだ書いていない) なら、前の周の先頭まで進む
+    while (first < end && !slot_committed(slot_ptr(first), prio)) {
+        first++;
+    }
+    if (first == end) {
+        return UINT32_MAX;
+    }
+    uint32_t first_seq = slot_ptr(first)->seq;
+    uint32_t newest = first;
+    uint32_t lo = first + 1u;
+    uint32_t hi = end;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        uint32_t i = next_committed(prio, mid, hi);
+        if (i != UINT32_MAX && slot_ptr(i)->seq >= first_seq) {
+            newest = i;
+            lo = i + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    return newest;
+}
+
+int telemetry_queue_init(void) {
+    memset(ram, 0, sizeof(ram));
+    memset(spill, 0, sizeof(spill));
+    memset(stats, 0, sizeof(stats));
+    memset(expired, 0, sizeof(expired));
+    last_prio = -1;
+
+    uint32_t max_seq = 0;
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        if (region_slots[p] == 0) {
+            continue;
+        }
+        // 最新のスロットの次が書き込み位置
+        uint32_t newest = find_newest(p);
+        write_slot[p] = newest == UINT32_MAX ? region_first[p] : region_next(p, newest);
+        if (newest == UINT32_MAX) {
+            continue;
+        }
+        if (slot_ptr(newest)->seq > max_seq) {
+            max_seq = slot_ptr(newest)->seq;
+        }
+
+        // 最新から、送信済み・消去済みのスロットに当たるまで戻る (書きかけは飛ばす)
+        uint32_t oldest = UINT32_MAX;
+        uint32_t i = newest;
+        for (uint32_t n = 0; n < region_slots[p]; ++n, i = region_prev(p, i)) {
+            const spill_slot *s = slot_ptr(i);
+            if (slot_committed(s, p) ? s->consumed == 0 : slot_erased(i)) {
+                break;
+            }
+            oldest = i;
+        }
+        spill_fifo *f = &spill[p];
+        for (i = oldest; i != UINT32_MAX; i = region_next(p, i)) {
+            const spill_slot *s = slot_ptr(i);
+            if (slot_committed(s, p) && s->consumed != 0) {
+                f->slots[f->tail++ % SPILL_SLOTS] = (uint16_t)i;
+            }
+            if (i == newest) {
+                break;
+            }
+        }
+        f->pop = f->head;
+    }
+    next_seq = max_seq + 1u;
+    return PICO_OK;
+}
+
+// セクタを再利用する前に消去し、そこに残っていた未送信項目 (その優先度の最古のもの) を捨てる
+static void reclaim_sector(int prio, uint32_t sector) {
+    uint32_t first = sector * SLOTS_PER_SECTOR;
+    spill_fifo *f = &spill[prio];
+    while (f->head != f->tail) {
+        uint32_t idx = f->slots[f->head % SPILL_SLOTS];
+        if (idx < first || idx >= first + SLOTS_PER_SECTOR) {
+            break;
+        }
+        f->head++;
+        stats[prio].dropped++;
+    }
+    if ((int32_t)(f->pop - f->head) < 0) {
+        f->pop = f->head;
+        expired[prio] = 0;
+    }
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(TQ_SPILL_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+}
+
+static int spill_item(const tq_item *item) {
+    int prio = item->prio;
+    uint32_t *w = &write_slot[prio];
+    // 書きかけ (電源断) のスロットは消去するまで使えないので飛ばす
+    for (uint32_t tries = 0;; ++tries) {
+        if (tries > region_slots[prio]) {
+            return PICO_ERROR_INSUFFICIENT_RESOURCES;
+        }
+        if (*w % SLOTS_PER_SECTOR == 0) {
+            bool erased = true;
+            for (uint32_t i = 0; i < SLOTS_PER_SECTOR && erased; ++i) {
+                erased = slot_erased(*w + i);
+            }
+            if (!erased) {
+                reclaim_sector(prio, *w / SLOTS_PER_SECTOR);
+            }
+        }
+        if (slot_erased(*w)) {
+            break;
+        }
+        *w = region_next(prio, *w);
+    }
+
+    spill_slot s;
+    memset(&s, 0xff, sizeof(s));
+    s.magic = SLOT_MAGIC;
+    s.prio = item->prio;
+    s.len = item->len;
+    s.seq = next_seq++;
+    s.timestamp_ms = item->timestamp_ms;
+    memcpy(s.data, item->data, item->len);
+    program_slot_bytes(*w, 0, &s, sizeof(s));
+    const uint32_t mark = COMMIT_MARK;
+    program_slot_bytes(*w, offsetof(spill_slot, commit), &mark, sizeof(mark));
+
+    spill_fifo *f = &spill[prio];
+    f->slots[f->tail++ % SPILL_SLOTS] = (uint16_t)*w;
+    stats[prio].spilled++;
+    *w = region_next(prio, *w);
+    return PICO_OK;
+}
+
+int telemetry_queue_push(tq_priority prio, uint64_t timestamp_ms, const void *data, size_t len) {
+    if (prio >= TQ_PRIO_COUNT || len > TQ_ITEM_MAX) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    ram_fifo *r = &ram[prio];
+    if (r->tail - r->head == TQ_RAM_SLOTS) {
+        // 仮取り出し中の項目は動かせない
+        if (r->pop != r->head) {
+            return PICO_ERROR_RESOURCE_IN_USE;
+        }
+        tq_item *oldest = &r->items[r->head % TQ_RAM_SLOTS];
+        if (prio_spill[prio]) {
+            int rc = spill_item(oldest);
+            if (rc != PICO_OK) {
+                return rc;
+            }
+        } else {
+            stats[prio].dropped++;
+        }
+        r->head++;
+        r->pop = r->head;
+    }
+    tq_item *item = &r->items[r->tail % TQ_RAM_SLOTS];
+    item->timestamp_ms = timestamp_ms;
+    item->prio = (uint8_t)prio;
+    item->len = (uint8_t)len;
+    memcpy(item->data, data, len);
+    r->tail++;
+    stats[prio].enqueued++;
+    return PICO_OK;
+}
+
+bool telemetry_queue_pending(tq_priority prio) {
+    return spill[prio].pop != spill[prio].tail || ram[prio].pop != ram[prio].tail;
+}
+
+// 優先度 prio の次の項目の時刻 (退避分が RAM 分より常に古い)
+static uint64_t head_timestamp(int prio) {
+    if (spill[prio].pop != spill[prio].tail) {
+        return slot_ptr(spill[prio].slots[spill[prio].pop % SPILL_SLOTS])->timestamp_ms;
+    }
+    return ram[prio].items[ram[prio].pop % TQ_RAM_SLOTS].timestamp_ms;
+}
+
+int telemetry_queue_pop(uint64_t now_ms, tq_item *item) {
+    for (;;) {
+        // 待ち時間が昇格しきい値を超えた項目は1段上の優先度として扱う
+        int best = -1;
+        int best_rank = TQ_PRIO_COUNT;
+        for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+            if (!telemetry_queue_pending((tq_priority)p)) {
+                continue;
+            }
+            uint64_t ts = head_timestamp(p);
+            int rank = p;
+            if (p > 0 && now_ms > ts && now_ms - ts > prio_age_ms[p]) {
+                rank = p - 1;
+            }
+            if (rank < best_rank) {
+                best = p;
+                best_rank = rank;
+            }
+        }
+        if (best < 0) {
+            last_prio = -1;
+            return PICO_ERROR_NO_DATA;
+        }
+
+        last_prio = best;
+        last_from_spill = spill[best].pop != spill[best].tail;
+        if (last_from_spill) {
+            const spill_slot *s = slot_ptr(spill[best].slots[spill[best].pop++ % SPILL_SLOTS]);
+            item->timestamp_ms = s->timestamp_ms;
+            item->prio = s->prio;
+            item->len = s->len <= TQ_ITEM_MAX ? s->len : TQ_ITEM_MAX;
+            memcpy(item->data, s->data, item->len);
+        } else {
+            *item = ram[best].items[ram[best].pop++ % TQ_RAM_SLOTS];
+        }
+        // 期限切れは送らずに捨てる (commit で確定)
+        if (now_ms > item->timestamp_ms && now_ms - item->timestamp_ms > prio_ttl_ms[best]) {
+            expired[best]++;
+            continue;
+        }
+        return PICO_OK;
+    }
+}
+
+void telemetry_queue_unpop(void) {
+    if (last_prio < 0) {
+        return;
+    }
+    if (last_from_spill) {
+        spill[last_prio].pop--;
+    } else {
+        ram[last_prio].pop--;
+    }
+    last_prio = -1;
+}
+
+int telemetry_queue_commit(void) {
+    const uint32_t consumed = 0;
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        spill_fifo *f = &spill[p];
+        uint32_t n = f->pop - f->head;
+        for (; f->head != f->pop; f->head++) {
+            program_slot_bytes(f->slots[f->head % SPILL_SLOTS], offsetof(spill_slot, consumed), &consumed, sizeof(consumed));
+        }
+        n += ram[p].pop - ram[p].head;
+        ram[p].head = ram[p].pop;
+        stats[p].sent += n - expired[p];
+        stats[p].dropped += expired[p];
+        expired[p] = 0;
+    }
+    last_prio = -1;
+    return PICO_OK;
+}
+
+void telemetry_queue_rollback(void) {
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        spill[p].pop = spill[p].head;
+        ram[p].pop = ram[p].head;
+        expired[p] = 0;
+    }
+    last_prio = -1;
+}
+
+int telemetry_queue_sleep(void) {
+    telemetry_queue_rollback();
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        ram_fifo *r = &ram[p];
+        for (; r->head != r->tail; r->head++) {
+            if (!prio_spill[p]) {
+                stats[p].dropped++;
+                continue;
+            }
+            int rc = spill_item(&r->items[r->head % TQ_RAM_SLOTS]);
+            if (rc != PICO_OK) {
+                return rc;
+            }
+        }
+        r->pop = r->head;
+    }
+    return PICO_OK;
+}
+
+void telemetry_queue_get_stats(tq_priority prio, tq_stats *out) {
+    *out = stats[prio];
+}
@@ -0,0 +1,74 @@
+#ifndef TELEMETRY_QUEUE_H
+#define TELEMETRY_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config_store.h"
+
+// 送信待ちテレメトリの優先度付きキュー (RAM + 内蔵フラッシュへの退避)。
+// 優先度ごとの FIFO を持ち、取り出しは常に最も優先度の高いものから (待ち時間が長い
+// ものは1段昇格)。RAM が一杯になるとその優先度の最古の項目をフラッシュへ退避する。
+// 退避領域は優先度ごとに分けてあり、溢れたときに捨てるのは同じ優先度の最古の項目だけ
+// (毎回積む状態情報が、期限なしの警報イベントを追い出さない)。
+// 取り出しは仮取り出し → commit/rollback の2段階で、送信失敗時は順序ごと元に戻せる。
+
+typedef enum {
+    TQ_PRIO_EVENT = 0,   // 警報イベント
+    TQ_PRIO_HEALTH = 1,  // 電池電圧・故障などの状態
+    TQ_PRIO_SUMMARY = 2, // 定期要約
+    TQ_PRIO_RAW = 3,     // 生データ (退避せず、溢れたら古いものから捨てる)
+    TQ_PRIO_COUNT
+} tq_priority;
+
+#define TQ_ITEM_MAX 40u
+#ifndef TQ_RAM_SLOTS
+#define TQ_RAM_SLOTS 8u // 優先度ごとの RAM 上の項目数
+#endif
+
+// 退避領域 (内蔵フラッシュ、設定保存領域の直後)
+#ifndef TQ_SPILL_OFFSET
+#define TQ_SPILL_OFFSET (CONFIG_STORE_OFFSET + 2u * CONFIG_STORE_SLOT_SIZE)
+#endif
+// 優先度ごとのセクタ数 (RAW は退避しない)。1セクタ 64 項目
+#ifndef TQ_SPILL_SECTORS_EVENT
+#define TQ_SPILL_SECTORS_EVENT 4u
+#endif
+#ifndef TQ_SPILL_SECTORS_HEALTH
+#define TQ_SPILL_SECTORS_HEALTH 6u
+#endif
+#ifndef TQ_SPILL_SECTORS_SUMMARY
+#define TQ_SPILL_SECTORS_SUMMARY 6u
+#endif
+#define TQ_SPILL_SECTORS (TQ_SPILL_SECTORS_EVENT + TQ_SPILL_SECTORS_HEALTH + TQ_SPILL_SECTORS_SUMMARY)
+
+typedef struct {
+    uint64_t timestamp_ms;
+    uint8_t prio;
+    uint8_t len;
+    uint8_t data[TQ_ITEM_MAX];
+} tq_item;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t sent;    // 送信が commit された数 (期限切れで捨てたものは含まない)
+    uint32_t spilled; // フラッシュへ退避した数
+    uint32_t dropped; // 溢れ・期限切れで捨てた数
+} tq_stats;
+
+// フラッシュの退避領域から優先度ごとの FIFO を再構築する (読むのは二分探索と未送信のスロットだけ)
+int telemetry_queue_init(void);
+int telemetry_queue_push(tq_priority prio, uint64_t timestamp_ms, const void *data, size_t len);
+// 最も優先度の高い項目を仮に取り出す。空なら PICO_ERROR_NO_DATA
+int telemetry_queue_pop(uint64_t now_ms, tq_item *item);
+// 直前の pop を取り消す (フレームに入りきらなかった項目を戻す)
+void telemetry_queue_unpop(void);
+// 仮取り出しした項目を確定 (送信成功) / すべて戻す (送信失敗)
+int telemetry_queue_commit(void);
+void telemetry_queue_rollback(void);
+bool telemetry_queue_pending(tq_priority prio);
+// スリープ前に RAM 上の項目をフラッシュへ退避する (RAW は捨てる)
+int telemetry_queue_sleep(void);
+void telemetry_queue_get_stats(tq_priority prio, tq_stats *stats);
+
+#endif
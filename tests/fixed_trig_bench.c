@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "fixed_trig.h"
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#else
+#include <time.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// fixed_trig と libm (atan2 / atan2f / asinf) の1回あたりの時間を測る。
+// ホストでは tests/ の ctest から、実機では INCLINOMETER_FIXED_TRIG_BENCH=ON でビルドした
+// fixed_trig_bench.uf2 (48MHz、結果は UART0 に出す) で同じ表を出す。
+//   - 入力は加速度計の生値と同じ程度の大きさ (|v| ≈ 2^14) のベクトルを固定の乱数列で作る
+//   - libm には整数を float / double に変換して渡す (変換も tilt で必要になる分として時間に含める)
+//   - 各行は BENCH_RUNS 回測った最小値
+//   - tilt: ピッチとロール1組 (fixed は CORDIC 2回、libm は atan2f 2回と sqrtf)
+// 同じ入力で固定小数点の結果が段階の誤差に収まっていることも確かめる (時間の判定はしない)
+
+#define INPUTS 1024u
+#define BENCH_RUNS 5u
+#ifndef BENCH_REPS
+#if PICO_ON_DEVICE
+#define BENCH_REPS 8u // 8192 回 (48MHz で 1 行あたり数十 ms)
+#else
+#define BENCH_REPS 400u
+#endif
+#endif
+
+static int32_t in_x[INPUTS], in_y[INPUTS], in_z[INPUTS];
+static int32_t in_s[INPUTS], in_r[INPUTS]; // asin(s / r)、|s| <= r
+
+static const double tier_limit_deg[FIXED_TRIG_TIER_COUNT] = {0.1, 0.01, 0.001};
+static const char *tier_name[FIXED_TRIG_TIER_COUNT] = {"0.1", "0.01", "0.001"};
+
+static int failures;
+static volatile int32_t sink_i;
+static volatile float sink_f;
+static volatile double sink_d;
+
+static uint32_t rng = 12345u;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static void make_inputs(void) {
+    for (uint32_t i = 0; i < INPUTS; ++i) {
+        // 単位球上のほぼ一様な向き × 16384 (1g)
+        double th = 2.0 * M_PI * (next_rand() & 0xffffu) / 65536.0;
+        double cz = 2.0 * (next_rand() & 0xffffu) / 65536.0 - 1.0;
+        double sz = sqrt(1.0 - cz * cz);
+        in_x[i] = (int32_t)lrint(16384.0 * sz * cos(th));
+        in_y[i] = (int32_t)lrint(16384.0 * sz * sin(th));
+        in_z[i] = (int32_t)lrint(16384.0 * cz);
+        if (in_x[i] == 0 && in_y[i] == 0) {
+            in_x[i] = 1;
+        }
+        in_r[i] = 16000 + (int32_t)(next_rand() % 1000u);
+        in_s[i] = (int32_t)(next_rand() % (2u * (uint32_t)in_r[i] + 1u)) - in_r[i];
+    }
+}
+
+static uint64_t now_ns(void) {
+#if PICO_ON_DEVICE
+    return time_us_64() * 1000u;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+#endif
+}
+
+typedef enum {
+    OP_CORDIC,
+    OP_POLY,
+    OP_ASIN,
+    OP_TILT,
+    OP_ATAN2,
+    OP_ATAN2F,
+    OP_ASINF,
+    OP_TILT_F,
+} bench_op;
+
+// 全入力を1周する。switch は周の外なので、計るのは関数呼び出しと変換だけ
+static void pass(bench_op op, fixed_trig_tier tier) {
+    int32_t acc = 0;
+    float accf = 0;
+    double accd = 0;
+    switch (op) {
+    case OP_CORDIC:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            acc += fixed_atan2_cordic(in_y[i], in_x[i], tier);
+        }
+        break;
+    case OP_POLY:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            acc += fixed_atan2_poly(in_y[i], in_x[i], tier);
+        }
+        break;
+    case OP_ASIN:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            acc += fixed_asin(in_s[i], in_r[i], tier);
+        }
+        break;
+    case OP_TILT:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            uint32_t h_q8;
+            acc += fixed_atan2_hypot(in_y[i], in_z[i], tier, &h_q8);
+            acc += fixed_atan2_cordic(-in_x[i] * 256, (int32_t)h_q8, tier);
+        }
+        break;
+    case OP_ATAN2:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            accd += atan2((double)in_y[i], (double)in_x[i]);
+        }
+        break;
+    case OP_ATAN2F:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            accf += atan2f((float)in_y[i], (float)in_x[i]);
+        }
+        break;
+    case OP_ASINF:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            accf += asinf((float)in_s[i] / (float)in_r[i]);
+        }
+        break;
+    case OP_TILT_F:
+        for (uint32_t i = 0; i < INPUTS; ++i) {
+            float y = (float)in_y[i], z = (float)in_z[i];
+            accf += atan2f(y, z);
+            accf += atan2f(-(float)in_x[i], sqrtf(y * y + z * z));
+        }
+        break;
+    }
+    sink_i = acc;
+    sink_f = accf;
+    sink_d = accd;
+}
+
+// 1回あたりの時間 (ns)
+static double time_op(bench_op op, fixed_trig_tier tier) {
+    uint64_t best = UINT64_MAX;
+    for (uint32_t run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t a = now_ns();
+        for (uint32_t rep = 0; rep < BENCH_REPS; ++rep) {
+            pass(op, tier);
+        }
+        uint64_t d = now_ns() - a;
+        best = d < best ? d : best;
+    }
+    return (double)best / (INPUTS * BENCH_REPS);
+}
+
+static void row(const char *name, const char *tier, double ns) {
+#if PICO_ON_DEVICE
+    printf("%-8s %-6s %9.0f ns %7.0f cycles\n", name, tier, ns, ns * clock_get_hz(clk_sys) / 1e9);
+#else
+    printf("%-8s %-6s %9.1f ns\n", name, tier, ns);
+#endif
+}
+
+static double err_deg(int32_t got_mdeg, double want_rad) {
+    double e = fabs(got_mdeg / 1000.0 - want_rad * 180.0 / M_PI);
+    return e > 180.0 ? 360.0 - e : e;
+}
+
+// 測った入力で段階の誤差に収まっているか (最適化で結果を捨てていないことの確認も兼ねる)
+static void check_tier(fixed_trig_tier tier) {
+    double worst = 0;
+    for (uint32_t i = 0; i < INPUTS; ++i) {
+        double a = atan2(in_y[i], in_x[i]);
+        worst = fmax(worst, err_deg(fixed_atan2_cordic(in_y[i], in_x[i], tier), a));
+        worst = fmax(worst, err_deg(fixed_atan2_poly(in_y[i], in_x[i], tier), a));
+        worst = fmax(worst, err_deg(fixed_asin(in_s[i], in_r[i], tier), asin((double)in_s[i] / in_r[i])));
+    }
+    if (worst > tier_limit_deg[tier]) {
+        printf("FAIL tier %s: max error %.5f deg\n", tier_name[tier], worst);
+        failures++;
+    }
+}
+
+static void run(void) {
+    printf("fixed_trig_bench: %u inputs x %u reps, best of %u\n", INPUTS, BENCH_REPS, BENCH_RUNS);
+    for (int t = 0; t < FIXED_TRIG_TIER_COUNT; ++t) {
+        fixed_trig_tier tier = (fixed_trig_tier)t;
+        check_tier(tier);
+        row("cordic", tier_name[t], time_op(OP_CORDIC, tier));
+        row("poly", tier_name[t], time_op(OP_POLY, tier));
+        row("asin", tier_name[t], time_op(OP_ASIN, tier));
+        row("tilt", tier_name[t], time_op(OP_TILT, tier));
+    }
+    row("atan2", "double", time_op(OP_ATAN2, 0));
+    row("atan2f", "float", time_op(OP_ATAN2F, 0));
+    row("asinf", "float", time_op(OP_ASINF, 0));
+    row("tilt", "float", time_op(OP_TILT_F, 0));
+}
+
+int main(void) {
+#if PICO_ON_DEVICE
+    // 起床処理と同じ 48MHz (CLOCK_PROFILE_LOW) で測る。UART の設定はクロックを決めてから
+    set_sys_clock_48mhz();
+    stdio_init_all();
+    make_inputs();
+    while (true) {
+        run();
+        printf("%s\n", failures ? "FAIL" : "ok");
+        sleep_ms(5000);
+    }
+#else
+    make_inputs();
+    run();
+    if (failures == 0) {
+        printf("fixed_trig_bench: ok\n");
+    }
+    return failures ? 1 : 0;
+#endif
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "flash_log.h"
+#include "host_storage.h"
+
+// 16MB (4096 セクタ) のログで範囲検索を測る。
+// 一周以上書いて最古セクタが物理 0 でない状態にし、同じ時刻のレコードがセクタをまたぐ区間も作る。
+//   - 境界 (両端ちょうど・セクタをまたぐ同時刻・範囲外・最古/最新) と乱数の範囲で、結果を線形の参照と比べる
+//   - 最初のレコードまでのデバイス読み出し回数がログの大きさによらない (1〜2セクタの走査だけ) こと
+//   - find_range の時間が小さいログと比べて O(log n) で増えること
+//   - インデックスを間引いたビルド (FLASH_LOG_INDEX_ENTRIES < 4096) では、find_range が読むヘッダが
+//     境界ごとに log2(間隔) 個までであること (時間はヘッダの読み出しで決まるので比べない)
+// flash_log_bench [--sd]
+
+#define T0_MS 1704067200000ull
+#define PAYLOAD 16u      // 傾斜の記録と同じ大きさ
+#define COMMIT_EVERY 60u // 1回の起床で書く件数
+#define RUN_AT 400000u   // ここから RUN_LEN 件は同じ時刻 (一周後も残る位置)
+#define RUN_LEN 700u
+#define RANDOM_QUERIES 2000u
+#define TIMED_QUERIES 200000u
+
+powman_hw_t host_powman;
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+static uint32_t total;  // 書いた件数
+static uint32_t oldest; // 残っている最古の id
+
+// id i の時刻: 3件ずつ同じ時刻、RUN_AT からの RUN_LEN 件はすべて同じ時刻
+static uint64_t ts_of(uint32_t i) {
+    if (i >= RUN_AT && i < RUN_AT + RUN_LEN) {
+        i = RUN_AT;
+    }
+    return T0_MS + (uint64_t)(i / 3u) * 1000u;
+}
+
+static void fill(uint32_t records) {
+    uint8_t buf[PAYLOAD] = {0};
+    for (total = 0; total < records; ++total) {
+        memcpy(buf, &total, sizeof(total));
+        if (flash_log_append(ts_of(total), buf, sizeof(buf)) != PICO_OK) {
+            EXPECT(false, "append %u", total);
+            return;
+        }
+        if (total % COMMIT_EVERY == COMMIT_EVERY - 1u) {
+            flash_log_flush();
+        }
+    }
+    flash_log_flush();
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t first;
+    uint32_t last;
+    uint32_t reads_to_first; // find_range から最初のレコードまでのデバイス読み出し
+} result;
+
+static result query(uint64_t t1, uint64_t t2) {
+    result r = {0, UINT32_MAX, UINT32_MAX, 0};
+    host_storage_clear_stats();
+    flash_log_cursor cur, end;
+    if (flash_log_find_range(t1, t2, &cur, &end) != PICO_OK) {
+        return r;
+    }
+    uint8_t buf[PAYLOAD];
+    uint64_t ts;
+    size_t len;
+    while (flash_log_read(&cur, &end, &ts, buf, sizeof(buf), &len) == PICO_OK) {
+        if (ts < t1) {
+            continue;
+        }
+        if (ts > t2) {
+            break;
+        }
+        uint32_t id;
+        memcpy(&id, buf, sizeof(id));
+        if (r.count == 0) {
+            host_storage_stats st;
+            host_storage_get_stats(&st);
+            r.reads_to_first = st.reads;
+            r.first = id;
+        }
+        r.last = id;
+        r.count++;
+    }
+    return r;
+}
+
+// 残っているレコードを線形にたどった参照
+static result reference(uint64_t t1, uint64_t t2) {
+    result r = {0, UINT32_MAX, UINT32_MAX, 0};
+    for (uint32_t i = oldest; i < total; ++i) {
+        if (ts_of(i) >= t1 && ts_of(i) <= t2) {
+            if (r.count == 0) {
+                r.first = i;
+            }
+            r.last = i;
+            r.count++;
+        }
+    }
+    return r;
+}
+
+static uint32_t max_reads_to_first;
+
+static void check(const char *name, uint64_t t1, uint64_t t2) {
+    result got = query(t1, t2);
+    result want = reference(t1, t2);
+    EXPECT(got.count == want.count && got.first == want.first && got.last == want.last,
+           "%s [%llu, %llu]: %u records %u..%u, want %u records %u..%u", name, (unsigned long long)(t1 - T0_MS),
+           (unsigned long long)(t2 - T0_MS), got.count, got.first, got.last, want.count, want.first, want.last);
+    if (got.reads_to_first > max_reads_to_first) {
+        max_reads_to_first = got.reads_to_first;
+    }
+}
+
+static uint32_t rng = 12345u;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static uint32_t find_range_reads; // find_range 1回で読んだヘッダの最大数
+
+// find_range 1回の平均時間 (ns)
+static double time_find_range(void) {
+    flash_log_cursor cur, end;
+    uint64_t span = ts_of(total - 1u) - ts_of(oldest);
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (uint32_t q = 0; q < TIMED_QUERIES; ++q) {
+        uint64_t t = ts_of(oldest) + (uint64_t)next_rand() * 1000u % (span + 1u);
+        flash_log_find_range(t, t + 60000u, &cur, &end);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    find_range_reads = 0;
+    for (uint32_t q = 0; q < RANDOM_QUERIES; ++q) {
+        uint64_t t = ts_of(oldest) + (uint64_t)next_rand() * 1000u % (span + 1u);
+        host_storage_stats st;
+        host_storage_clear_stats();
+        flash_log_find_range(t, t + 60000u, &cur, &end);
+        host_storage_get_stats(&st);
+        find_range_reads = st.reads > find_range_reads ? st.reads : find_range_reads;
+    }
+    return ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / TIMED_QUERIES;
+}
+
+// 容量 sectors のログを 1.25 周分埋めて、find_range の時間と最初のレコードまでの読み出しを測る
+static double run(const storage_backend *dev, uint32_t sectors, bool boundaries) {
+    host_storage_reset(sectors * FLASH_LOG_SECTOR_SIZE);
+    memset(&host_powman, 0, sizeof(host_powman));
+    EXPECT(flash_log_init(dev) == PICO_OK, "init");
+    // 1セクタに入る件数の見積もり (ページ境界への詰め物を含めて少なめ)
+    uint32_t per_sector = (FLASH_LOG_SECTOR_SIZE - 64u) / (16u + PAYLOAD) * 9u / 10u;
+    fill(sectors * per_sector * 5u / 4u);
+    // 電源を入れ直して (手がかりなしで) 開き直し、インデックスを作らせる
+    memset(&host_powman, 0, sizeof(host_powman));
+    host_storage_power_cycle();
+    EXPECT(flash_log_init(dev) == PICO_OK, "reinit");
+    EXPECT(flash_log_sector_count() == sectors, "%u of %u sectors in use", flash_log_sector_count(), sectors);
+
+    // 最古の id を探す (全範囲の最初)
+    oldest = 0;
+    result all = query(0, UINT64_MAX);
+    oldest = all.first;
+    EXPECT(oldest > 0 && all.last == total - 1u && all.count == total - oldest, "%u records, %u..%u of %u",
+           all.count, all.first, all.last, total);
+
+    max_reads_to_first = 0;
+    if (boundaries) {
+        uint64_t first_ts = ts_of(oldest);
+        uint64_t last_ts = ts_of(total - 1u);
+        check("run", ts_of(RUN_AT), ts_of(RUN_AT));
+        check("run end", ts_of(RUN_AT), ts_of(RUN_AT) + 1000u);
+        check("before run", ts_of(RUN_AT) - 1000u, ts_of(RUN_AT) - 1u);
+        check("oldest", first_ts, first_ts);
+        check("newest", last_ts, last_ts);
+        check("all", first_ts, last_ts);
+        check("before oldest", 0, first_ts - 1u);
+        check("overlap oldest", first_ts - 5000u, first_ts + 5000u);
+        check("after newest", last_ts + 1u, UINT64_MAX);
+        check("overlap newest", last_ts - 5000u, last_ts + 5000u);
+        check("between", ts_of(oldest + 3000u) + 1u, ts_of(oldest + 3000u) + 999u);
+        for (uint32_t q = 0; q < RANDOM_QUERIES; ++q) {
+            uint32_t i = oldest + next_rand() % (total - oldest);
+            uint64_t t1 = ts_of(i) + (next_rand() % 3u == 0 ? 500u : 0u);
+            uint64_t t2 = t1 + (uint64_t)(next_rand() % 4u) * (next_rand() % 300000u);
+            check("random", t1, t2);
+        }
+    }
+    double ns = time_find_range();
+    printf("%s: %u sectors, %u records: find_range %.0f ns (up to %u header reads), up to %u device reads to the "
+           "first record\n",
+           dev->name, sectors, total - oldest, ns, find_range_reads, max_reads_to_first);
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    const storage_backend *dev = argc > 1 && strcmp(argv[1], "--sd") == 0 ? &host_storage_sd : &host_storage_nor;
+    double small = run(dev, 64, false);
+    double large = run(dev, 4096u, true);
+    uint32_t stride = 4096u / FLASH_LOG_INDEX_ENTRIES;
+    if (stride <= 1u) {
+        // 64 → 4096 セクタで二分探索の段数は 6 → 12。線形探索なら 64 倍になる
+        EXPECT(large < small * 8.0, "find_range %.0f ns at %u sectors vs %.0f ns at 64", large, 4096u, small);
+        EXPECT(find_range_reads == 0, "find_range read %u headers", find_range_reads);
+    } else {
+        // 区間の両端と時刻の両端の4つの境界
+        uint32_t log2_stride = 0;
+        while ((1u << log2_stride) < stride) {
+            log2_stride++;
+        }
+        EXPECT(find_range_reads <= 4u * log2_stride, "find_range read %u headers with %u sectors per index entry",
+               find_range_reads, stride);
+    }
+    // 最初のレコードまでに読むのは、境界のセクタとその前のセクタのレコードヘッダ (と SD のペイロード) だけ
+    uint32_t per_sector_reads = 2u * FLASH_LOG_SECTOR_SIZE / (16u + PAYLOAD);
+    EXPECT(max_reads_to_first <= 2u * per_sector_reads, "%u device reads before the first record",
+           max_reads_to_first);
+    if (failures == 0) {
+        printf("flash_log_bench: ok\n");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+#ifndef HOST_HARDWARE_ADC_H
+#define HOST_HARDWARE_ADC_H
+
+// ホストテスト用: ADC は使わない (測定値はテストが直接与える)
+
+#include "pico/stdlib.h"
+
+static inline void adc_init(void) {
+}
+
+static inline void adc_gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+static inline void adc_select_input(uint input) {
+    (void)input;
+}
+
+static inline uint16_t adc_read(void) {
+    return 0;
+}
+
+#endif
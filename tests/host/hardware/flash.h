@@ -0,0 +1,20 @@
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+// ホストテスト用: 内蔵フラッシュは host_flash.c の配列 (消去で 0xff、書き込みは AND)
+
+#include "pico/stdlib.h"
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+// 電源断の模擬: これから bytes バイト書き換えたところで止まる (消去も先頭から1バイトずつ数える)。
+// 止まった消去は途中まで 0xff、残りは元の内容。以後の消去・書き込みは何もしない
+void host_flash_tear_after(uint32_t bytes);
+// 電源を入れ直す (止まった書き込みを解除する。内容はそのまま)
+void host_flash_power_cycle(void);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef HOST_HARDWARE_STRUCTS_POWMAN_H
+#define HOST_HARDWARE_STRUCTS_POWMAN_H
+
+// ホストテスト用: powman はスクラッチレジスタだけ (テストが host_powman を定義する)
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    uint32_t scratch[8];
+} powman_hw_t;
+
+extern powman_hw_t host_powman;
+#define powman_hw (&host_powman)
+
+#endif
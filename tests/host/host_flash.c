@@ -0,0 +1,47 @@
+#include <assert.h>
+#include <string.h>
+#include "hardware/flash.h"
+
+uint8_t host_flash[HOST_FLASH_SIZE];
+
+static int64_t tear_left = -1; // 電源断までの残りバイト数 (-1 = 無制限)
+
+// 次の1バイトを書き換えてよいか。0 になったら以後は何も書かない
+static bool step(void) {
+    if (tear_left == 0) {
+        return false;
+    }
+    if (tear_left > 0) {
+        tear_left--;
+    }
+    return true;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    assert(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0);
+    assert(flash_offs + count <= HOST_FLASH_SIZE);
+    for (size_t i = 0; i < count && step(); ++i) {
+        host_flash[flash_offs + i] = 0xff;
+    }
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    assert(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0);
+    assert(flash_offs + count <= HOST_FLASH_SIZE);
+    for (size_t i = 0; i < count && step(); ++i) {
+        host_flash[flash_offs + i] &= data[i];
+    }
+}
+
+void host_flash_tear_after(uint32_t bytes) {
+    tear_left = bytes;
+}
+
+void host_flash_power_cycle(void) {
+    tear_left = -1;
+}
+
+void host_flash_reset(void) {
+    memset(host_flash, 0xff, sizeof(host_flash));
+    host_flash_power_cycle();
+}
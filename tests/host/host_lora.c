@@ -0,0 +1,73 @@
+#include <assert.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "host_lora.h"
+
+static host_lora_frame frames[HOST_LORA_MAX_FRAMES];
+static uint32_t frame_count;
+static int init_rc;
+static int transmit_rc;
+static bool awake;
+
+void host_lora_reset(void) {
+    frame_count = 0;
+    init_rc = PICO_OK;
+    transmit_rc = PICO_OK;
+    awake = false;
+}
+
+void host_lora_fail_init(int rc) {
+    init_rc = rc;
+}
+
+void host_lora_fail_transmit(int rc) {
+    transmit_rc = rc;
+}
+
+uint32_t host_lora_frame_count(void) {
+    return frame_count;
+}
+
+const host_lora_frame *host_lora_frame_get(uint32_t i) {
+    assert(i < frame_count);
+    return &frames[i];
+}
+
+bool host_lora_asleep(void) {
+    return !awake;
+}
+
+int lora_radio_init(void) {
+    int rc = init_rc;
+    init_rc = PICO_OK;
+    awake = rc == PICO_OK;
+    return rc;
+}
+
+// 実機のドライバと同じ引数の検査をしてから、フレームを取っておく
+int lora_radio_transmit(uint32_t data_rate, const uint8_t *data, size_t len) {
+    if (data_rate >= LORA_DR_COUNT || len == 0 || len > lora_max_payload(data_rate)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (!awake) {
+        return PICO_ERROR_INVALID_STATE;
+    }
+    // 実機と同じく、送信のあとは成否によらずスリープに戻す
+    int rc = transmit_rc;
+    transmit_rc = PICO_OK;
+    awake = false;
+    if (rc != PICO_OK) {
+        return rc;
+    }
+    assert(frame_count < HOST_LORA_MAX_FRAMES);
+    host_lora_frame *f = &frames[frame_count++];
+    f->data_rate = data_rate;
+    f->len = len;
+    memcpy(f->data, data, len);
+    return PICO_OK;
+}
+
+int lora_radio_sleep(void) {
+    awake = false;
+    return PICO_OK;
+}
@@ -0,0 +1,30 @@
+#ifndef HOST_LORA_H
+#define HOST_LORA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "lora_radio.h"
+
+// ホストテスト用: 送ったフレームをそのまま取っておく LoRa 無線 (host_lora.c)。
+// 最大ペイロード長と送信時間は実機と同じ lora_airtime.c を使う
+
+#define HOST_LORA_MAX_FRAMES 4096u
+
+typedef struct {
+    uint32_t data_rate;
+    size_t len;
+    uint8_t data[256];
+} host_lora_frame;
+
+void host_lora_reset(void);
+// 次の lora_radio_init / lora_radio_transmit を rc で失敗させる
+void host_lora_fail_init(int rc);
+void host_lora_fail_transmit(int rc);
+
+uint32_t host_lora_frame_count(void);
+const host_lora_frame *host_lora_frame_get(uint32_t i);
+// 最後の呼び出しのあと無線がスリープしているか
+bool host_lora_asleep(void);
+
+#endif
@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "host_storage.h"
+
+#define NOR_PAGE_SIZE 256u
+#define SD_BLOCK_SIZE 512u
+#define ERASE_SIZE 4096u
+#define TORN_FILL 0xa5u // 書きかけの SD ブロックの中身
+
+static uint8_t *mem;
+static uint32_t mem_size;
+static int64_t tear_left = -1; // 残りのプログラム可能バイト数 (-1 = 無制限)
+static bool dead;
+static host_storage_stats stats;
+
+void host_storage_reset(uint32_t size) {
+    free(mem);
+    mem = malloc(size);
+    assert(mem != NULL);
+    mem_size = size;
+    memset(mem, 0xff, size);
+    host_storage_power_cycle();
+    host_storage_clear_stats();
+}
+
+void host_storage_tear_after(uint32_t bytes) {
+    tear_left = bytes;
+}
+
+void host_storage_power_cycle(void) {
+    tear_left = -1;
+    dead = false;
+}
+
+void host_storage_get_stats(host_storage_stats *out) {
+    *out = stats;
+}
+
+void host_storage_clear_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+static int storage_init(void) {
+    return PICO_OK;
+}
+
+static int storage_read(uint32_t offset, void *dst, size_t len) {
+    assert(offset + len <= mem_size);
+    stats.reads++;
+    memcpy(dst, mem + offset, len);
+    return PICO_OK;
+}
+
+static int program(bool nor, uint32_t offset, const uint8_t *src, size_t len) {
+    assert(offset % (nor ? NOR_PAGE_SIZE : SD_BLOCK_SIZE) == 0 && len % (nor ? NOR_PAGE_SIZE : SD_BLOCK_SIZE) == 0);
+    assert(offset + len <= mem_size);
+    if (dead) {
+        return PICO_ERROR_IO;
+    }
+    stats.programs++;
+    for (uint32_t i = 0; i < len; ++i) {
+        uint32_t at = offset + i;
+        if (tear_left == 0) {
+            dead = true;
+            if (!nor && at % SD_BLOCK_SIZE != 0) {
+                memset(mem + at - at % SD_BLOCK_SIZE, TORN_FILL, SD_BLOCK_SIZE);
+            }
+            return PICO_ERROR_IO;
+        }
+        if (tear_left > 0) {
+            tear_left--;
+        }
+        mem[at] = nor ? mem[at] & src[i] : src[i];
+    }
+    return PICO_OK;
+}
+
+static int nor_program(uint32_t offset, const void *src, size_t len) {
+    return program(true, offset, src, len);
+}
+
+static int sd_program(uint32_t offset, const void *src, size_t len) {
+    return program(false, offset, src, len);
+}
+
+static int storage_erase(uint32_t offset, size_t len) {
+    assert(offset % ERASE_SIZE == 0 && len % ERASE_SIZE == 0 && offset + len <= mem_size);
+    if (dead || tear_left == 0) {
+        dead = true;
+        return PICO_ERROR_IO;
+    }
+    stats.erases++;
+    memset(mem + offset, 0xff, len);
+    return PICO_OK;
+}
+
+static int storage_sleep(void) {
+    return PICO_OK;
+}
+
+static uint32_t storage_size(void) {
+    return mem_size;
+}
+
+const storage_backend host_storage_nor = {
+    .name = "nor",
+    .init = storage_init,
+    .read = storage_read,
+    .program = nor_program,
+    .erase = storage_erase,
+    .sleep = storage_sleep,
+    .size = storage_size,
+    .page_size = NOR_PAGE_SIZE,
+    .erase_size = ERASE_SIZE,
+};
+
+const storage_backend host_storage_sd = {
+    .name = "sd",
+    .init = storage_init,
+    .read = storage_read,
+    .program = sd_program,
+    .erase = storage_erase,
+    .sleep = storage_sleep,
+    .size = storage_size,
+    .page_size = SD_BLOCK_SIZE,
+    .erase_size = ERASE_SIZE,
+    .page_rewrite = true,
+};
@@ -0,0 +1,31 @@
+#ifndef HOST_STORAGE_H
+#define HOST_STORAGE_H
+
+#include <stdint.h>
+#include "storage.h"
+
+// ホストテスト用: RAM 上のストレージバックエンド (host_storage.c)
+//   host_storage_nor: 256B ページ・4KB 消去。プログラムは 1→0 のビットだけ (内蔵/外付け NOR と同じ)
+//   host_storage_sd:  512B ブロック・4KB 消去。プログラムはブロック全体の置き換え (SD と同じ)
+
+typedef struct {
+    uint32_t reads;    // read の呼び出し回数
+    uint32_t programs;
+    uint32_t erases;
+} host_storage_stats;
+
+extern const storage_backend host_storage_nor;
+extern const storage_backend host_storage_sd;
+
+// 容量を size バイトにして全体を消去状態にする
+void host_storage_reset(uint32_t size);
+// 電源断の模擬: これから bytes バイトをプログラムしたところで書き込みが止まる。
+// NOR は途中までのビットが書かれ、SD は書きかけのブロックの内容が壊れる。以後の program/erase は PICO_ERROR_IO
+void host_storage_tear_after(uint32_t bytes);
+// 電源を入れ直す (止まった書き込みを解除する。内容はそのまま)
+void host_storage_power_cycle(void);
+
+void host_storage_get_stats(host_storage_stats *stats);
+void host_storage_clear_stats(void);
+
+#endif
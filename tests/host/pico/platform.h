@@ -0,0 +1,6 @@
+#ifndef HOST_PICO_PLATFORM_H
+#define HOST_PICO_PLATFORM_H
+
+#include "pico/stdlib.h"
+
+#endif
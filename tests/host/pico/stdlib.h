@@ -0,0 +1,52 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// ホストテスト用の pico/stdlib.h の代わり。テスト対象のソースが使う定義だけを置く
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -2
+#define PICO_ERROR_NO_DATA -3
+#define PICO_ERROR_NOT_PERMITTED -4
+#define PICO_ERROR_INVALID_ARG -5
+#define PICO_ERROR_IO -6
+#define PICO_ERROR_INSUFFICIENT_RESOURCES -9
+#define PICO_ERROR_INVALID_ADDRESS -10
+#define PICO_ERROR_BAD_ALIGNMENT -11
+#define PICO_ERROR_INVALID_STATE -12
+#define PICO_ERROR_BUFFER_TOO_SMALL -13
+#define PICO_ERROR_INVALID_DATA -16
+#define PICO_ERROR_NOT_FOUND -17
+#define PICO_ERROR_RESOURCE_IN_USE -21
+
+#define __not_in_flash_func(f) f
+#define __no_inline_not_in_flash_func(f) __attribute__((noinline)) f
+#define __force_inline inline __attribute__((always_inline))
+#define __uninitialized_ram(x) x
+#define __weak __attribute__((weak))
+#define __unused __attribute__((unused))
+#define __packed __attribute__((packed))
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define tight_loop_contents() ((void)0)
+
+// 内蔵フラッシュ (4MB) は配列で置き換え、XIP の読み出しもそこを指す (host_flash.c)
+#define HOST_FLASH_SIZE (4u * 1024u * 1024u)
+extern uint8_t host_flash[];
+void host_flash_reset(void);
+#define STORAGE_XIP_BASE ((uintptr_t)host_flash)
+
+#endif
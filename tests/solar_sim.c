@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "periph_power.h"
+#include "solar_scheduler.h"
+
+// solar_scheduler_plan を日射量の時系列で1年分動かす電力収支のシミュレーター。
+// 起床ごとに電池電圧と発電電力を与えて計画を立て、その起床時間・休止時間のあいだの消費と
+// 発電 (時系列を積分) で電池残量を進める。1年 (約 200 万回の起床) が数秒で終わる。
+//   solar_sim [--dark] [--battery-mwh N] [--panel-mw N] [trace.txt]
+// trace.txt は1時間ごとの日射量 (W/m²) を1行に1つ (# 以降は無視)。8760 行に足りなければ繰り返す。
+// 省略時は北緯 35° の晴天モデルに決まった天気 (晴れ・曇り・雨) を掛けた合成値を使う。
+// --dark は 11 月末から 3 週間パネルがほぼ発電しない (積雪) 年にし、電池を小さくして予備の下限まで使わせる。
+// 計画が休止時間・標本化レートの範囲・予備の下限・満充電の規則を守り、電池が空にならないことを確かめる。
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define HOURS_PER_YEAR 8760u
+#define HOUR_MS 3600000ull
+#define T0_MS 1704067200000ull
+
+// 充電効率、電池電圧は残量に比例 (3.3V 空 .. 4.2V 満)
+#define CHARGE_EFFICIENCY 0.8
+#define BATTERY_EMPTY_MV 3300.0
+#define BATTERY_FULL_MV 4200.0
+
+powman_hw_t host_powman;
+
+int periph_acquire(periph_id id) {
+    (void)id;
+    return PICO_OK;
+}
+
+int periph_release(periph_id id) {
+    (void)id;
+    return PICO_OK;
+}
+
+static float irradiance[HOURS_PER_YEAR];
+static double panel_uw_per_wm2 = 250.0; // 1000 W/m² で 250mW のパネル
+
+// 晴天時の日射量 (W/m²)
+static double clear_sky(uint32_t hour) {
+    double day = hour / 24u;
+    double decl = 23.44 * M_PI / 180.0 * sin(2.0 * M_PI * (284.0 + day) / 365.0);
+    double lat = 35.0 * M_PI / 180.0;
+    double omega = (hour % 24u + 0.5 - 12.0) * 15.0 * M_PI / 180.0;
+    double cosz = sin(lat) * sin(decl) + cos(lat) * cos(decl) * cos(omega);
+    return cosz > 0.0 ? 1000.0 * pow(cosz, 1.15) : 0.0;
+}
+
+static void synthesize(bool dark) {
+    uint32_t seed = 12345u;
+    double weather = 1.0;
+    for (uint32_t h = 0; h < HOURS_PER_YEAR; ++h) {
+        if (h % 24u == 0) {
+            seed = seed * 1103515245u + 12345u;
+            uint32_t r = (seed >> 16) % 10u;
+            weather = r < 5u ? 1.0 : r < 8u ? 0.6 : 0.15; // 晴れ 5 割、曇り 3 割、雨 2 割
+            uint32_t day = h / 24u;
+            if (dark && day >= 330u && day < 351u) {
+                weather = 0.02;
+            }
+        }
+        irradiance[h] = (float)(clear_sky(h) * weather);
+    }
+}
+
+static int load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[128];
+    uint32_t n = 0;
+    while (n < HOURS_PER_YEAR && fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        char *end;
+        double v = strtod(line, &end);
+        if (end != line) {
+            irradiance[n++] = (float)fmax(v, 0.0);
+        }
+    }
+    fclose(f);
+    if (n == 0) {
+        fprintf(stderr, "%s: no samples\n", path);
+        return -1;
+    }
+    for (uint32_t i = n; i < HOURS_PER_YEAR; ++i) {
+        irradiance[i] = irradiance[i % n];
+    }
+    return 0;
+}
+
+static double irradiance_at(uint64_t t_ms) {
+    return irradiance[(t_ms / HOUR_MS) % HOURS_PER_YEAR];
+}
+
+// [t0, t1) に電池に入る電力量 (J)。時系列は1時間ごとに一定
+static double harvest_j(uint64_t t0, uint64_t t1) {
+    double j = 0.0;
+    while (t0 < t1) {
+        uint64_t next = (t0 / HOUR_MS + 1u) * HOUR_MS;
+        uint64_t end = next < t1 ? next : t1;
+        j += irradiance_at(t0) * panel_uw_per_wm2 * 1e-6 * (double)(end - t0) / 1000.0;
+        t0 = end;
+    }
+    return j * CHARGE_EFFICIENCY;
+}
+
+int main(int argc, char **argv) {
+    bool dark = false;
+    double battery_mwh = 3700.0; // 1Ah
+    const char *trace = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--dark") == 0) {
+            dark = true;
+            battery_mwh = 300.0;
+        } else if (strcmp(argv[i], "--battery-mwh") == 0 && i + 1 < argc) {
+            battery_mwh = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--panel-mw") == 0 && i + 1 < argc) {
+            panel_uw_per_wm2 = atof(argv[++i]);
+        } else {
+            trace = argv[i];
+        }
+    }
+    if (trace ? load_trace(trace) != 0 : (synthesize(dark), false)) {
+        return 2;
+    }
+
+    double capacity_j = battery_mwh * 3.6;
+    double energy_j = capacity_j * 0.7;
+    double min_soc = 1.0, harvested_j = 0.0, wasted_j = 0.0;
+    uint64_t reserve_ms = 0, full_ms = 0;
+    uint32_t wakes = 0, brownouts = 0, violations = 0;
+    bool recovered = false; // 予備の下限を割ったあと、また上に戻ったか
+    bool in_reserve = false;
+    uint32_t month_wakes[12] = {0};
+    double month_samples[12] = {0}; // 標本の数
+
+    uint64_t t = 0;
+    while (t < HOURS_PER_YEAR * HOUR_MS) {
+        double soc = energy_j / capacity_j;
+        uint32_t mv = (uint32_t)(BATTERY_EMPTY_MV + (BATTERY_FULL_MV - BATTERY_EMPTY_MV) * soc);
+        uint32_t harvest_uw = (uint32_t)(irradiance_at(t) * panel_uw_per_wm2 * CHARGE_EFFICIENCY);
+        energy_plan plan;
+        solar_scheduler_plan(T0_MS + t, mv, harvest_uw, &plan);
+
+        // 計画の規則: 休止時間・レートの範囲、予備の下限では最小動作、満充電では最大動作、
+        // レートを上げるのは休止時間が最短のときだけ
+        bool ok = plan.sleep_ms >= SOLAR_SLEEP_MIN_MS && plan.sleep_ms <= SOLAR_SLEEP_MAX_MS;
+        ok &= plan.sample_hz >= SOLAR_SAMPLE_MIN_HZ && plan.sample_hz <= SOLAR_SAMPLE_MAX_HZ;
+        ok &= plan.awake_uw == SOLAR_AWAKE_UW + (plan.sample_hz - SOLAR_SAMPLE_MIN_HZ) * SOLAR_SAMPLE_UW_PER_HZ;
+        if (mv <= SOLAR_RESERVE_MV) {
+            ok &= plan.awake_ms == SOLAR_AWAKE_RESERVE_MS && plan.sleep_ms == SOLAR_SLEEP_MAX_MS;
+            ok &= plan.sample_hz == SOLAR_SAMPLE_MIN_HZ;
+        } else {
+            ok &= plan.awake_ms == SOLAR_AWAKE_MS;
+        }
+        if (mv >= SOLAR_FULL_MV) {
+            ok &= plan.sleep_ms == SOLAR_SLEEP_MIN_MS && plan.sample_hz == SOLAR_SAMPLE_MAX_HZ;
+        }
+        if (plan.sample_hz > SOLAR_SAMPLE_MIN_HZ) {
+            ok &= plan.sleep_ms == SOLAR_SLEEP_MIN_MS;
+        }
+        if (!ok && violations++ < 10u) {
+            printf("FAIL plan at %.2f days: %u mV, %u uW -> awake %u ms at %u Hz, sleep %u ms\n",
+                   t / (24.0 * HOUR_MS), mv, harvest_uw, plan.awake_ms, plan.sample_hz, plan.sleep_ms);
+        }
+
+        uint64_t cycle = (uint64_t)plan.awake_ms + plan.sleep_ms;
+        double used_j = ((double)plan.awake_uw * plan.awake_ms + (double)SOLAR_SLEEP_UW * plan.sleep_ms) * 1e-9;
+        double in_j = harvest_j(t, t + cycle);
+        harvested_j += in_j;
+        energy_j += in_j - used_j;
+        if (energy_j > capacity_j) {
+            wasted_j += energy_j - capacity_j;
+            energy_j = capacity_j;
+        }
+        if (energy_j <= 0.0) {
+            brownouts++;
+            energy_j = 0.0;
+        }
+
+        if (mv <= SOLAR_RESERVE_MV) {
+            reserve_ms += cycle;
+            in_reserve = true;
+        } else if (in_reserve) {
+            recovered = true;
+            in_reserve = false;
+        }
+        if (mv >= SOLAR_FULL_MV) {
+            full_ms += cycle;
+        }
+        min_soc = fmin(min_soc, soc);
+        month_wakes[(t / HOUR_MS / 730u) % 12u]++;
+        month_samples[(t / HOUR_MS / 730u) % 12u] += (double)plan.sample_hz * plan.awake_ms / 1000.0;
+        wakes++;
+        t += cycle;
+    }
+
+    printf("%s, panel %.0f mW, battery %.0f mWh: %u wakes, harvest %.1f kJ (%.0f%% wasted when full)\n",
+           trace ? trace : dark ? "synthetic dark winter" : "synthetic", panel_uw_per_wm2, battery_mwh, wakes, harvested_j / 1000.0,
+           harvested_j > 0.0 ? 100.0 * wasted_j / harvested_j : 0.0);
+    printf("  battery min %.0f%%, end %.0f%%, %.1f days at the reserve floor, %.1f days full\n", 100.0 * min_soc,
+           100.0 * energy_j / capacity_j, reserve_ms / (24.0 * HOUR_MS), full_ms / (24.0 * HOUR_MS));
+    printf("  mean wake interval by month (s):");
+    for (int m = 0; m < 12; ++m) {
+        printf(" %.0f", month_wakes[m] ? 730.0 * 3600.0 / month_wakes[m] : 0.0);
+    }
+    printf("\n  samples per hour by month:");
+    for (int m = 0; m < 12; ++m) {
+        printf(" %.0f", month_samples[m] / 730.0);
+    }
+    printf("\n");
+
+    int failures = violations > 0;
+    if (brownouts) {
+        printf("FAIL battery ran empty %u times\n", brownouts);
+        failures++;
+    }
+    if (dark && (reserve_ms == 0 || !recovered)) {
+        printf("FAIL dark winter: reserve floor %s, recovered %s\n", reserve_ms ? "reached" : "not reached",
+               recovered ? "yes" : "no");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
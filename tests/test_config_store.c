@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "config_store.h"
+
+// 設定の保存: 保存のあらゆるバイト (スロットの消去・ヘッダとデータ・コミットマーク) で電源を落とす。
+// 電源を入れ直したあと読めるのは前回の設定か今回の設定のどちらかで、次の保存からは普通に続けられること。
+// 前回の設定なし・片方のスロットだけ・両方のスロットが使用済みのそれぞれで、長さを変えて試す
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+static uint8_t buf[CONFIG_STORE_MAX_LEN];
+
+// 世代 gen の設定: 長さも中身も世代ごとに違う
+static size_t make(uint32_t gen, size_t len) {
+    len -= gen % 3u;
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)(gen * 31u + i * 7u);
+    }
+    return len;
+}
+
+// 読み出した設定の世代 (0 = なし、-1 = 壊れている)
+static int loaded_gen(size_t len) {
+    static uint8_t got[CONFIG_STORE_MAX_LEN];
+    size_t n = 0;
+    int rc = config_store_load(got, sizeof(got), &n);
+    if (rc == PICO_ERROR_NO_DATA) {
+        return 0;
+    }
+    if (rc != PICO_OK || n == 0) {
+        return -1;
+    }
+    for (uint32_t gen = 1; gen < 16u; ++gen) {
+        if (make(gen, len) == n && memcmp(got, buf, n) == 0) {
+            return (int)gen;
+        }
+    }
+    return -1;
+}
+
+// 保存1回で書き換えるバイト数: スロットの消去、ヘッダとデータのページ、コミットマークのページ
+static uint32_t save_bytes(size_t len) {
+    size_t data = (24u + len + FLASH_PAGE_SIZE - 1u) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    return CONFIG_STORE_SLOT_SIZE + (uint32_t)data + FLASH_PAGE_SIZE;
+}
+
+static void sweep(size_t len, uint32_t prior) {
+    uint32_t bytes = save_bytes(len);
+    for (uint32_t tear = 0; tear <= bytes; ++tear) {
+        memset(host_flash + CONFIG_STORE_OFFSET, 0xff, 2u * CONFIG_STORE_SLOT_SIZE);
+        host_flash_power_cycle();
+        for (uint32_t gen = 1; gen <= prior; ++gen) {
+            config_store_save(buf, make(gen, len));
+        }
+        host_flash_tear_after(tear);
+        int rc = config_store_save(buf, make(prior + 1u, len));
+        host_flash_power_cycle();
+
+        int got = loaded_gen(len);
+        bool ok = got == (int)prior || got == (int)prior + 1;
+        if (tear == bytes) {
+            ok = ok && rc == PICO_OK && got == (int)prior + 1;
+        }
+        EXPECT(ok, "len %zu, %u saved before, tear at %u of %u: loaded gen %d (save returned %d)", len, prior, tear,
+               bytes, got, rc);
+        if (!ok) {
+            return;
+        }
+        // 壊れたスロットがあっても続けて保存でき、両方のスロットを使い回せる
+        for (uint32_t gen = prior + 2u; gen <= prior + 3u; ++gen) {
+            rc = config_store_save(buf, make(gen, len));
+            got = loaded_gen(len);
+            EXPECT(rc == PICO_OK && got == (int)gen, "len %zu, tear at %u: save %u returned %d, loaded gen %d", len,
+                   tear, gen, rc, got);
+        }
+    }
+}
+
+int main(void) {
+    host_flash_reset();
+    const size_t lens[] = {4, 600, 2000}; // 1・3・8 ページ
+    for (size_t i = 0; i < count_of(lens); ++i) {
+        for (uint32_t prior = 0; prior <= 2u; ++prior) {
+            sweep(lens[i], prior);
+        }
+    }
+    if (failures == 0) {
+        printf("config_store: ok\n");
+    }
+    return failures ? 1 : 0;
+}
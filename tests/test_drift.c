@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "drift.h"
+
+// drift の回帰と CUSUM を、合成した傾斜の系列で確かめる (1時間ごとの要約を 20 日分)
+
+#define HOUR_MS 3600000ull
+#define T0_MS 1704067200000ull
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+static tilt_record tilt_at(int32_t pitch_cdeg, int32_t roll_cdeg) {
+    tilt_record t = {TILT_RECORD_TAG, TILT_OUTPUT_PITCH_ROLL, 0, {pitch_cdeg, roll_cdeg, 0}};
+    return t;
+}
+
+// 雑音 (±3 × 0.01°) の決まった系列
+static int32_t noise(int h) {
+    return (h * 7919) % 7 - 3;
+}
+
+int main(void) {
+    host_flash_reset();
+    drift_record r;
+    uint64_t now = T0_MS;
+
+    // 重力ベクトル出力は受け付けない
+    tilt_record g = {TILT_RECORD_TAG, TILT_OUTPUT_GRAVITY, 0, {0, 0, TILT_ONE}};
+    EXPECT(drift_add(now, &g, &r) == PICO_ERROR_INVALID_ARG, "gravity output");
+
+    // ピッチは 0.5°/日 (50 × 0.01°/日) で傾き続け、ロールは 12 日目に 3° ずれる
+    // 速度の警報は、回帰を始めて (やり直して) から DRIFT_MIN_INTERVALS 個目の要約で1回だけイベントになる
+    int fit_start = 0, change_at = -1, rate_events = 0;
+    for (int h = 0; h < 24 * 20; ++h) {
+        int32_t pitch = 100 + 50 * h / 24 + noise(h);
+        int32_t roll = 20 + (h >= 24 * 12 ? 300 : 0) + noise(h + 3);
+        tilt_record t = tilt_at(pitch, roll);
+        int rc = drift_add(now + h * HOUR_MS, &t, &r);
+        EXPECT(rc == PICO_OK, "hour %d rc %d", h, rc);
+        // 間隔内の起床では何もしない
+        drift_record unused;
+        rc = drift_add(now + h * HOUR_MS + 60000, &t, &unused);
+        EXPECT(rc == PICO_ERROR_NO_DATA, "hour %d within interval rc %d", h, rc);
+
+        EXPECT(!(r.flags & DRIFT_FLAG_CHANGE_PITCH), "false pitch change at hour %d", h);
+        if (r.flags & DRIFT_FLAG_CHANGE_ROLL) {
+            EXPECT(change_at < 0, "second roll change at hour %d", h);
+            EXPECT(r.flags & DRIFT_FLAG_NEW_ALERT, "change at hour %d not an event", h);
+            change_at = fit_start = h;
+            continue;
+        }
+        bool due = h - fit_start == (int)DRIFT_MIN_INTERVALS - 1;
+        EXPECT(!!(r.flags & DRIFT_FLAG_RATE_PITCH) == (h - fit_start >= (int)DRIFT_MIN_INTERVALS - 1),
+               "hour %d rate flag %02x", h, r.flags);
+        EXPECT(!!(r.flags & DRIFT_FLAG_NEW_ALERT) == due, "hour %d new alert %02x", h, r.flags);
+        rate_events += due;
+    }
+    printf("roll change at hour %d, %d rate events\n", change_at, rate_events);
+    EXPECT(change_at >= 24 * 12 && change_at <= 24 * 12 + 2, "step detected at hour %d", change_at);
+    EXPECT(rate_events == 2, "rate events %d", rate_events);
+
+    // 最後の要約: 0.5°/日 = 500 mdeg/日、1m の腕で 8.7mm/日。ロールは段差のあと平ら
+    printf("rate %d %d mdeg/day, creep %d %d um/day, %u intervals\n", r.rate_mdeg_per_day[0],
+           r.rate_mdeg_per_day[1], r.creep_um_per_day[0], r.creep_um_per_day[1], r.intervals);
+    EXPECT(abs(r.rate_mdeg_per_day[0] - 500) <= 10, "pitch rate %d", r.rate_mdeg_per_day[0]);
+    EXPECT(abs(r.creep_um_per_day[0] - 8727) <= 200, "pitch creep %d", r.creep_um_per_day[0]);
+    EXPECT(abs(r.rate_mdeg_per_day[1]) < DRIFT_RATE_ALERT_MDEG_PER_DAY, "roll rate %d", r.rate_mdeg_per_day[1]);
+    EXPECT(!(r.flags & DRIFT_FLAG_RATE_ROLL), "roll rate alert");
+
+    // タイマーが巻き戻った (チップリセット) ら回帰をやり直す
+    tilt_record t = tilt_at(1000, 0);
+    EXPECT(drift_add(now, &t, &r) == PICO_OK, "restart after timer reset");
+    EXPECT(r.intervals == 1 && r.flags == 0, "restart: %u intervals flags %02x", r.intervals, r.flags);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "fixed_trig.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// fixed_trig の段階ごとの最大誤差を、倍精度の libm と比べて確かめる。
+// 入力は整数なので、期待値も丸めたあとの整数の atan2 / asin とする
+
+static const double tier_limit_deg[FIXED_TRIG_TIER_COUNT] = {0.1, 0.01, 0.001};
+static const char *tier_name[FIXED_TRIG_TIER_COUNT] = {"0.1", "0.01", "0.001"};
+
+static int failures;
+
+static double err_deg(int32_t got_mdeg, double want_rad) {
+    double e = fabs(got_mdeg / 1000.0 - want_rad * 180.0 / M_PI);
+    return e > 180.0 ? 360.0 - e : e;
+}
+
+static void check(const char *what, fixed_trig_tier tier, double max_err) {
+    bool ok = max_err <= tier_limit_deg[tier];
+    printf("%-6s tier %-5s max error %.5f deg%s\n", what, tier_name[tier], max_err, ok ? "" : "  FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 全周を、長さ 1 から int32 の上限近くまで
+static void sweep_atan2(fixed_trig_tier tier) {
+    double cordic = 0, poly = 0;
+    for (int mag = 0; mag <= 30; mag += mag < 20 ? 1 : 2) {
+        double r = fmin(ldexp(1.37, mag), 2.1e9);
+        for (int k = 0; k < 20000; ++k) {
+            double th = -M_PI + 2 * M_PI * k / 20000.0 + 1e-7;
+            int32_t x = (int32_t)lrint(r * cos(th));
+            int32_t y = (int32_t)lrint(r * sin(th));
+            if (x == 0 && y == 0) {
+                continue;
+            }
+            double want = atan2(y, x);
+            cordic = fmax(cordic, err_deg(fixed_atan2_cordic(y, x, tier), want));
+            poly = fmax(poly, err_deg(fixed_atan2_poly(y, x, tier), want));
+        }
+    }
+    check("cordic", tier, cordic);
+    check("poly", tier, poly);
+}
+
+// 小さい r はすべての s を、大きい r は [-r, r] を細かく
+static void sweep_asin(fixed_trig_tier tier) {
+    double worst = 0;
+    for (int32_t r = 1; r <= 256; ++r) {
+        for (int32_t s = -r; s <= r; ++s) {
+            worst = fmax(worst, err_deg(fixed_asin(s, r, tier), asin((double)s / r)));
+        }
+    }
+    for (int mag = 9; mag <= 23; ++mag) {
+        int32_t r = (int32_t)ldexp(1.0, mag) - 3;
+        for (int k = -20000; k <= 20000; ++k) {
+            int32_t s = (int32_t)((int64_t)r * k / 20000);
+            worst = fmax(worst, err_deg(fixed_asin(s, r, tier), asin((double)s / r)));
+        }
+    }
+    check("asin", tier, worst);
+}
+
+// 長さ (Q8) の相対誤差。tilt は √(y² + z²) をピッチの分母に使う
+static void sweep_hypot(void) {
+    double worst = 0;
+    for (int mag = 10; mag <= 22; ++mag) {
+        double r = ldexp(1.37, mag);
+        for (int k = 0; k < 4000; ++k) {
+            double th = 2 * M_PI * k / 4000.0;
+            int32_t x = (int32_t)lrint(r * cos(th));
+            int32_t y = (int32_t)lrint(r * sin(th));
+            uint32_t h_q8;
+            fixed_atan2_hypot(y, x, FIXED_TRIG_TIER_0_001, &h_q8);
+            double want = hypot(x, y);
+            worst = fmax(worst, fabs(h_q8 / 256.0 - want) / want);
+        }
+    }
+    bool ok = worst < 1e-5;
+    printf("hypot  relative error %.2e%s\n", worst, ok ? "" : "  FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+static void check_isqrt(void) {
+    static const uint64_t v[] = {0, 1, 2, 3, 4, 15, 16, 17, 0xffffffffull, 1ull << 62, (1ull << 62) - 1};
+    for (unsigned i = 0; i < count_of(v); ++i) {
+        uint64_t q = fixed_isqrt64(v[i]);
+        if (q * q > v[i] || (q + 1) * (q + 1) <= v[i]) {
+            printf("isqrt(%llu) = %llu  FAIL\n", (unsigned long long)v[i], (unsigned long long)q);
+            failures++;
+        }
+    }
+}
+
+int main(void) {
+    for (int t = 0; t < FIXED_TRIG_TIER_COUNT; ++t) {
+        sweep_atan2((fixed_trig_tier)t);
+        sweep_asin((fixed_trig_tier)t);
+    }
+    sweep_hypot();
+    check_isqrt();
+    return failures ? 1 : 0;
+}
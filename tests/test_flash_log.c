@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "powman_scratch.h"
+#include "blockdev.h"
+#include "flash_log.h"
+#include "host_storage.h"
+
+// ログを RAM 上の NOR と SD で動かす。追記・コミット・リングの一周・時刻の巻き戻り (区間)、
+// 書き込み途中の電源断から復旧したときにコミット済みのレコードが1つも欠けないこと、
+// インデックスを間引く 16MB 超のデバイス
+
+#define T0_MS 1704067200000ull
+#define SMALL_SIZE (16u * FLASH_LOG_SECTOR_SIZE)
+
+powman_hw_t host_powman;
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+static const storage_backend *dev;
+
+static size_t record_extra; // レコードを長くする (大きいデバイスを少ない件数で埋める)
+
+// id ごとに長さと中身が決まるレコード
+static size_t record_len(uint32_t id) {
+    return 4u + id % 37u + record_extra;
+}
+
+static int append(uint64_t ts, uint32_t id) {
+    uint8_t buf[FLASH_LOG_MAX_PAYLOAD];
+    size_t len = record_len(id);
+    memset(buf, (int)(id & 0xffu), len);
+    memcpy(buf, &id, sizeof(id));
+    return flash_log_append(ts, buf, len);
+}
+
+// 区間 e の [t1, t2] のレコードの id を順に読む。中身が id と合わなければ失敗にする
+static uint32_t read_ids(uint32_t e, uint64_t t1, uint64_t t2, uint32_t *ids, uint32_t max) {
+    flash_log_cursor cur, end;
+    if (flash_log_find_range_in(e, t1, t2, &cur, &end) != PICO_OK) {
+        return 0;
+    }
+    uint8_t buf[FLASH_LOG_MAX_PAYLOAD];
+    uint64_t ts;
+    size_t len;
+    uint32_t n = 0;
+    while (flash_log_read(&cur, &end, &ts, buf, sizeof(buf), &len) == PICO_OK) {
+        if (ts < t1) {
+            continue;
+        }
+        if (ts > t2) {
+            break;
+        }
+        uint32_t id;
+        memcpy(&id, buf, sizeof(id));
+        bool ok = len == record_len(id);
+        for (size_t i = sizeof(id); ok && i < len; ++i) {
+            ok = buf[i] == (id & 0xffu);
+        }
+        EXPECT(ok, "%s: record %u corrupted", dev->name, id);
+        if (n < max) {
+            ids[n] = id;
+        }
+        n++;
+    }
+    return n;
+}
+
+static uint32_t read_all(uint32_t *ids, uint32_t max) {
+    return read_ids(flash_log_epoch(), 0, UINT64_MAX, ids, max);
+}
+
+// 電源を入れ直して開き直す (スクラッチレジスタは残る)
+static void reboot(void) {
+    host_storage_power_cycle();
+    EXPECT(flash_log_init(dev) == PICO_OK, "%s: init", dev->name);
+}
+
+static void append_commit(void) {
+    static uint32_t ids[256];
+    host_storage_reset(SMALL_SIZE);
+    reboot();
+    for (uint32_t i = 0; i < 100; ++i) {
+        EXPECT(append(T0_MS + i * 1000u, i) == PICO_OK, "%s: append %u", dev->name, i);
+    }
+    EXPECT(flash_log_flush() == PICO_OK, "%s: flush", dev->name);
+    // コミットしていないレコードは電源断で消える
+    for (uint32_t i = 100; i < 105; ++i) {
+        append(T0_MS + i * 1000u, i);
+    }
+    reboot();
+    uint32_t n = read_all(ids, count_of(ids));
+    EXPECT(n == 100, "%s: %u records after reboot", dev->name, n);
+    for (uint32_t i = 0; i < n && i < count_of(ids); ++i) {
+        EXPECT(ids[i] == i, "%s: record %u is %u", dev->name, i, ids[i]);
+    }
+    // 範囲の境界 (両端を含む)
+    n = read_ids(flash_log_epoch(), T0_MS + 10000u, T0_MS + 20000u, ids, count_of(ids));
+    EXPECT(n == 11 && ids[0] == 10 && ids[10] == 20, "%s: range [10, 20] gave %u records", dev->name, n);
+    // 続きを追記できる
+    EXPECT(append(T0_MS + 100000u, 100) == PICO_OK && flash_log_flush() == PICO_OK, "%s: append after reboot",
+           dev->name);
+    reboot();
+    EXPECT(read_all(ids, count_of(ids)) == 101, "%s: append after reboot lost", dev->name);
+}
+
+// 容量の何周分も書く。最古のセクタから再利用され、残りは順番どおりに読める
+static void wrap(void) {
+    static uint32_t ids[4096];
+    host_storage_reset(8u * FLASH_LOG_SECTOR_SIZE);
+    reboot();
+    const uint32_t total = 3000;
+    for (uint32_t i = 0; i < total; ++i) {
+        EXPECT(append(T0_MS + i * 1000u, i) == PICO_OK, "%s: append %u", dev->name, i);
+        if (i % 10u == 9u) {
+            EXPECT(flash_log_flush() == PICO_OK, "%s: flush %u", dev->name, i);
+            if (i % 500u == 499u) {
+                // ときどきチップリセット (スクラッチが消えて全セクタを走査する)
+                if (i % 1000u == 999u) {
+                    host_powman.scratch[SCRATCH_SUPPLY] = 0;
+                }
+                reboot();
+            }
+        }
+    }
+    flash_log_flush();
+    reboot();
+    EXPECT(flash_log_sector_count() == 8, "%s: %u sectors in use", dev->name, flash_log_sector_count());
+    uint32_t n = read_all(ids, count_of(ids));
+    EXPECT(n > 0 && n < total && n <= count_of(ids), "%s: %u records after wrap", dev->name, n);
+    bool in_order = true;
+    for (uint32_t i = 0; i < n && i < count_of(ids); ++i) {
+        in_order = in_order && ids[i] == total - n + i;
+    }
+    EXPECT(in_order, "%s: records after wrap are not the newest %u in order", dev->name, n);
+}
+
+// 書き込みのあらゆる位置で電源を落とす。コミット済みのレコードは残り、書きかけのレコードは
+// 丸ごと残るか丸ごと消え、復旧後も追記を続けられること
+static void torn_write(void) {
+    static uint32_t ids[512];
+    for (uint32_t start = 0; start < 2; ++start) {
+        // start = 1: コミット済みのレコードでセクタをほぼ埋めてから、セクタの切り替えをまたいで落とす
+        uint32_t committed = start ? 90u : 10u;
+        for (uint32_t tear = 0; tear < 2048u; ++tear) {
+            host_storage_reset(SMALL_SIZE);
+            reboot();
+            for (uint32_t i = 0; i < committed; ++i) {
+                append(T0_MS + i * 1000u, i);
+            }
+            EXPECT(flash_log_flush() == PICO_OK, "%s: flush", dev->name);
+            host_storage_tear_after(tear);
+            for (uint32_t i = committed; i < committed + 12u; ++i) {
+                append(T0_MS + i * 1000u, i);
+            }
+            flash_log_flush();
+
+            reboot();
+            uint32_t n = read_all(ids, count_of(ids));
+            bool ok = n >= committed && n <= committed + 12u;
+            for (uint32_t i = 0; ok && i < n; ++i) {
+                ok = ids[i] == i;
+            }
+            EXPECT(ok, "%s: tear at %u after %u committed: %u records", dev->name, tear, committed, n);
+            if (!ok) {
+                return;
+            }
+            EXPECT(append(T0_MS + 200000u, 200) == PICO_OK && flash_log_flush() == PICO_OK,
+                   "%s: append after tear at %u", dev->name, tear);
+            reboot();
+            uint32_t m = read_all(ids, count_of(ids));
+            EXPECT(m == n + 1 && ids[n] == 200, "%s: tear at %u: %u records, then %u", dev->name, tear, n, m);
+            // 1バイトずつ最後まで: 最後の位置では書き込みが電源断の前に終わっている
+            if (tear == 2047u) {
+                EXPECT(n == committed + 12u, "%s: 2048 bytes do not cover the write (%u records)", dev->name, n);
+            }
+        }
+    }
+}
+
+// 時刻が戻ったら新しい区間になり、区間ごとに検索できる
+static void rewind_clock(void) {
+    static uint32_t ids[256];
+    host_storage_reset(SMALL_SIZE);
+    reboot();
+    uint32_t e0 = flash_log_epoch();
+    for (uint32_t i = 0; i < 150; ++i) {
+        append(T0_MS + i * 1000u, i);
+    }
+    flash_log_flush();
+    // コールドスタート: タイマーが初期値に戻る
+    reboot();
+    EXPECT(flash_log_epoch() == e0, "%s: epoch changed by reboot", dev->name);
+    for (uint32_t i = 0; i < 50; ++i) {
+        EXPECT(append(T0_MS + i * 1000u, 1000u + i) == PICO_OK, "%s: append after rewind %u", dev->name, i);
+    }
+    flash_log_flush();
+    EXPECT(flash_log_epoch() == e0 + 1u, "%s: epoch %u after rewind", dev->name, flash_log_epoch());
+
+    reboot();
+    EXPECT(flash_log_epoch() == e0 + 1u, "%s: epoch %u after reboot", dev->name, flash_log_epoch());
+    uint32_t n = read_all(ids, count_of(ids));
+    EXPECT(n == 50 && ids[0] == 1000u && ids[49] == 1049u, "%s: new epoch has %u records", dev->name, n);
+    n = read_ids(e0, 0, UINT64_MAX, ids, count_of(ids));
+    EXPECT(n == 150 && ids[0] == 0 && ids[149] == 149u, "%s: old epoch has %u records", dev->name, n);
+    // 同じ時刻の範囲でも区間ごとに別の結果
+    n = read_ids(e0, T0_MS + 20000u, T0_MS + 29000u, ids, count_of(ids));
+    EXPECT(n == 10 && ids[0] == 20u, "%s: old epoch range gave %u", dev->name, n);
+    n = read_ids(e0 + 1u, T0_MS + 20000u, T0_MS + 29000u, ids, count_of(ids));
+    EXPECT(n == 10 && ids[0] == 1020u, "%s: new epoch range gave %u", dev->name, n);
+    EXPECT(flash_log_find_range_in(e0 + 2u, 0, UINT64_MAX, &(flash_log_cursor){0}, &(flash_log_cursor){0}) ==
+               PICO_ERROR_NO_DATA,
+           "%s: empty epoch", dev->name);
+}
+
+// 起床ごとの初期化は、スクラッチに残した書き込み中セクタから数セクタのヘッダを読むだけで済む。
+// 手がかりが古くても (何セクタか前) たどって追いつき、インデックスは最初の検索で作る
+static void wake_init_reads(void) {
+    static uint32_t ids[32768];
+    const uint32_t nsectors = 256;
+    host_storage_reset(nsectors * FLASH_LOG_SECTOR_SIZE);
+    reboot();
+    uint32_t total = 0;
+    for (; flash_log_sector_count() < 200u; ++total) {
+        append(T0_MS + total * 1000u, total);
+    }
+    flash_log_flush();
+    uint32_t stale = host_powman.scratch[SCRATCH_SUPPLY];
+    for (uint32_t end = total + 1000u; total < end; ++total) {
+        append(T0_MS + total * 1000u, total);
+    }
+    flash_log_flush();
+
+    host_storage_stats st;
+    host_storage_clear_stats();
+    reboot();
+    host_storage_get_stats(&st);
+    uint32_t hinted = st.reads;
+    EXPECT(hinted < 200u, "%s: %u reads to init with a hint", dev->name, hinted);
+
+    host_storage_clear_stats();
+    host_powman.scratch[SCRATCH_SUPPLY] = stale;
+    reboot();
+    host_storage_get_stats(&st);
+    EXPECT(st.reads < 250u, "%s: %u reads to init with a stale hint", dev->name, st.reads);
+
+    // 手がかりがなければ seq の途切れを二分探索する (全セクタは読まない)
+    host_storage_clear_stats();
+    host_powman.scratch[SCRATCH_SUPPLY] = 0;
+    reboot();
+    host_storage_get_stats(&st);
+    EXPECT(st.reads <= hinted + 16u, "%s: %u reads to init without a hint", dev->name, st.reads);
+
+    for (uint32_t k = 0; k < 2; ++k) {
+        host_powman.scratch[SCRATCH_SUPPLY] = k ? stale : 0u;
+        reboot();
+        EXPECT(append(T0_MS + total * 1000u, total) == PICO_OK && flash_log_flush() == PICO_OK,
+               "%s: append after init", dev->name);
+        total++;
+        reboot();
+        uint32_t n = read_all(ids, count_of(ids));
+        EXPECT(n == total && ids[n - 1u] == total - 1u, "%s: %u of %u records after hinted init", dev->name, n,
+               total);
+    }
+}
+
+// 16MB を超えるデバイス: インデックスは 16 セクタに1項目、手がかりは 2 セクタ単位になる。
+// 一周以上書いてもデバイス全体を使い、起床・検索で読むヘッダが少ないまま結果が正しいこと。
+// SD はセクタを開くときに消去しない
+static void large_device(void) {
+    static uint32_t ids[64];
+    const uint32_t nsectors = 33000; // 129MB
+    host_storage_reset(nsectors * FLASH_LOG_SECTOR_SIZE);
+    memset(&host_powman, 0, sizeof(host_powman));
+    reboot();
+    const uint32_t capacity = nsectors - nsectors % 16u;
+    EXPECT(flash_log_sector_capacity() == capacity, "%s: capacity %u sectors, want %u", dev->name,
+           flash_log_sector_capacity(), capacity);
+
+    record_extra = 900; // 1セクタに3〜4件
+    uint32_t total = 0;
+    for (uint32_t extra = 0; extra < 20000u; ++total) {
+        EXPECT(append(T0_MS + total * 1000u, total) == PICO_OK, "%s: append %u", dev->name, total);
+        if (total % 10u == 9u) {
+            flash_log_flush();
+        }
+        if (flash_log_sector_count() == capacity) {
+            extra++;
+        }
+    }
+    flash_log_flush();
+    host_storage_stats st;
+    host_storage_get_stats(&st);
+    EXPECT((st.erases == 0) == (dev == &host_storage_sd), "%s: %u erases", dev->name, st.erases);
+
+    host_storage_clear_stats();
+    reboot();
+    host_storage_get_stats(&st);
+    uint32_t hinted = st.reads;
+    EXPECT(hinted < 100u, "%s: %u reads to init with a hint", dev->name, hinted);
+    host_storage_clear_stats();
+    host_powman.scratch[SCRATCH_SUPPLY] = 0;
+    reboot();
+    host_storage_get_stats(&st);
+    EXPECT(st.reads <= hinted + 20u, "%s: %u reads to init without a hint", dev->name, st.reads);
+    EXPECT(flash_log_sector_count() == capacity, "%s: %u sectors in use", dev->name, flash_log_sector_count());
+
+    // 最古のレコード (全範囲の先頭) と最新のレコード
+    uint32_t oldest = 0;
+    flash_log_cursor cur, end;
+    uint8_t buf[FLASH_LOG_MAX_PAYLOAD];
+    uint64_t ts;
+    size_t len;
+    EXPECT(flash_log_find_range(0, UINT64_MAX, &cur, &end) == PICO_OK &&
+               flash_log_read(&cur, &end, &ts, buf, sizeof(buf), &len) == PICO_OK,
+           "%s: read oldest", dev->name);
+    memcpy(&oldest, buf, sizeof(oldest));
+    EXPECT(oldest > 0 && (total - oldest) / 4u <= capacity && (total - oldest) / 3u >= capacity - 1u,
+           "%s: %u records kept in %u sectors", dev->name, total - oldest, capacity);
+
+    uint32_t rng = 1;
+    uint32_t max_reads = 0;
+    for (uint32_t q = 0; q < 500u; ++q) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t a = oldest + (rng >> 8) % (total - oldest);
+        uint32_t b = a + (rng & 0xffu) % 40u;
+        b = b < total ? b : total - 1u;
+        uint32_t n = read_ids(flash_log_epoch(), T0_MS + a * 1000u, T0_MS + b * 1000u, ids, count_of(ids));
+        EXPECT(n == b - a + 1u && ids[0] == a && ids[n - 1u] == b, "%s: range [%u, %u] gave %u records from %u",
+               dev->name, a, b, n, ids[0]);
+        // インデックスを作ったあとの検索で読むのは、境界 (区間の両端と時刻の両端) ごとに log2(16) 個のヘッダ
+        host_storage_clear_stats();
+        flash_log_find_range(T0_MS + a * 1000u, T0_MS + b * 1000u, &cur, &end);
+        host_storage_get_stats(&st);
+        max_reads = st.reads > max_reads ? st.reads : max_reads;
+    }
+    EXPECT(max_reads <= 16u, "%s: up to %u header reads per find_range", dev->name, max_reads);
+    record_extra = 0;
+}
+
+int main(void) {
+    static const storage_backend *const backends[] = {&host_storage_nor, &host_storage_sd};
+    for (uint32_t i = 0; i < count_of(backends); ++i) {
+        dev = backends[i];
+        memset(&host_powman, 0, sizeof(host_powman));
+        append_commit();
+        wrap();
+        torn_write();
+        rewind_clock();
+        wake_init_reads();
+        large_device();
+    }
+    if (failures == 0) {
+        printf("flash_log: ok\n");
+    }
+    return failures ? 1 : 0;
+}
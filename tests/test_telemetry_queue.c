@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "telemetry_queue.h"
+
+// 回線断が何日も続いたときの送信待ちキュー。毎分起きて状態 (HEALTH) を積み、1時間ごとに要約、
+// ときどき警報イベントを積んで、眠る前に退避する (main と同じ流れ)。その間の送信はすべて失敗する。
+// 回線が戻ったら、イベントはすべて順番どおりに届き、状態は新しいものから退避領域の容量ぶん残ること
+
+#define MINUTE_MS 60000ull
+#define DAY_MS (24ull * 60u * MINUTE_MS)
+#define T0_MS 1704067200000ull
+#define OUTAGE_DAYS 7u
+#define EVENT_EVERY 997u // 起床回数 (約 17 時間に1回)
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+// 送信の試み: 全部取り出してから失敗する
+static void failed_uplink(uint64_t now) {
+    tq_item item;
+    while (telemetry_queue_pop(now, &item) == PICO_OK) {
+    }
+    telemetry_queue_rollback();
+}
+
+static void outage(void) {
+    host_flash_reset();
+    uint32_t wakes = OUTAGE_DAYS * 24u * 60u;
+    uint32_t events = 0;
+    for (uint32_t w = 0; w < wakes; ++w) {
+        uint64_t now = T0_MS + w * MINUTE_MS;
+        telemetry_queue_init();
+        EXPECT(telemetry_queue_push(TQ_PRIO_HEALTH, now, &w, sizeof(w)) == PICO_OK, "health push %u", w);
+        if (w % 60u == 0) {
+            EXPECT(telemetry_queue_push(TQ_PRIO_SUMMARY, now, &w, sizeof(w)) == PICO_OK, "summary push %u", w);
+        }
+        if (w % EVENT_EVERY == 0) {
+            EXPECT(telemetry_queue_push(TQ_PRIO_EVENT, now, &events, sizeof(events)) == PICO_OK, "event push %u", w);
+            events++;
+        }
+        EXPECT(telemetry_queue_push(TQ_PRIO_RAW, now, &w, sizeof(w)) == PICO_OK, "raw push %u", w);
+        if (w % 30u == 0) {
+            failed_uplink(now);
+        }
+        EXPECT(telemetry_queue_sleep() == PICO_OK, "sleep %u", w);
+    }
+
+    // 回線が戻った: すべて送る
+    uint64_t now = T0_MS + wakes * MINUTE_MS;
+    telemetry_queue_init();
+    uint32_t got[TQ_PRIO_COUNT] = {0};
+    uint32_t next_event = 0, last_health = 0, last_summary = 0;
+    bool health_ordered = true;
+    tq_item item;
+    while (telemetry_queue_pop(now, &item) == PICO_OK) {
+        uint32_t v;
+        memcpy(&v, item.data, sizeof(v));
+        if (item.prio == TQ_PRIO_EVENT) {
+            EXPECT(v == next_event, "event %u out of order (want %u)", v, next_event);
+            next_event = v + 1u;
+        } else if (item.prio == TQ_PRIO_HEALTH) {
+            health_ordered &= got[TQ_PRIO_HEALTH] == 0 || v > last_health;
+            last_health = v;
+        } else if (item.prio == TQ_PRIO_SUMMARY) {
+            last_summary = v;
+        }
+        got[item.prio]++;
+    }
+    EXPECT(telemetry_queue_commit() == PICO_OK, "commit");
+
+    tq_stats st[TQ_PRIO_COUNT];
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        telemetry_queue_get_stats((tq_priority)p, &st[p]);
+    }
+    printf("outage %u days: events %u/%u, health %u (last %u), summary %u (last %u), raw %u\n", OUTAGE_DAYS,
+           got[TQ_PRIO_EVENT], events, got[TQ_PRIO_HEALTH], last_health, got[TQ_PRIO_SUMMARY], last_summary,
+           got[TQ_PRIO_RAW]);
+    EXPECT(got[TQ_PRIO_EVENT] == events, "lost events");
+    EXPECT(st[TQ_PRIO_EVENT].sent == events, "event sent %u", st[TQ_PRIO_EVENT].sent);
+    // 状態は新しいものが、退避領域の1セクタ分を除いた容量以上残る
+    EXPECT(health_ordered && last_health == wakes - 1u, "health order / last %u", last_health);
+    EXPECT(got[TQ_PRIO_HEALTH] >= (TQ_SPILL_SECTORS_HEALTH - 1u) * 64u, "health kept %u", got[TQ_PRIO_HEALTH]);
+    EXPECT(got[TQ_PRIO_SUMMARY] == OUTAGE_DAYS * 24u && last_summary == wakes - 60u, "summary %u", got[TQ_PRIO_SUMMARY]);
+    EXPECT(got[TQ_PRIO_RAW] == 0, "raw survived sleep");
+    // 退避したものは次の起床で読み直されて空になる
+    telemetry_queue_init();
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        EXPECT(!telemetry_queue_pending((tq_priority)p), "prio %d still pending after commit", p);
+    }
+}
+
+// 期限切れで捨てた項目は sent ではなく dropped に数える
+static void expiry(void) {
+    host_flash_reset();
+    telemetry_queue_init();
+    for (uint32_t i = 0; i < 5; ++i) {
+        telemetry_queue_push(TQ_PRIO_SUMMARY, T0_MS, &i, sizeof(i));
+    }
+    telemetry_queue_push(TQ_PRIO_EVENT, T0_MS, "ev", 2);
+    telemetry_queue_sleep();
+    telemetry_queue_init();
+
+    tq_item item;
+    uint64_t later = T0_MS + 15u * DAY_MS;
+    EXPECT(telemetry_queue_pop(later, &item) == PICO_OK && item.prio == TQ_PRIO_EVENT, "event survives");
+    EXPECT(telemetry_queue_pop(later, &item) == PICO_ERROR_NO_DATA, "summaries expired");
+    // 送信に失敗したら期限切れの分も数えない
+    telemetry_queue_rollback();
+    tq_stats st;
+    telemetry_queue_get_stats(TQ_PRIO_SUMMARY, &st);
+    EXPECT(st.dropped == 0 && st.sent == 0, "rollback counted %u dropped %u sent", st.dropped, st.sent);
+
+    while (telemetry_queue_pop(later, &item) == PICO_OK) {
+    }
+    telemetry_queue_commit();
+    telemetry_queue_get_stats(TQ_PRIO_SUMMARY, &st);
+    EXPECT(st.sent == 0 && st.dropped == 5, "summary sent %u dropped %u", st.sent, st.dropped);
+    telemetry_queue_get_stats(TQ_PRIO_EVENT, &st);
+    EXPECT(st.sent == 1 && st.dropped == 0, "event sent %u dropped %u", st.sent, st.dropped);
+}
+
+#define MAX_SNAP 2048u
+
+// 今の待ち行列を取り出し順に読む (RAW は眠ると捨てるので除く)。読んだあとは戻す
+static uint32_t snapshot(uint64_t now, uint32_t *ids) {
+    uint32_t n = 0;
+    tq_item item;
+    while (telemetry_queue_pop(now, &item) == PICO_OK) {
+        if (item.prio != TQ_PRIO_RAW && n < MAX_SNAP) {
+            memcpy(&ids[n++], item.data, sizeof(uint32_t));
+        }
+    }
+    telemetry_queue_rollback();
+    return n;
+}
+
+static uint32_t rng = 1;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// 起床ごとの初期化 (二分探索と未送信だけの読み直し) が、眠る前の待ち行列をそのまま復元すること。
+// ランダムに積む・一部を送る・送信に失敗するを繰り返し、領域を何周もさせる。ときどき退避の途中で
+// 電源を落とす (書きかけのスロットが残る)。そのときは失われた分を除いて順序が保たれていればよい
+static void reinit(void) {
+    static uint32_t before[MAX_SNAP], after[MAX_SNAP];
+    host_flash_reset();
+    uint32_t id = 0;
+    for (uint32_t w = 0; w < 3000u; ++w) {
+        uint64_t now = T0_MS + w * MINUTE_MS;
+        telemetry_queue_init();
+        for (uint32_t k = next_rand() % 24u; k > 0; --k) {
+            tq_priority prio = (tq_priority)(next_rand() % TQ_PRIO_COUNT);
+            uint8_t data[TQ_ITEM_MAX];
+            memset(data, (int)id, sizeof(data));
+            memcpy(data, &id, sizeof(id));
+            telemetry_queue_push(prio, now, data, 4u + next_rand() % (TQ_ITEM_MAX - 4u));
+            id++;
+        }
+        // 一部を送る (送信済みは古い方から付く) か、送信に失敗する
+        uint32_t send = next_rand() % 3u == 0 ? next_rand() % 40u : 0u;
+        tq_item item;
+        for (uint32_t k = 0; k < send && telemetry_queue_pop(now, &item) == PICO_OK; ++k) {
+        }
+        if (next_rand() % 4u == 0) {
+            telemetry_queue_rollback();
+        } else {
+            telemetry_queue_commit();
+        }
+
+        uint32_t nb = snapshot(now, before);
+        uint32_t dropped = 0; // 眠るときに溢れで捨てた数
+        for (int p = 0; p < TQ_PRIO_RAW; ++p) {
+            tq_stats st;
+            telemetry_queue_get_stats((tq_priority)p, &st);
+            dropped -= st.dropped;
+        }
+        bool tear = next_rand() % 8u == 0;
+        if (tear) {
+            host_flash_tear_after(next_rand() % 4096u);
+        }
+        telemetry_queue_sleep();
+        host_flash_power_cycle();
+        for (int p = 0; p < TQ_PRIO_RAW; ++p) {
+            tq_stats st;
+            telemetry_queue_get_stats((tq_priority)p, &st);
+            dropped += st.dropped;
+        }
+
+        telemetry_queue_init();
+        uint32_t na = snapshot(now, after);
+        // after は before の部分列 (溢れで捨てたもの・電源断で書けなかったものだけが抜ける)
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < na; ++i) {
+            while (j < nb && before[j] != after[i]) {
+                j++;
+            }
+            if (j == nb) {
+                EXPECT(false, "wake %u: item %u restored out of order or resurrected", w, after[i]);
+                return;
+            }
+            j++;
+        }
+        EXPECT(tear || na + dropped == nb, "wake %u: %u items before sleep, %u after (%u dropped)", w, nb, na,
+               dropped);
+        if (failures) {
+            return;
+        }
+    }
+}
+
+int main(void) {
+    outage();
+    expiry();
+    reinit();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "powman_scratch.h"
+#include "telemetry_queue.h"
+#include "uplink.h"
+#include "host_lora.h"
+
+// 送信: ループバックの無線 (host_lora.c) で uplink_poll() を動かし、送ったフレームを復号して確かめる。
+//   - フレーム長が lora_max_payload(UPLINK_DATA_RATE) 以下 (CMake で DR0-DR5 ごとにビルドする)
+//   - 時刻差 (zigzag LEB128) を復号すると元の時刻に戻る (優先度順なので負の差も入る)
+//   - 優先度順に送られ、同じ優先度の中では積んだ順
+//   - 送信 (または無線の初期化) に失敗したら項目は順序ごとキューに戻る
+//   - 送信の間隔が UPLINK_DUTY_CYCLE_PERMILLE を守る (SCRATCH_UPLINK_EARLIEST_S)
+
+#define T0_MS 1704067200000ull
+#define MINUTE_MS 60000ull
+
+powman_hw_t host_powman;
+
+static int failures;
+
+#define EXPECT(cond, ...)                    \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAIL %s: ", #cond);      \
+            printf(__VA_ARGS__);             \
+            printf("\n");                    \
+            failures++;                      \
+        }                                    \
+    } while (0)
+
+typedef struct {
+    uint64_t timestamp_ms;
+    uint8_t prio;
+    uint8_t len;
+    uint8_t id; // ペイロードの全バイト
+} item;
+
+#define MAX_ITEMS 1024u
+
+static item pushed[MAX_ITEMS];
+static uint32_t npushed;
+static item received[MAX_ITEMS];
+static uint32_t nreceived;
+
+static void reset(void) {
+    host_flash_reset();
+    memset(&host_powman, 0, sizeof(host_powman));
+    host_lora_reset();
+    telemetry_queue_init();
+    npushed = 0;
+    nreceived = 0;
+}
+
+static void push(tq_priority prio, uint64_t ts, uint8_t len) {
+    uint8_t data[TQ_ITEM_MAX];
+    uint8_t id = (uint8_t)npushed;
+    memset(data, id, len);
+    EXPECT(telemetry_queue_push(prio, ts, data, len) == PICO_OK, "push %u", npushed);
+    pushed[npushed++] = (item){ts, (uint8_t)prio, len, id};
+}
+
+// フレームを復号して received に足す
+static void decode(const host_lora_frame *f) {
+    EXPECT(f->data_rate == UPLINK_DATA_RATE, "frame sent at DR%u", f->data_rate);
+    EXPECT(f->len <= lora_max_payload(UPLINK_DATA_RATE), "frame of %zu bytes, DR%u allows %zu", f->len,
+           UPLINK_DATA_RATE, lora_max_payload(UPLINK_DATA_RATE));
+    EXPECT(f->len > 7u && f->data[0] == UPLINK_FRAME_VERSION, "frame header");
+    uint64_t ts = 0;
+    for (int i = 0; i < 6; ++i) {
+        ts |= (uint64_t)f->data[1 + i] << (8 * i);
+    }
+    size_t pos = 7;
+    while (pos < f->len) {
+        uint64_t v = 0;
+        uint8_t b;
+        int shift = 0;
+        do {
+            b = f->data[pos++];
+            v |= (uint64_t)(b & 0x7fu) << shift;
+            shift += 7;
+        } while ((b & 0x80u) && pos < f->len);
+        ts += (uint64_t)((int64_t)(v >> 1) ^ -(int64_t)(v & 1u));
+        if (pos >= f->len) {
+            EXPECT(false, "item header truncated");
+            return;
+        }
+        uint8_t hdr = f->data[pos++];
+        item it = {ts, (uint8_t)(hdr >> 6), (uint8_t)(hdr & 0x3fu), 0};
+        if (pos + it.len > f->len || it.len == 0) {
+            EXPECT(false, "item payload truncated");
+            return;
+        }
+        it.id = f->data[pos];
+        bool same = true;
+        for (uint32_t i = 0; i < it.len; ++i) {
+            same = same && f->data[pos + i] == it.id;
+        }
+        EXPECT(same, "payload of item %u", it.id);
+        pos += it.len;
+        if (nreceived < MAX_ITEMS) {
+            received[nreceived++] = it;
+        }
+    }
+}
+
+static void decode_new(uint32_t *seen) {
+    for (; *seen < host_lora_frame_count(); ++*seen) {
+        decode(host_lora_frame_get(*seen));
+    }
+}
+
+// 次に送信してよい時刻まで進めながら、キューが空になるまで送る
+static uint64_t drain(uint64_t now) {
+    uint32_t seen = host_lora_frame_count();
+    for (uint32_t i = 0; i < 10000u; ++i) {
+        uint64_t earliest = (uint64_t)powman_hw->scratch[SCRATCH_UPLINK_EARLIEST_S] * 1000u;
+        now = earliest > now ? earliest : now + 1000u;
+        if (uplink_poll(now, true) != PICO_OK) {
+            break;
+        }
+        EXPECT(host_lora_asleep(), "radio left awake");
+    }
+    decode_new(&seen);
+    return now;
+}
+
+// 積んだ項目が、優先度順 (同じ優先度は積んだ順) に1つずつ届いたか
+static void expect_all_in_order(const char *name) {
+    EXPECT(nreceived == npushed, "%s: %u of %u items received", name, nreceived, npushed);
+    uint32_t k = 0;
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        for (uint32_t i = 0; i < npushed; ++i) {
+            if (pushed[i].prio != p || k >= nreceived) {
+                continue;
+            }
+            const item *got = &received[k++];
+            EXPECT(got->id == pushed[i].id && got->prio == p && got->len == pushed[i].len &&
+                       got->timestamp_ms == pushed[i].timestamp_ms,
+                   "%s: item %u is id %u prio %u len %u ts %+lld, want id %u prio %u len %u ts %+lld", name, k - 1u,
+                   got->id, got->prio, got->len, (long long)(got->timestamp_ms - T0_MS), pushed[i].id, p,
+                   pushed[i].len, (long long)(pushed[i].timestamp_ms - T0_MS));
+        }
+    }
+}
+
+// 優先度・長さ・時刻がばらばらな項目を積む (時刻は優先度をまたいで前後し、差は数バイトの可変長になる)。
+// RAW は退避されず RAM の分を超えると捨てられるので、TQ_RAM_SLOTS 件までにする
+static uint64_t push_mixed(void) {
+    uint64_t now = T0_MS + 60u * MINUTE_MS;
+    for (uint32_t k = 0; k < 60u; ++k) {
+        tq_priority prio = (tq_priority)(k % 4u);
+        if (prio == TQ_PRIO_RAW && k >= 4u * TQ_RAM_SLOTS) {
+            prio = TQ_PRIO_SUMMARY;
+        }
+        uint64_t ts = prio == TQ_PRIO_RAW ? now - (k % 7u) * 1000u : T0_MS + ((k * 7919u) % 3600u) * 1000u + k;
+        push(prio, ts, (uint8_t)(1u + (k * 13u) % TQ_ITEM_MAX));
+    }
+    return now;
+}
+
+static void pack(void) {
+    reset();
+    uint64_t now = push_mixed();
+    drain(now);
+    expect_all_in_order("pack");
+    EXPECT(host_lora_frame_count() >= 2u, "only %u frames", host_lora_frame_count());
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        EXPECT(!telemetry_queue_pending((tq_priority)p), "prio %d still pending", p);
+    }
+}
+
+static void rollback(void) {
+    for (int init = 0; init < 2; ++init) {
+        reset();
+        uint64_t now = push_mixed();
+        if (init) {
+            host_lora_fail_init(PICO_ERROR_IO);
+        } else {
+            host_lora_fail_transmit(PICO_ERROR_TIMEOUT);
+        }
+        int rc = uplink_poll(now, true);
+        EXPECT(rc != PICO_OK && rc != PICO_ERROR_NO_DATA, "failed uplink returned %d", rc);
+        EXPECT(host_lora_frame_count() == 0 && host_lora_asleep(), "failed uplink sent a frame or left the radio on");
+        EXPECT(powman_hw->scratch[SCRATCH_UPLINK_EARLIEST_S] == 0, "failed uplink moved the duty cycle window");
+        // 次の送信で、失敗しなかった場合と同じ順序で届く
+        drain(now);
+        expect_all_in_order(init ? "rollback after init failure" : "rollback after tx failure");
+    }
+}
+
+// 10 秒ごとに状態を積み、250ms ごとに緊急扱いで送信を試みる (デューティ比だけが送信を止める)
+static void duty_cycle(void) {
+    reset();
+    uint64_t now = T0_MS;
+    uint64_t prev_start = 0;
+    uint64_t prev_air_us = 0;
+    uint64_t air_total_us = 0;
+    uint32_t sent = 0;
+    uint32_t seen = 0;
+    const uint64_t end = T0_MS + 6u * 60u * MINUTE_MS;
+    for (uint32_t tick = 0; now < end; ++tick, now += 250u) {
+        if (tick % 40u == 0) {
+            uint8_t v = (uint8_t)tick;
+            telemetry_queue_push(TQ_PRIO_HEALTH, now, &v, sizeof(v));
+        }
+        uint32_t earliest_s = powman_hw->scratch[SCRATCH_UPLINK_EARLIEST_S];
+        int rc = uplink_poll(now, true);
+        if (rc != PICO_OK) {
+            continue;
+        }
+        EXPECT(now / 1000u >= earliest_s, "sent at %llu s before the earliest %u s", (unsigned long long)(now / 1000u),
+               earliest_s);
+        const host_lora_frame *f = host_lora_frame_get(host_lora_frame_count() - 1u);
+        uint64_t air_us = lora_time_on_air_us(f->data_rate, f->len);
+        // 送信の終わりから、送信時間の (1000 / permille - 1) 倍は休む
+        if (sent > 0) {
+            uint64_t gap_us = (now - prev_start) * 1000u;
+            EXPECT(gap_us * UPLINK_DUTY_CYCLE_PERMILLE >= prev_air_us * 1000u,
+                   "frame %u: %llu us after a %llu us frame (duty %u permille)", sent,
+                   (unsigned long long)gap_us, (unsigned long long)prev_air_us, UPLINK_DUTY_CYCLE_PERMILLE);
+        }
+        prev_start = now;
+        prev_air_us = air_us;
+        air_total_us += air_us;
+        sent++;
+    }
+    decode_new(&seen);
+    EXPECT(sent >= 3u, "only %u frames in 6 hours", sent);
+    uint64_t span_us = (prev_start - T0_MS) * 1000u + prev_air_us;
+    EXPECT(air_total_us * 1000u <= span_us * UPLINK_DUTY_CYCLE_PERMILLE + prev_air_us * 1000u,
+           "%llu us on air in %llu us", (unsigned long long)air_total_us, (unsigned long long)span_us);
+    printf("DR%u: %u frames in 6 hours, %.2f%% on air\n", UPLINK_DATA_RATE, sent,
+           100.0 * (double)air_total_us / (double)span_us);
+}
+
+int main(void) {
+    pack();
+    rollback();
+    duty_cycle();
+    if (failures == 0) {
+        printf("uplink DR%u: ok\n", UPLINK_DATA_RATE);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+#include <math.h>
+#include "pico/stdlib.h"
+#include "fixed_trig.h"
+#include "tilt.h"
+
+// 回転行列とみなす誤差 (Q14 への丸めの分を許す)
+#define TILT_ROTATION_TOLERANCE 0.01f
+// ゼロ点の取得に必要な重力の大きさ (生値)。これより小さいと向きが決まらない
+#ifndef TILT_ZERO_MIN_MAGNITUDE
+#define TILT_ZERO_MIN_MAGNITUDE 256.0f
+#endif
+
+
+static const int16_t identity[9] = {TILT_ONE, 0, 0, 0, TILT_ONE, 0, 0, 0, TILT_ONE};
+
+// 合成行列 C = Z·M (Q14)
+static int16_t combined[9] = {TILT_ONE, 0, 0, 0, TILT_ONE, 0, 0, 0, TILT_ONE};
+static tilt_output_mode output_mode = TILT_OUTPUT_PITCH_ROLL;
+
+static void to_float(const int16_t q[9], float f[9]) {
+    for (uint i = 0; i < 9; ++i) {
+        f[i] = (float)q[i] / TILT_ONE;
+    }
+}
+
+static void to_q14(const float f[9], int16_t q[9]) {
+    for (uint i = 0; i < 9; ++i) {
+        q[i] = (int16_t)lroundf(f[i] * TILT_ONE);
+    }
+}
+
+static void mat_mul(const float a[9], const float b[9], float out[9]) {
+    for (uint i = 0; i < 3; ++i) {
+        for (uint j = 0; j < 3; ++j) {
+            out[i * 3 + j] = a[i * 3] * b[j] + a[i * 3 + 1] * b[3 + j] + a[i * 3 + 2] * b[6 + j];
+        }
+    }
+}
+
+// 行どうしが正規直交で、行列式が +1 (鏡映でない)
+static bool is_rotation(const float m[9]) {
+    for (uint i = 0; i < 3; ++i) {
+        for (uint j = i; j < 3; ++j) {
+            float dot = m[i * 3] * m[j * 3] + m[i * 3 + 1] * m[j * 3 + 1] + m[i * 3 + 2] * m[j * 3 + 2];
+            if (fabsf(dot - (i == j ? 1.0f : 0.0f)) > TILT_ROTATION_TOLERANCE) {
+                return false;
+            }
+        }
+    }
+    float det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) +
+                m[2] * (m[3] * m[7] - m[4] * m[6]);
+    return fabsf(det - 1.0f) <= TILT_ROTATION_TOLERANCE;
+}
+
+void tilt_config_defaults(tilt_config *cfg) {
+    for (uint i = 0; i < 9; ++i) {
+        cfg->mount[i] = identity[i];
+        cfg->zero[i] = identity[i];
+    }
+    cfg->output = TILT_OUTPUT_PITCH_ROLL;
+}
+
+int tilt_init(const tilt_config *cfg) {
+    if (cfg->output >= TILT_OUTPUT_COUNT) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    float mount[9], zero[9], c[9];
+    to_float(cfg->mount, mount);
+    to_float(cfg->zero, zero);
+    if (!is_rotation(mount) || !is_rotation(zero)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    mat_mul(zero, mount, c);
+    to_q14(c, combined);
+    output_mode = (tilt_output_mode)cfg->output;
+    return PICO_OK;
+}
+
+int tilt_capture_zero(const int16_t raw[3], tilt_config *cfg) {
+    // 取り付け向きだけを補正した重力方向
+    float mount[9];
+    to_float(cfg->mount, mount);
+    float g[3];
+    for (uint i = 0; i < 3; ++i) {
+        g[i] = mount[i * 3] * raw[0] + mount[i * 3 + 1] * raw[1] + mount[i * 3 + 2] * raw[2];
+    }
+    float n = sqrtf(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+    if (n < TILT_ZERO_MIN_MAGNITUDE) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    float ax = g[0] / n, ay = g[1] / n, az = g[2] / n;
+
+    float zero[9];
+    if (az < -0.9999f) {
+        // 逆さま: 最小の回転が決まらないので X 軸まわりに 180°
+        const float flip[9] = {1.0f, 0, 0, 0, -1.0f, 0, 0, 0, -1.0f};
+        for (uint i = 0; i < 9; ++i) {
+            zero[i] = flip[i];
+        }
+    } else {
+        // a を +Z に回す最小の回転 (ロドリゲスの式。回転軸 a × ez、cos = az)
+        float k = 1.0f / (1.0f + az);
+        zero[0] = 1.0f - ax * ax * k;
+        zero[1] = -ax * ay * k;
+        zero[2] = -ax;
+        zero[3] = -ax * ay * k;
+        zero[4] = 1.0f - ay * ay * k;
+        zero[5] = -ay;
+        zero[6] = ax;
+        zero[7] = ay;
+        zero[8] = 1.0f - (ax * ax + ay * ay) * k;
+    }
+    to_q14(zero, cfg->zero);
+    return tilt_init(cfg);
+}
+
+void __not_in_flash_func(tilt_rotate)(const int16_t raw[3], int32_t out[3]) {
+    for (uint i = 0; i < 3; ++i) {
+        int32_t acc = combined[i * 3] * raw[0] + combined[i * 3 + 1] * raw[1] + combined[i * 3 + 2] * raw[2];
+        out[i] = (acc + (1 << (TILT_Q - 1))) >> TILT_Q;
+    }
+}
+
+// 0.001° → 0.01° (四捨五入)
+static __force_inline int32_t centideg(int32_t mdeg) {
+    return (mdeg + (mdeg >= 0 ? 5 : -5)) / 10;
+}
+
+// 軸 a と、残り2軸の合成 (水平成分) とのなす角。CORDIC 2回で √ を使わずに求める
+static __force_inline int32_t axis_angle(int32_t a, int32_t b, int32_t c) {
+    uint32_t h_q8;
+    fixed_atan2_hypot(b, c, TILT_TRIG_TIER, &h_q8);
+    return fixed_atan2_cordic(a * 256, (int32_t)h_q8, TILT_TRIG_TIER);
+}
+
+// 整数演算だけなので、flash_power_run() の中からも呼べる
+void __not_in_flash_func(tilt_compute)(const int16_t raw[3], tilt_record *out) {
+    int32_t g[3];
+    tilt_rotate(raw, g);
+
+    out->tag = TILT_RECORD_TAG;
+    out->output = (uint8_t)output_mode;
+    out->reserved = 0;
+    switch (output_mode) {
+        case TILT_OUTPUT_AXIS_ANGLES:
+            out->v[0] = centideg(axis_angle(g[0], g[1], g[2]));
+            out->v[1] = centideg(axis_angle(g[1], g[0], g[2]));
+            out->v[2] = centideg(axis_angle(g[2], g[0], g[1]));
+            break;
+        case TILT_OUTPUT_GRAVITY: {
+            // |g| < 2^17 なので g × TILT_ONE は int32 に収まる
+            int32_t n = (int32_t)fixed_isqrt64((uint64_t)((int64_t)g[0] * g[0] + (int64_t)g[1] * g[1] +
+                                                          (int64_t)g[2] * g[2]));
+            for (uint i = 0; i < 3; ++i) {
+                int32_t v = g[i] * TILT_ONE;
+                out->v[i] = n > 0 ? (v + (v >= 0 ? n / 2 : -n / 2)) / n : 0;
+            }
+            break;
+        }
+        default: {
+            // ロールと、ピッチに使う水平成分 √(y² + z²) を1回の CORDIC で
+            uint32_t h_q8;
+            out->v[1] = centideg(fixed_atan2_hypot(g[1], g[2], TILT_TRIG_TIER, &h_q8));
+            out->v[0] = centideg(fixed_atan2_cordic(-g[0] * 256, (int32_t)h_q8, TILT_TRIG_TIER));
+            out->v[2] = 0;
+            break;
+        }
+    }
+}
+
+void __weak tilt_sensor_start(uint32_t sample_hz) {
+}
+
+int __weak tilt_sensor_read(int16_t raw[3]) {
+    return PICO_ERROR_NO_DATA;
+}
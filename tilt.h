@@ -0,0 +1,68 @@
+#ifndef TILT_H
+#define TILT_H
+
+#include <stdint.h>
+#include "fixed_trig.h"
+
+// 加速度センサーの値から傾斜を求める。
+// 取り付け向き (センサー座標 → 装置座標の回転 M) とゼロ点 (装置座標 → 基準座標の回転 Z) を
+// 設定を変えたときに1つの行列 C = Z·M (Q14) に合成しておき、測定ごとの計算は
+// 生値に C を1回掛ける (3x3) だけにする。出力はそのあと出力形式に合わせて1回だけ変換する。
+// 静止時のセンサーは上向きの軸に +1g を示す。基準座標では水平のとき (0, 0, +1g)。
+// ゼロ点の取得 (「今の姿勢をゼロにする」) は、そのときの重力方向を +Z へ回す最小の回転を Z にする
+// (重力まわりの回転は加速度からは分からないので含まない)。
+
+#define TILT_Q 14
+#define TILT_ONE (1 << TILT_Q)
+
+// 角度の計算精度 (fixed_trig.h)。出力は 0.01° 単位
+#ifndef TILT_TRIG_TIER
+#define TILT_TRIG_TIER FIXED_TRIG_TIER_0_01
+#endif
+
+typedef enum {
+    TILT_OUTPUT_PITCH_ROLL,  // ピッチ・ロール (0.01°)。v[2] は 0
+    TILT_OUTPUT_AXIS_ANGLES, // 各軸と水平面のなす角 (0.01°)
+    TILT_OUTPUT_GRAVITY,     // 重力方向の単位ベクトル (Q14)
+    TILT_OUTPUT_COUNT
+} tilt_output_mode;
+
+// device_config に保存する設定 (行列は行優先、Q14)
+typedef struct {
+    int16_t mount[9];
+    int16_t zero[9];
+    uint32_t output; // tilt_output_mode
+} tilt_config;
+
+// ログ・テレメトリに書く記録
+#define TILT_RECORD_TAG 0x54u // 'T'
+
+typedef struct {
+    uint8_t tag;
+    uint8_t output; // tilt_output_mode
+    uint16_t reserved;
+    int32_t v[3];
+} tilt_record;
+
+// 補正なし (単位行列)、ピッチ・ロール出力
+void tilt_config_defaults(tilt_config *cfg);
+// 設定を検証して合成行列を作る。回転行列でない (直交でない・鏡映) か出力形式が不正なら
+// PICO_ERROR_INVALID_ARG (それまでの設定のまま)
+int tilt_init(const tilt_config *cfg);
+// raw (静止中の平均値が望ましい) の姿勢をゼロにする。cfg->zero を更新して合成し直す (保存は呼び出し側)。
+// 重力が小さすぎて向きが決まらなければ PICO_ERROR_INVALID_ARG
+int tilt_capture_zero(const int16_t raw[3], tilt_config *cfg);
+
+// 生値を基準座標に回す (合成行列を1回掛けるだけ。単位は生値のまま)
+void tilt_rotate(const int16_t raw[3], int32_t out[3]);
+// 回して、設定の出力形式に変換する (整数演算のみ)
+void tilt_compute(const int16_t raw[3], tilt_record *out);
+
+// 測定時間の初めに、sample_hz (solar_scheduler が発電量から決める) で標本化を始める。
+// tilt_sensor_read と同じくドライバが置き換える。既定は何もしない
+void tilt_sensor_start(uint32_t sample_hz);
+// 加速度センサーの生値 (測定時間中の平均) を読む。センサーのドライバが同じ名前で定義して置き換える。
+// 既定 (ドライバなし) は PICO_ERROR_NO_DATA で、傾斜の記録と長期変化の解析は行わない
+int tilt_sensor_read(int16_t raw[3]);
+
+#endif
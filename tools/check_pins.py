@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""board_pins.h のピン表を検査する (ビルド時に CMake から実行)。
+
+- 表にないピンは board_pins_init() で止めるので問題なし (一覧にだけ出す)
+- プルなしで相手も駆動しない入力 (浮いたピン) はエラー
+- 同じピンの重複、範囲外のピン番号、ADC ピンへのデジタル機能の割り当てはエラー
+"""
+import argparse
+import re
+import sys
+
+DEFINE_RE = re.compile(r'^\s*#define\s+(\w+)\s+(\w+)', re.M | re.A)
+PIN_RE = re.compile(r'\bPIN\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\)', re.A)
+
+
+def resolve(name, defines, depth=0):
+    if re.fullmatch(r'\d+', name):
+        return int(name)
+    if name not in defines or depth > 8:
+        return None
+    return resolve(defines[name], defines, depth + 1)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('header')
+    ap.add_argument('--gpios', type=int, default=30, help='NUM_BANK0_GPIOS (RP2350A: 30, RP2350B: 48)')
+    ap.add_argument('--verbose', action='store_true', help='全ピンの状態を表示する')
+    args = ap.parse_args()
+
+    with open(args.header, encoding='utf-8') as f:
+        text = f.read()
+    defines = dict(DEFINE_RE.findall(text))
+    errors = []
+    used = {}
+
+    for name, func, idle, pull, drive, sleep in PIN_RE.findall(text):
+        gpio = resolve(name, defines)
+        if gpio is None or not 0 <= gpio < args.gpios:
+            errors.append(f'{name}: ピン番号が不正 ({defines.get(name, "未定義")})')
+            continue
+        if gpio in used:
+            errors.append(f'GPIO{gpio}: {used[gpio][0]} と {name} が重複')
+            continue
+        used[gpio] = (name, func, idle, pull, drive, sleep)
+
+        floating_input = idle == 'PIN_IDLE_IN' and pull == 'PIN_PULL_NONE' and drive == 'PIN_FLOATS'
+        if floating_input:
+            errors.append(f'GPIO{gpio} ({name}): 入力が浮いている (プルを付けるか PIN_DRIVEN にする)')
+        if sleep == 'PIN_SLEEP_PULL' and pull == 'PIN_PULL_NONE':
+            errors.append(f'GPIO{gpio} ({name}): スリープ中に浮く (PIN_SLEEP_PULL なのにプルがない)')
+        if idle == 'PIN_IDLE_ANALOG' and func != 'GPIO_FUNC_NULL':
+            errors.append(f'GPIO{gpio} ({name}): ADC 入力に {func} が割り当てられている')
+
+    if args.verbose:
+        for gpio in range(args.gpios):
+            if gpio in used:
+                name, func, idle, pull, drive, sleep = used[gpio]
+                print(f'GPIO{gpio:2d} {name:24s} {idle:18s} {pull:14s} {drive:11s} {sleep}')
+            else:
+                print(f'GPIO{gpio:2d} {"(未使用)":24s} off')
+
+    for e in errors:
+        print(f'{args.header}: error: {e}', file=sys.stderr)
+    print(f'check_pins: 使用 {len(used)} ピン, 未使用 {args.gpios - len(used)} ピン (停止), エラー {len(errors)}')
+    return 1 if errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,56 @@
+"""ファームウェア ELF の関数一覧と置き場所 (tools/ のスクリプトで共用)。"""
+import re
+import subprocess
+
+# RP2350 のメモリ配置
+REGIONS = (
+    ('flash', 0x10000000, 0x18000000),    # XIP
+    ('sram', 0x20000000, 0x20080000),     # SRAM0-7 (ストライプ)
+    ('scratch_x', 0x20080000, 0x20081000),
+    ('scratch_y', 0x20081000, 0x20082000),
+)
+
+
+def region(addr):
+    for name, lo, hi in REGIONS:
+        if lo <= addr < hi:
+            return name
+    return 'other'
+
+
+def read_functions(nm, elf):
+    """{名前: [(アドレス, サイズ), ...]} (static 関数は同名が複数ありうる)"""
+    out = subprocess.run([nm, '--defined-only', '--print-size', elf],
+                         check=True, capture_output=True, text=True).stdout
+    funcs = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 4 or parts[2] not in 'tTwW':
+            continue
+        addr = int(parts[0], 16) & ~1  # Thumb ビット
+        funcs.setdefault(parts[3], []).append((addr, int(parts[1], 16)))
+    return funcs
+
+
+FUNC_RE = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+CALL_RE = re.compile(r'\s(?:bl|blx|b\.w|b\.n|b)\s+[0-9a-f]+ <([^>+]+)>')
+
+
+def read_calls(objdump, elf):
+    """逆アセンブルから {関数: {直接呼び出す関数}} を作る (末尾呼び出しの b.w も含む。関数ポインタ経由は分からない)"""
+    out = subprocess.run([objdump, '-d', '--no-show-raw-insn', elf],
+                         check=True, capture_output=True, text=True).stdout
+    calls = {}
+    current = None
+    for line in out.splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            current = m.group(1)
+            calls.setdefault(current, set())
+            continue
+        if current is None:
+            continue
+        m = CALL_RE.search(line)
+        if m and m.group(1) != current:
+            calls[current].add(m.group(1))
+    return calls
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""ELF の関数の置き場所 (フラッシュ/SRAM) を調べ、SRAM に置くはずの関数がフラッシュにあれば報告する。
+
+hot 関数から直接・間接に呼ぶ関数もたどり、フラッシュ上のものを呼び出し経路とともに報告する
+(SRAM 上の関数でもフラッシュ上の関数を呼べば XIP を使うので、flash_power_run() の中では止まる)。
+フラッシュ上の関数の先はたどらない。関数ポインタ経由の呼び出しは分からない。
+
+使い方: hot_path_report.py --nm arm-none-eabi-nm --objdump arm-none-eabi-objdump Inclinometer.elf
+        tools/hot_functions.txt [--list-flash] [--strict]
+"""
+import argparse
+import re
+import sys
+
+sys.dont_write_bytecode = True  # ソースツリーに __pycache__ を作らない
+from elfinfo import read_calls, read_functions, region
+
+# SRAM からフラッシュ上の関数への長い分岐はリンカが SRAM 上に作る veneer を経由する
+VENEER_RE = re.compile(r'^__(.+)_veneer$')
+
+
+def callee_name(name):
+    m = VENEER_RE.match(name)
+    return m.group(1) if m else name
+
+
+def in_flash(funcs, name):
+    return any(region(a) == 'flash' for a, _ in funcs.get(name, ()))
+
+
+def flash_callees(root, funcs, calls):
+    """root から SRAM 上の関数だけを通ってたどり着くフラッシュ上の関数と、その経路 [(名前, 経路), ...]"""
+    found = []
+    seen = {root}
+    stack = [(root, [root])]
+    while stack:
+        f, path = stack.pop()
+        for callee in sorted(calls.get(f, ())):
+            callee = callee_name(callee)
+            if callee in seen:
+                continue
+            seen.add(callee)
+            if in_flash(funcs, callee):
+                found.append((callee, path + [callee]))
+            else:
+                stack.append((callee, path + [callee]))
+    return found
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--nm', default='arm-none-eabi-nm')
+    ap.add_argument('--objdump', default='arm-none-eabi-objdump')
+    ap.add_argument('elf')
+    ap.add_argument('hot_list')
+    ap.add_argument('--list-flash', action='store_true', help='フラッシュ上の関数をすべて表示する')
+    ap.add_argument('--strict', action='store_true', help='フラッシュ上の hot 関数・呼び出し先があれば失敗する')
+    args = ap.parse_args()
+
+    funcs = read_functions(args.nm, args.elf)
+    calls = read_calls(args.objdump, args.elf)
+    with open(args.hot_list, encoding='utf-8') as f:
+        hot = [l.strip() for l in f if l.strip() and not l.startswith('#')]
+
+    hot_in_flash = []
+    callees_in_flash = set()
+    for name in hot:
+        if name not in funcs:
+            print(f'hot_path: {name}: 見つからない (インライン展開?)')
+            continue
+        if in_flash(funcs, name):
+            hot_in_flash.append(name)
+            print(f'hot_path: warning: {name} がフラッシュにある', file=sys.stderr)
+            continue
+        for callee, path in flash_callees(name, funcs, calls):
+            callees_in_flash.add(callee)
+            print(f'hot_path: warning: {name} からフラッシュ上の {callee} を呼ぶ ({" -> ".join(path)})',
+                  file=sys.stderr)
+
+    flash_funcs = sorted((n, a, s) for n, lst in funcs.items() for a, s in lst if region(a) == 'flash')
+    sram_funcs = [n for n, lst in funcs.items() for a, _ in lst if region(a) != 'flash' and region(a) != 'other']
+    if args.list_flash:
+        for n, a, s in flash_funcs:
+            print(f'  flash {a:08x} {s:6d} {n}')
+    print(f'hot_path: hot {len(hot)} 個中 {len(hot_in_flash)} 個がフラッシュ, '
+          f'フラッシュ上の呼び出し先 {len(callees_in_flash)} 個 / '
+          f'関数 フラッシュ {len(flash_funcs)} 個, SRAM {len(sram_funcs)} 個')
+    return 1 if args.strict and (hot_in_flash or callees_in_flash) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
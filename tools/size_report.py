@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""関数ごとのサイズ・置き場所・呼び出しの深さの一覧と、前回ビルドとの差分。
+
+使い方: size_report.py --nm arm-none-eabi-nm --objdump arm-none-eabi-objdump Inclinometer.elf size_report
+  size_report.txt   今回の一覧 (置き場所ごと、サイズの大きい順)
+  size_report.json  次回の比較用 (前回分は size_report.prev.json に残す)
+呼び出しの深さは直接呼び出し (bl/b.w) だけから求める。関数ポインタ経由の呼び出しは数えず、再帰は "rec"。
+"""
+import argparse
+import json
+import os
+import sys
+
+sys.dont_write_bytecode = True  # ソースツリーに __pycache__ を作らない
+from elfinfo import read_calls, read_functions, region
+
+
+def call_depths(names, calls):
+    depth = {}
+    visiting = set()
+
+    def visit(f):
+        if f in depth:
+            return depth[f]
+        if f in visiting:
+            return None  # 再帰
+        visiting.add(f)
+        d = 1
+        for callee in calls.get(f, ()):
+            if callee not in names:
+                continue
+            cd = visit(callee)
+            if cd is None:
+                d = None
+                break
+            d = max(d, cd + 1)
+        visiting.discard(f)
+        depth[f] = d
+        return d
+
+    for f in names:
+        visit(f)
+    return depth
+
+
+def build_report(nm, objdump, elf):
+    funcs = read_functions(nm, elf)
+    depth = call_depths(set(funcs), read_calls(objdump, elf))
+    report = {}
+    for name, entries in funcs.items():
+        for i, (addr, size) in enumerate(sorted(entries, key=lambda e: e[1])):
+            key = name if len(entries) == 1 else f'{name}#{i}'
+            d = depth.get(name)
+            report[key] = {'size': size, 'section': region(addr), 'depth': d if d is not None else 'rec'}
+    return report
+
+
+def totals(report):
+    t = {}
+    for r in report.values():
+        t[r['section']] = t.get(r['section'], 0) + r['size']
+    return t
+
+
+def diff_lines(prev, cur):
+    lines = []
+    for name in sorted(set(prev) | set(cur)):
+        p, c = prev.get(name), cur.get(name)
+        if p is None:
+            lines.append((c['size'], f'  + {name:40s} {c["size"]:7d} {c["section"]}'))
+        elif c is None:
+            lines.append((p['size'], f'  - {name:40s} {-p["size"]:7d} {p["section"]}'))
+        elif p['section'] != c['section']:
+            mark = ' !!' if c['section'] == 'flash' else ''
+            lines.append((abs(c['size'] - p['size']) + (1 << 30),
+                          f'  > {name:40s} {c["size"] - p["size"]:+7d} {p["section"]} -> {c["section"]}{mark}'))
+        elif p['size'] != c['size']:
+            lines.append((abs(c['size'] - p['size']), f'  ~ {name:40s} {c["size"] - p["size"]:+7d} {c["section"]}'))
+    return [l for _, l in sorted(lines, key=lambda x: -x[0])]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--nm', default='arm-none-eabi-nm')
+    ap.add_argument('--objdump', default='arm-none-eabi-objdump')
+    ap.add_argument('elf')
+    ap.add_argument('out', help='出力ファイル名 (拡張子なし)')
+    args = ap.parse_args()
+
+    cur = build_report(args.nm, args.objdump, args.elf)
+    json_path, prev_path = args.out + '.json', args.out + '.prev.json'
+    prev = None
+    if os.path.exists(json_path):
+        os.replace(json_path, prev_path)
+        with open(prev_path, encoding='utf-8') as f:
+            prev = json.load(f)
+    with open(json_path, 'w', encoding='utf-8') as f:
+        json.dump(cur, f, indent=0, sort_keys=True)
+
+    with open(args.out + '.txt', 'w', encoding='utf-8') as f:
+        f.write(f'{"section":10s} {"size":>7s} {"depth":>5s}  function\n')
+        for name, r in sorted(cur.items(), key=lambda kv: (kv[1]['section'], -kv[1]['size'], kv[0])):
+            f.write(f'{r["section"]:10s} {r["size"]:7d} {str(r["depth"]):>5s}  {name}\n')
+
+    t = totals(cur)
+    print('size_report: ' + ', '.join(f'{s} {n} バイト' for s, n in sorted(t.items())) + f' -> {args.out}.txt')
+    if prev is None:
+        print('size_report: 前回のレポートなし (次回から差分を表示)')
+        return 0
+    pt = totals(prev)
+    for s in sorted(set(t) | set(pt)):
+        d = t.get(s, 0) - pt.get(s, 0)
+        if d:
+            print(f'size_report: {s} {d:+d} バイト')
+    lines = diff_lines(prev, cur)
+    for l in lines:
+        print(l)
+    if not lines:
+        print('size_report: 前回から変化なし')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
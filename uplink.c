@@ -0,0 +1,107 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/powman.h"
+#include "lora_radio.h"
+#include "powman_scratch.h"
+#include "telemetry_queue.h"
+#include "uplink.h"
+
+// フレーム形式:
+//   [0]    バージョン
+//   [1..6] 先頭項目の時刻 (ms, 48bit リトルエンディアン)
+//   以降項目ごとに [前項目からの時刻差 (ms, zigzag LEB128)] [優先度 << 6 | 長さ] [ペイロード]
+// 優先度順に詰めるので時刻は前後しうる。差分の可変長整数なら近い時刻は 1-2 バイトで済む
+
+#define FRAME_HDR_LEN 7u
+
+// 項目ヘッダ [優先度 << 6 | 長さ] の1バイトに収まること
+_Static_assert(TQ_ITEM_MAX < 64u, "item length must fit in 6 bits");
+_Static_assert(TQ_PRIO_COUNT <= 4u, "item priority must fit in 2 bits");
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+    size_t n = 0;
+    do {
+        uint8_t b = v & 0x7fu;
+        v >>= 7;
+        p[n++] = b | (v ? 0x80u : 0u);
+    } while (v);
+    return n;
+}
+
+// キューから優先度順に取り出して frame に詰める (仮取り出しのまま戻る)
+static size_t pack_frame(uint8_t *frame, size_t cap, uint64_t now_ms) {
+    tq_item item;
+    uint64_t prev = 0;
+    size_t pos = FRAME_HDR_LEN;
+    bool first = true;
+    while (telemetry_queue_pop(now_ms, &item) == PICO_OK) {
+        int64_t delta = first ? 0 : (int64_t)(item.timestamp_ms - prev);
+        uint8_t buf[10];
+        size_t dn = put_varint(buf, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        if (pos + dn + 1u + item.len > cap) {
+            telemetry_queue_unpop();
+            break;
+        }
+        if (first) {
+            frame[0] = UPLINK_FRAME_VERSION;
+            for (int i = 0; i < 6; ++i) {
+                frame[1 + i] = (uint8_t)(item.timestamp_ms >> (8 * i));
+            }
+            first = false;
+        }
+        memcpy(frame + pos, buf, dn);
+        pos += dn;
+        frame[pos++] = (uint8_t)((item.prio << 6) | item.len);
+        memcpy(frame + pos, item.data, item.len);
+        pos += item.len;
+        prev = item.timestamp_ms;
+    }
+    return first ? 0 : pos;
+}
+
+int uplink_poll(uint64_t now_ms, bool urgent) {
+    uint32_t now_s = (uint32_t)(now_ms / 1000u);
+    // 符号付き差分で比較 (スクラッチが 0 のコールドブート直後は即送信可)
+    if ((int32_t)(now_s - powman_hw->scratch[SCRATCH_UPLINK_EARLIEST_S]) < 0) {
+        return PICO_ERROR_NO_DATA;
+    }
+    if (!urgent && (int32_t)(now_s - powman_hw->scratch[SCRATCH_UPLINK_SCHED_S]) < 0) {
+        return PICO_ERROR_NO_DATA;
+    }
+
+    uint8_t frame[256];
+    size_t cap = lora_max_payload(UPLINK_DATA_RATE);
+    size_t len = pack_frame(frame, cap < sizeof(frame) ? cap : sizeof(frame), now_ms);
+    if (len == 0) {
+        telemetry_queue_commit(); // 期限切れで捨てた項目を確定する
+        powman_hw->scratch[SCRATCH_UPLINK_SCHED_S] = now_s + UPLINK_INTERVAL_S;
+        return PICO_ERROR_NO_DATA;
+    }
+
+    int rc = lora_radio_init();
+    if (rc == PICO_OK) {
+        rc = lora_radio_transmit(UPLINK_DATA_RATE, frame, len);
+    }
+    if (rc != PICO_OK) {
+        // 送れなかった項目は元の順序のままキューに戻す
+        telemetry_queue_rollback();
+        lora_radio_sleep();
+        return rc;
+    }
+    telemetry_queue_commit();
+
+    // 送信時間から次に送信してよい時刻を決める (1% なら送信の終わりから送信時間の 99 倍休む =
+    // 送信の始まり now_ms から 100 倍)。秒単位に切り上げ、now_s の切り捨てで早まらないようにする
+    uint64_t air_us = lora_time_on_air_us(UPLINK_DATA_RATE, len);
+    uint64_t next_ms = now_ms + (air_us * 1000u / UPLINK_DUTY_CYCLE_PERMILLE + 999u) / 1000u;
+    uint32_t off_s = (uint32_t)((next_ms + 999u) / 1000u) - now_s;
+    powman_hw->scratch[SCRATCH_UPLINK_EARLIEST_S] = now_s + off_s;
+
+    // 未送信が残っていれば、デューティ比が許す最短で次を送る
+    bool more = false;
+    for (int p = 0; p < TQ_PRIO_COUNT; ++p) {
+        more |= telemetry_queue_pending((tq_priority)p);
+    }
+    powman_hw->scratch[SCRATCH_UPLINK_SCHED_S] = more ? now_s + off_s : now_s + UPLINK_INTERVAL_S;
+    return PICO_OK;
+}
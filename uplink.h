@@ -0,0 +1,28 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 送信待ちキュー (telemetry_queue.h) の項目を優先度順にまとめて LoRa で送る。
+// 送信スケジュールは powman スクラッチに置き、電源断をまたいで保持する
+
+#ifndef UPLINK_INTERVAL_S
+#define UPLINK_INTERVAL_S 900u
+#endif
+#ifndef UPLINK_DATA_RATE
+#define UPLINK_DATA_RATE 3u
+#endif
+// デューティ比の上限 (千分率)
+#ifndef UPLINK_DUTY_CYCLE_PERMILLE
+#define UPLINK_DUTY_CYCLE_PERMILLE 10u
+#endif
+
+#define UPLINK_FRAME_VERSION 1u
+
+// 定期送信の時刻に達している (urgent ならデューティ比が許す限りすぐ) 場合に、
+// キューの項目を1フレームに詰めて送信し、無線をスリープに戻す。
+// 送信しなかった場合は PICO_ERROR_NO_DATA
+int uplink_poll(uint64_t now_ms, bool urgent);
+
+#endif
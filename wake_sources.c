@@ -0,0 +1,130 @@
+#include "pico/stdlib.h"
+#include "hardware/powman.h"
+#include "board_pins.h"
+#include "powman_example.h"
+#include "wake_sources.h"
+
+// LAST_SWCORE_PWRUP の値
+#define PWRUP_CHIP_RESET 0u
+#define PWRUP_GPIO_SLOT0 1u // 1..4: GPIO スロット 0..3
+#define PWRUP_ALARM 6u
+
+#define GPIO_SLOT_COUNT count_of(powman_hw->pwrup)
+
+// GPIO の起床要因。並び順がそのまま優先順位とスロット番号
+typedef struct {
+    uint8_t source;
+    uint8_t gpio;
+    bool high; // true: 立ち上がりで起こす
+} gpio_wake;
+
+static const gpio_wake gpio_wakes[] = {
+    {WAKE_SOURCE_SENSOR_INT1, WAKE_PIN, true},
+    {WAKE_SOURCE_SENSOR_INT2, SENSOR_INT2_PIN, true},
+    {WAKE_SOURCE_CONSOLE, FW_UPDATE_PIN_RX, true},
+    {WAKE_SOURCE_VBUS, VBUS_DETECT_PIN, true},
+};
+_Static_assert(count_of(gpio_wakes) <= 4, "powman has 4 GPIO wake slots");
+
+// 要因ごとの処理。定期起床でもシリアル更新は受け付ける
+// (起きている間に接続されたホストは、眠っている間にエッジを出さない)
+static const uint8_t source_work[WAKE_SOURCE_COUNT] = {
+    [WAKE_SOURCE_RESET] = WAKE_WORK_ALL,
+    [WAKE_SOURCE_ALARM] = WAKE_WORK_SCHEDULE | WAKE_WORK_CONSOLE | WAKE_WORK_UPLINK,
+    [WAKE_SOURCE_SENSOR_INT1] = WAKE_WORK_EVENT | WAKE_WORK_UPLINK,
+    [WAKE_SOURCE_SENSOR_INT2] = WAKE_WORK_EVENT | WAKE_WORK_UPLINK,
+    [WAKE_SOURCE_CONSOLE] = WAKE_WORK_CONSOLE,
+    [WAKE_SOURCE_VBUS] = WAKE_WORK_CONSOLE, // USB をつなぐのは保守のとき
+    [WAKE_SOURCE_OTHER] = WAKE_WORK_ALL,
+};
+
+static wake_source primary = WAKE_SOURCE_RESET;
+static uint32_t fired = WAKE_SOURCE_BIT(WAKE_SOURCE_RESET);
+static uint64_t pending_alarm_ms; // 割り込みで中断された定期起床の時刻 (0 = なし)
+
+static wake_source gpio_source(uint gpio) {
+    for (uint i = 0; i < count_of(gpio_wakes); ++i) {
+        if (gpio_wakes[i].gpio == gpio) {
+            return (wake_source)gpio_wakes[i].source;
+        }
+    }
+    return WAKE_SOURCE_OTHER;
+}
+
+void wake_sources_capture(void) {
+    uint32_t pwrup = powman_hw->last_swcore_pwrup & POWMAN_LAST_SWCORE_PWRUP_BITS;
+    if (pwrup == PWRUP_CHIP_RESET) {
+        primary = WAKE_SOURCE_RESET;
+    } else if (pwrup == PWRUP_ALARM) {
+        primary = WAKE_SOURCE_ALARM;
+    } else if (pwrup >= PWRUP_GPIO_SLOT0 && pwrup < PWRUP_GPIO_SLOT0 + GPIO_SLOT_COUNT) {
+        // スロットに設定されていたピンで判別する (supply_monitor などが別のピンを設定することもある)
+        uint32_t slot = powman_hw->pwrup[pwrup - PWRUP_GPIO_SLOT0];
+        primary = gpio_source((slot & POWMAN_PWRUP0_SOURCE_BITS) >> POWMAN_PWRUP0_SOURCE_LSB);
+    } else {
+        primary = WAKE_SOURCE_OTHER;
+    }
+    fired = WAKE_SOURCE_BIT(primary);
+
+    // ほかのスロットでも検出済みのエッジがあれば、同時に起きたものとして扱う
+    for (uint i = 0; i < GPIO_SLOT_COUNT; ++i) {
+        uint32_t slot = powman_hw->pwrup[i];
+        if ((slot & POWMAN_PWRUP0_ENABLE_BITS) && (slot & POWMAN_PWRUP0_STATUS_BITS)) {
+            fired |= WAKE_SOURCE_BIT(gpio_source((slot & POWMAN_PWRUP0_SOURCE_BITS) >> POWMAN_PWRUP0_SOURCE_LSB));
+        }
+    }
+
+    // アラームは時刻が過ぎていれば起きたのと同じ。まだ先なら予定として覚えておく
+    pending_alarm_ms = 0;
+    if (powman_hw->timer & POWMAN_TIMER_ALARM_ENAB_BITS) {
+        uint64_t alarm = powman_example_alarm_ms();
+        if (powman_timer_get_ms() >= alarm) {
+            fired |= WAKE_SOURCE_BIT(WAKE_SOURCE_ALARM);
+        } else {
+            pending_alarm_ms = alarm;
+        }
+    }
+}
+
+wake_source wake_sources_primary(void) {
+    return primary;
+}
+
+uint32_t wake_sources_fired(void) {
+    return fired;
+}
+
+uint32_t wake_sources_work(void) {
+    uint32_t work = 0;
+    for (uint s = 0; s < WAKE_SOURCE_COUNT; ++s) {
+        if (fired & WAKE_SOURCE_BIT(s)) {
+            work |= source_work[s];
+        }
+    }
+    // 次の定期起床の予定がなければ、どの要因で起きてもここで計画し直す
+    if (pending_alarm_ms == 0) {
+        work |= WAKE_WORK_SCHEDULE;
+    }
+    return work;
+}
+
+uint32_t wake_sources_alarm_remaining_ms(void) {
+    uint64_t now = powman_timer_get_ms();
+    if (pending_alarm_ms <= now) {
+        return 0;
+    }
+    return (uint32_t)MIN(pending_alarm_ms - now, UINT32_MAX);
+}
+
+int wake_sources_off_until(uint64_t abs_time_ms) {
+    for (uint i = 0; i < count_of(gpio_wakes); ++i) {
+        if (WAKE_SOURCES_ARMED & WAKE_SOURCE_BIT(gpio_wakes[i].source)) {
+            powman_enable_gpio_wakeup(i, gpio_wakes[i].gpio, true, gpio_wakes[i].high);
+        }
+    }
+    return powman_example_off_until_time(abs_time_ms);
+}
+
+int wake_sources_off_for_ms(uint32_t duration_ms) {
+    return wake_sources_off_until(powman_timer_get_ms() + duration_ms);
+}
@@ -0,0 +1,66 @@
+#ifndef WAKE_SOURCES_H
+#define WAKE_SOURCES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 複数の起床要因 (GPIO 4本 + powman アラーム) を同時に設定し、起床後は実際に起こした
+// 要因に応じて必要な処理だけを行う。
+// powman の GPIO 起床スロットは4つで、下の表の優先順に割り当てる。どのスロットで起きたかは
+// LAST_SWCORE_PWRUP に残るので、起床設定を消す前 (main の先頭) に wake_sources_capture() で読む。
+// GPIO はエッジで起こす (レベルだと信号が出たままの間は眠ってもすぐ起きてしまう)。
+
+typedef enum {
+    WAKE_SOURCE_RESET,       // チップリセット・電源投入 (起床要因なし)
+    WAKE_SOURCE_ALARM,       // 定期起床
+    WAKE_SOURCE_SENSOR_INT1, // 加速度センサーの割り込み
+    WAKE_SOURCE_SENSOR_INT2,
+    WAKE_SOURCE_CONSOLE,     // シリアル更新のホスト接続
+    WAKE_SOURCE_VBUS,        // USB 給電の接続
+    WAKE_SOURCE_OTHER,       // 上の表にない GPIO (電源電圧の復帰など) やデバッガ
+    WAKE_SOURCE_COUNT
+} wake_source;
+
+#define WAKE_SOURCE_BIT(s) (1u << (s))
+
+// 起床ごとに行う処理
+#define WAKE_WORK_SCHEDULE (1u << 0) // 発電量の測定・測定時間と次の休止時間の計画
+#define WAKE_WORK_EVENT    (1u << 1) // 割り込みの記録と即時送信
+#define WAKE_WORK_CONSOLE  (1u << 2) // シリアル更新の受け付け
+#define WAKE_WORK_UPLINK   (1u << 3) // 送信
+#define WAKE_WORK_ALL      (WAKE_WORK_SCHEDULE | WAKE_WORK_EVENT | WAKE_WORK_CONSOLE | WAKE_WORK_UPLINK)
+
+// 電源断中に有効にする要因 (WAKE_SOURCE_BIT の和)。アラームは常に有効
+#ifndef WAKE_SOURCES_ARMED
+#define WAKE_SOURCES_ARMED                                                                              \
+    (WAKE_SOURCE_BIT(WAKE_SOURCE_SENSOR_INT1) | WAKE_SOURCE_BIT(WAKE_SOURCE_SENSOR_INT2) |           \
+     WAKE_SOURCE_BIT(WAKE_SOURCE_CONSOLE) | WAKE_SOURCE_BIT(WAKE_SOURCE_VBUS))
+#endif
+
+// ログ・テレメトリに書く記録 (定期起床以外)
+#define WAKE_EVENT_RECORD_TAG 0x57u // 'W'
+
+typedef struct {
+    uint8_t tag;
+    uint8_t source;     // 起こした要因 (wake_source)
+    uint16_t fired;     // 起床時に信号が出ていた要因 (WAKE_SOURCE_BIT の和)
+    uint32_t wake_count;
+} wake_event_record;
+
+// 起床要因を読む。main の先頭 (powman_example_init より前) で1回呼ぶ
+void wake_sources_capture(void);
+// 起こした要因
+wake_source wake_sources_primary(void);
+// 起こした要因と、起床時に同時に信号が出ていた要因 (WAKE_SOURCE_BIT の和)
+uint32_t wake_sources_fired(void);
+// 今回の起床で行う処理 (WAKE_WORK_*)。定期起床の予定が失われていれば WAKE_WORK_SCHEDULE を含む
+uint32_t wake_sources_work(void);
+// 割り込みで中断された定期起床の残り時間 (ms)。予定がなければ 0
+uint32_t wake_sources_alarm_remaining_ms(void);
+
+// WAKE_SOURCES_ARMED の GPIO とアラームで起きるように設定して電源を落とす。
+// 成功すれば戻らない (失敗時は powman_example_off と同じエラーコード)
+int wake_sources_off_until(uint64_t abs_time_ms);
+int wake_sources_off_for_ms(uint32_t duration_ms);
+
+#endif